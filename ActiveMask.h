@@ -0,0 +1,87 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __ACTIVE_MASK_H__
+#define __ACTIVE_MASK_H__
+
+#include <memory>
+#include <vector>
+
+#include "hoomd/ParticleData.h"
+#include "hoomd/ParticleGroup.h"
+
+/*! \file ActiveMask.h
+    \brief Defines the ActiveMask class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! Flags the members of a group among the local and ghost particles
+/*! Lists drop pairs in which neither particle is active, such as the grains
+   of a frozen wall or base. The group only knows its local members by
+   index, so ghosts are flagged through the global member tags.
+
+    update() must run whenever particles are sorted, exchanged or inserted,
+   which all trigger a neighbor list build.
+*/
+class ActiveMask
+    {
+    public:
+    //! Set the group of active particles, nullptr makes every particle active
+    void setGroup(std::shared_ptr<ParticleGroup> group)
+        {
+        m_group = group;
+        }
+
+    std::shared_ptr<ParticleGroup> getGroup() const
+        {
+        return m_group;
+        }
+
+    bool enabled() const
+        {
+        return bool(m_group);
+        }
+
+    //! Flag the local and ghost particles by index
+    void update(const ParticleData& pdata)
+        {
+        if (!m_group)
+            return;
+
+        m_tag_active.assign(pdata.getMaximumTag() + 1, 0);
+        const unsigned int n_members = m_group->getNumMembersGlobal();
+        for (unsigned int k = 0; k < n_members; k++)
+            m_tag_active[m_group->getMemberTag(k)] = 1;
+
+        const unsigned int n = pdata.getN() + pdata.getNGhosts();
+        ArrayHandle<unsigned int> h_tag(pdata.getTags(), access_location::host, access_mode::read);
+        m_active.resize(n);
+        for (unsigned int i = 0; i < n; i++)
+            m_active[i] = m_tag_active[h_tag.data[i]];
+        }
+
+    //! Flags by particle index, nullptr when every particle is active
+    const unsigned char* data() const
+        {
+        return m_group ? m_active.data() : nullptr;
+        }
+
+    private:
+    std::shared_ptr<ParticleGroup> m_group;  //!< Active particles, all when null
+    std::vector<unsigned char> m_tag_active; //!< Flags by tag
+    std::vector<unsigned char> m_active;     //!< Flags by local and ghost index
+    };
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __ACTIVE_MASK_H__
@@ -0,0 +1,123 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __APPROX_MATH_H__
+#define __APPROX_MATH_H__
+
+#include "hoomd/HOOMDMath.h"
+
+#ifndef __HIPCC__
+#include <stdint.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#endif
+
+/*! \file ApproxMath.h
+    \brief Approximate reciprocal and reciprocal square root for the *Approx
+   evaluators
+    \details Both functions start from a single precision estimate with a
+   maximum relative error of \f$ \epsilon_0 = 1.5 \cdot 2^{-12} \approx
+   3.66 \cdot 10^{-4} \f$ (the bound Intel documents for rsqrtss/rcpss, and
+   also met by the portable fallbacks below) and refine it in Scalar precision
+   with Newton steps, which use only multiplies and adds. The maximum relative
+   errors, before round-off, are
+
+    | function     | 1 step                  | 2 steps                  |
+    |--------------|-------------------------|--------------------------|
+    | rsqrt<n>(x)  | \f$ 2.02 \cdot 10^{-7} \f$ | \f$ 6.1 \cdot 10^{-14} \f$ |
+    | rcp<n>(x)    | \f$ 1.35 \cdot 10^{-7} \f$ | \f$ 1.8 \cdot 10^{-14} \f$ |
+
+    since one step maps a relative error \f$ \epsilon \f$ to \f$ \frac{3}{2}
+   \epsilon^2 + \frac{1}{2} \epsilon^3 \f$ (rsqrt) or \f$ \epsilon^2 \f$ (rcp).
+   With SINGLE_PRECISION the float round-off (\f$ 6 \cdot 10^{-8} \f$ per
+   operation) adds to these. \a x must be a positive, normal single
+   precision number.
+
+    On the GPU the estimate is replaced by the device rsqrt and reciprocal,
+   which are at least as accurate.
+*/
+
+// need to declare these class methods with __device__ qualifiers when building
+// in nvcc DEVICE is __host__ __device__ when included in nvcc and blank when
+// included into the host compiler
+#ifdef __HIPCC__
+#define DEVICE __device__
+#define HOSTDEVICE __host__ __device__
+#else
+#define DEVICE
+#define HOSTDEVICE
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+namespace approx
+    {
+//! Relative error bound of rsqrt<1>
+const Scalar rsqrt_max_rel_error = Scalar(2.02e-7);
+
+//! Relative error bound of rcp<1>
+const Scalar rcp_max_rel_error = Scalar(1.35e-7);
+
+//! Single precision estimate of 1/sqrt(x)
+DEVICE inline float rsqrt_estimate(float x)
+    {
+#if defined(__HIPCC__)
+    return ::rsqrtf(x);
+#elif defined(__SSE__)
+    return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+    // bit level first guess (relative error below 3.5e-2) and two float
+    // Newton steps, which bring it to 4.6e-6, well under the rsqrtss bound
+    union
+        {
+        float f;
+        uint32_t i;
+        } u;
+    u.f = x;
+    u.i = 0x5f375a86u - (u.i >> 1);
+    float y = u.f * (1.5f - 0.5f * x * u.f * u.f);
+    return y * (1.5f - 0.5f * x * y * y);
+#endif
+    }
+
+//! Single precision estimate of 1/x
+DEVICE inline float rcp_estimate(float x)
+    {
+#if defined(__HIPCC__)
+    return __frcp_rn(x);
+#elif defined(__SSE__)
+    return _mm_cvtss_f32(_mm_rcp_ss(_mm_set_ss(x)));
+#else
+    return 1.0f / x;
+#endif
+    }
+
+//! 1/sqrt(x) refined with \a newton_steps Newton steps
+template<unsigned int newton_steps> DEVICE inline Scalar rsqrt(Scalar x)
+    {
+    Scalar y = Scalar(rsqrt_estimate(float(x)));
+    const Scalar half_x = Scalar(0.5) * x;
+    for (unsigned int k = 0; k < newton_steps; k++)
+        y = y * (Scalar(1.5) - half_x * y * y);
+    return y;
+    }
+
+//! 1/x refined with \a newton_steps Newton steps
+template<unsigned int newton_steps> DEVICE inline Scalar rcp(Scalar x)
+    {
+    Scalar y = Scalar(rcp_estimate(float(x)));
+    for (unsigned int k = 0; k < newton_steps; k++)
+        y = y * (Scalar(2.0) - x * y);
+    return y;
+    }
+
+    } // end namespace approx
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __APPROX_MATH_H__
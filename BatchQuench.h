@@ -0,0 +1,295 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __BATCH_QUENCH_H__
+#define __BATCH_QUENCH_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ReplicaPairForce.h"
+
+/*! \file BatchQuench.h
+    \brief Defines the BatchQuench class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! FIRE minimization of many independent configurations
+/*! Quenches each frame added with addFrame() to its inherent structure. The
+   frames are independent of HOOMD's particle data: each one holds its own
+   positions, box, cell list and Verlet list, so run() hands whole frames to
+   \a num_threads threads with the GIL released.
+
+    The Verlet list is rebuilt when a particle has moved more than half of
+   the buffer. Minimization follows FIRE with unit masses: a frame has
+   converged when the rms force per degree of freedom is below \a force_tol
+   and the change of the energy per particle in one step is below
+   \a energy_tol.
+
+    \tparam evaluator Pair evaluator
+*/
+template<class evaluator> class BatchQuench : public ReplicaPairForce<evaluator>
+    {
+    public:
+    typedef typename ReplicaPairForce<evaluator>::double_array double_array;
+    typedef typename ReplicaPairForce<evaluator>::uint_array uint_array;
+
+    //! Construct the batch minimizer
+    /*! \param n_types Number of particle types
+        \param mode Energy shift mode of the pair potential
+    */
+    BatchQuench(unsigned int n_types, const std::string& mode)
+        : ReplicaPairForce<evaluator>(n_types, mode)
+        {
+        }
+
+    //! Add a frame to quench
+    void addFrame(double_array position,
+                  uint_array typeid_,
+                  double_array box,
+                  unsigned int dimensions)
+        {
+        Frame f;
+        this->makeConfiguration(f, position, typeid_, box, dimensions);
+        m_frames.push_back(std::move(f));
+        }
+
+    //! Quench all frames that were added
+    void run();
+
+    //! Forget all frames
+    void clear()
+        {
+        m_frames.clear();
+        }
+
+    unsigned int getNumFrames()
+        {
+        return (unsigned int)m_frames.size();
+        }
+
+    //! Get the minimized positions of a frame, wrapped into the box
+    pybind11::array_t<double> getPosition(unsigned int frame)
+        {
+        const Frame& f = getFrame(frame);
+        std::vector<double> position(f.pos.size() * 3);
+        for (size_t i = 0; i < f.pos.size(); i++)
+            {
+            position[3 * i] = f.pos[i].x;
+            position[3 * i + 1] = f.pos[i].y;
+            position[3 * i + 2] = f.pos[i].z;
+            }
+        return pybind11::array_t<double>({f.pos.size(), size_t(3)}, position.data());
+        }
+
+    //! Get the image shifts of a frame accumulated while wrapping
+    pybind11::array_t<int> getImage(unsigned int frame)
+        {
+        const Frame& f = getFrame(frame);
+        std::vector<int> image(f.image.size() * 3);
+        for (size_t i = 0; i < f.image.size(); i++)
+            {
+            image[3 * i] = f.image[i].x;
+            image[3 * i + 1] = f.image[i].y;
+            image[3 * i + 2] = f.image[i].z;
+            }
+        return pybind11::array_t<int>({f.image.size(), size_t(3)}, image.data());
+        }
+
+    //! Get the potential energy of every frame
+    pybind11::array_t<double> getEnergies()
+        {
+        std::vector<double> energy(m_frames.size());
+        for (size_t k = 0; k < m_frames.size(); k++)
+            energy[k] = m_frames[k].energy;
+        return pybind11::array_t<double>(energy.size(), energy.data());
+        }
+
+    //! Get the number of FIRE steps of every frame
+    pybind11::array_t<uint64_t> getSteps()
+        {
+        std::vector<uint64_t> steps(m_frames.size());
+        for (size_t k = 0; k < m_frames.size(); k++)
+            steps[k] = m_frames[k].steps;
+        return pybind11::array_t<uint64_t>(steps.size(), steps.data());
+        }
+
+    //! Get whether every frame has converged
+    pybind11::array_t<bool> getConverged()
+        {
+        std::vector<char> converged(m_frames.size());
+        for (size_t k = 0; k < m_frames.size(); k++)
+            converged[k] = m_frames[k].converged;
+        return pybind11::array_t<bool>(converged.size(),
+                                       reinterpret_cast<const bool*>(converged.data()));
+        }
+
+    Scalar m_dt = Scalar(0.005);         //!< Initial time step
+    Scalar m_force_tol = Scalar(1e-6);   //!< Tolerance of the rms force
+    Scalar m_energy_tol = Scalar(1e-10); //!< Tolerance of the energy change per particle
+    uint64_t m_max_steps = 100000;       //!< Maximum number of steps per frame
+
+    protected:
+    typedef typename ReplicaPairForce<evaluator>::VerletList VerletList;
+
+    //! One configuration and its minimization state
+    struct Frame : public ReplicaPairForce<evaluator>::Configuration
+        {
+        double energy = 0.0;    //!< Potential energy
+        uint64_t steps = 0;     //!< Number of FIRE steps taken
+        bool converged = false; //!< True when the tolerances were met
+        };
+
+    std::vector<Frame> m_frames; //!< Frames to quench
+
+    const Frame& getFrame(unsigned int frame)
+        {
+        if (frame >= m_frames.size())
+            {
+            throw std::runtime_error("Invalid frame index.");
+            }
+        return m_frames[frame];
+        }
+
+    //! Minimize one frame
+    void quench(Frame& f) const;
+    };
+
+/*! Frames are handed out one at a time, so threads that get easy frames take
+   more of them.
+*/
+template<class evaluator> void BatchQuench<evaluator>::run()
+    {
+    pybind11::gil_scoped_release release;
+
+    std::atomic<size_t> next(0);
+    auto worker = [this, &next]()
+    {
+        for (size_t k = next++; k < m_frames.size(); k = next++)
+            quench(m_frames[k]);
+    };
+
+    const size_t n_threads
+        = std::max<size_t>(std::min<size_t>(this->m_num_threads, m_frames.size()), 1);
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (size_t t = 1; t < n_threads; t++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+    }
+
+/*! \param f Frame to minimize in place
+ */
+template<class evaluator> void BatchQuench<evaluator>::quench(Frame& f) const
+    {
+    const size_t N = f.pos.size();
+    const Scalar n_dof = Scalar(N * f.dimensions);
+    const Scalar r_list = this->getListRange();
+    const Scalar max_dispsq = Scalar(0.25) * this->m_buffer * this->m_buffer;
+
+    VerletList list;
+    this->buildVerletList(f, r_list, list);
+
+    std::vector<Scalar3> force(N);
+    std::vector<Scalar3> vel(N, make_scalar3(0.0, 0.0, 0.0));
+    FireState fire(m_dt);
+
+    f.energy = this->computeForces(f, f.pos, list, force);
+    f.steps = 0;
+    f.converged = false;
+    double energy_old = f.energy;
+
+    while (f.steps < m_max_steps)
+        {
+        double fsq = 0.0;
+        double vsq = 0.0;
+        double power = 0.0;
+        for (size_t i = 0; i < N; i++)
+            {
+            fsq += dot(force[i], force[i]);
+            vsq += dot(vel[i], vel[i]);
+            power += dot(force[i], vel[i]);
+            }
+
+        if (f.steps > 0 && std::sqrt(fsq / n_dof) < m_force_tol
+            && std::abs(f.energy - energy_old) < m_energy_tol * N)
+            {
+            f.converged = true;
+            break;
+            }
+
+        Scalar c_v, c_f;
+        fire.mix(fsq, vsq, power, c_v, c_f);
+
+        // semi-implicit Euler step with unit masses
+        bool rebuild = false;
+        for (size_t i = 0; i < N; i++)
+            {
+            vel[i] = vel[i] * c_v + force[i] * c_f;
+            vel[i] += force[i] * fire.dt;
+            f.pos[i] += vel[i] * fire.dt;
+            f.box.wrap(f.pos[i], f.image[i]);
+            const Scalar3 disp = f.box.minImage(f.pos[i] - list.ref_pos[i]);
+            rebuild = rebuild || dot(disp, disp) > max_dispsq;
+            }
+        if (rebuild)
+            this->buildVerletList(f, r_list, list);
+
+        energy_old = f.energy;
+        f.energy = this->computeForces(f, f.pos, list, force);
+        f.steps++;
+        }
+    }
+
+namespace detail
+    {
+//! Export a BatchQuench to python
+/*! \param name Name of the class in the exported python module
+    \tparam T Evaluator type to export.
+*/
+template<class T> void export_BatchQuench(pybind11::module& m, const std::string& name)
+    {
+    typedef BatchQuench<T> quench_t;
+    pybind11::class_<quench_t, std::shared_ptr<quench_t>> cls(m, name.c_str());
+    cls.def(pybind11::init<unsigned int, const std::string&>())
+        .def("addFrame", &quench_t::addFrame)
+        .def("run", &quench_t::run)
+        .def("clear", &quench_t::clear)
+        .def("getPosition", &quench_t::getPosition)
+        .def("getImage", &quench_t::getImage)
+        .def_property_readonly("num_frames", &quench_t::getNumFrames)
+        .def_property_readonly("energies", &quench_t::getEnergies)
+        .def_property_readonly("steps", &quench_t::getSteps)
+        .def_property_readonly("converged", &quench_t::getConverged)
+        .def_readwrite("dt", &quench_t::m_dt)
+        .def_readwrite("force_tol", &quench_t::m_force_tol)
+        .def_readwrite("energy_tol", &quench_t::m_energy_tol)
+        .def_readwrite("max_steps", &quench_t::m_max_steps);
+    export_ReplicaPairForce(cls);
+    }
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __BATCH_QUENCH_H__
@@ -0,0 +1,135 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __CPU_DISPATCH_H__
+#define __CPU_DISPATCH_H__
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+/*! \file CpuDispatch.h
+    \brief Runtime selection of the instruction set of the host force loops
+    \details The plugin is compiled once with the flags of HOOMD. Loops that
+   are worth it are compiled a second and third time for AVX2 and AVX-512
+   through the GCC/Clang target attribute: PAIR_PLUGIN_TARGET_AVX2 and
+   PAIR_PLUGIN_TARGET_AVX512 mark a thin entry point that inlines the whole
+   loop (flatten), so the evaluator code below it is generated for that
+   instruction set. The version to run is chosen once, when _pair_plugin is
+   imported, from CPUID; the PAIR_PLUGIN_ISA environment variable (baseline,
+   avx2 or avx512) overrides it for testing. A requested level that the CPU
+   does not support is an error.
+
+    PAIR_PLUGIN_MULTIVERSION is only defined for x86-64 builds with GCC or
+   Clang, elsewhere every loop runs the baseline version.
+*/
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PAIR_PLUGIN_MULTIVERSION
+#define PAIR_PLUGIN_TARGET_AVX2 __attribute__((target("avx2,fma"), flatten))
+#define PAIR_PLUGIN_TARGET_AVX512 \
+    __attribute__((target("avx512f,avx512dq,avx512vl,avx2,fma"), flatten))
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+namespace detail
+    {
+//! Instruction set levels with their own version of the host loops
+enum class CpuIsa
+    {
+    baseline,
+    avx2,
+    avx512
+    };
+
+//! Instruction set level of the host loops, set by selectCpuIsa()
+inline CpuIsa& cpuIsa()
+    {
+    static CpuIsa isa = CpuIsa::baseline;
+    return isa;
+    }
+
+//! Name of an instruction set level
+inline std::string cpuIsaName(CpuIsa isa)
+    {
+    switch (isa)
+        {
+    case CpuIsa::avx2:
+        return "avx2";
+    case CpuIsa::avx512:
+        return "avx512";
+    default:
+        return "baseline";
+        }
+    }
+
+//! Check whether the CPU supports an instruction set level
+inline bool cpuSupports(CpuIsa isa)
+    {
+#ifdef PAIR_PLUGIN_MULTIVERSION
+    switch (isa)
+        {
+    case CpuIsa::avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case CpuIsa::avx512:
+        return cpuSupports(CpuIsa::avx2) && __builtin_cpu_supports("avx512f")
+               && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+    default:
+        return true;
+        }
+#else
+    return isa == CpuIsa::baseline;
+#endif
+    }
+
+//! Choose the instruction set level of the host loops
+/*! Uses PAIR_PLUGIN_ISA when it is set, otherwise the highest level the CPU
+   supports.
+*/
+inline void selectCpuIsa()
+    {
+    const CpuIsa levels[] = {CpuIsa::avx512, CpuIsa::avx2, CpuIsa::baseline};
+
+    const char* requested = std::getenv("PAIR_PLUGIN_ISA");
+    if (requested && *requested)
+        {
+        for (CpuIsa isa : levels)
+            {
+            if (cpuIsaName(isa) == requested)
+                {
+                if (!cpuSupports(isa))
+                    {
+                    throw std::runtime_error(std::string("PAIR_PLUGIN_ISA=") + requested
+                                             + " is not supported by this CPU or build.");
+                    }
+                cpuIsa() = isa;
+                return;
+                }
+            }
+        throw std::runtime_error("PAIR_PLUGIN_ISA must be baseline, avx2 or avx512.");
+        }
+
+    for (CpuIsa isa : levels)
+        {
+        if (cpuSupports(isa))
+            {
+            cpuIsa() = isa;
+            return;
+            }
+        }
+    }
+
+    } // end namespace detail
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __CPU_DISPATCH_H__
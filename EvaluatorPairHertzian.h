@@ -9,10 +9,13 @@
 
 #ifndef __HIPCC__
 #include <string>
+#include <vector>
 #endif
 
 #include "hoomd/HOOMDMath.h"
 
+#include "ApproxMath.h"
+
 /*! \file EvaluatorPairExample.h
     \brief Defines the pair evaluator class for the example potential
     \details Modified version of the LJ potential
@@ -151,6 +154,31 @@ class EvaluatorPairHertzian
             return false;
         }
 
+    /*! Specialization of the force/energy evaluator for GranularPotentialPair.
+
+        Returns r and 1/r alongside the force so the contact law does not need
+       to recompute them.
+    */
+    DEVICE bool
+    evalForceAndEnergyGranular(Scalar& force_divr, Scalar& pair_eng, Scalar& r, Scalar& rinv)
+        {
+        if (rsq < rcutsq && eps != 0)
+            {
+            r = fast::sqrt(rsq);
+            rinv = Scalar(1.0) / r;
+            Scalar term = Scalar(1.0) - r * siginv;
+            Scalar sqrt_term = fast::sqrt(term);
+
+            force_divr = eps * siginv * rinv * term * sqrt_term;
+
+            pair_eng = 0.4 * eps * term * term * sqrt_term;
+
+            return true;
+            }
+        else
+            return false;
+        }
+
     DEVICE Scalar evalPressureLRCIntegral()
         {
         return 0;
@@ -161,6 +189,36 @@ class EvaluatorPairHertzian
         return 0;
         }
 
+    //! Number of parameters with analytic derivatives
+    static const unsigned int num_params = 2;
+
+    //! Evaluate the derivatives of the force and energy with respect to the parameters
+    /*! \param dforce_divr Output, derivatives of the force divided by r in the
+       order of getParamNames() \param dpair_eng Output, derivatives of the
+       energy \param energy_shift Ignored, the energy is zero at contact
+
+        \return False beyond the cutoff
+    */
+    DEVICE bool evalParamDerivatives(Scalar* dforce_divr, Scalar* dpair_eng, bool energy_shift)
+        {
+        if (rsq < rcutsq)
+            {
+            Scalar r = fast::sqrt(rsq);
+            Scalar rinv = Scalar(1.0) / r;
+            Scalar term = Scalar(1.0) - r * siginv;
+            Scalar sqrt_term = fast::sqrt(term);
+
+            dpair_eng[0] = Scalar(0.4) * term * term * sqrt_term;
+            dpair_eng[1] = eps * term * sqrt_term * r * siginv * siginv;
+            dforce_divr[0] = siginv * rinv * term * sqrt_term;
+            dforce_divr[1] = eps * siginv * siginv * rinv * sqrt_term
+                             * (Scalar(1.5) * r * siginv - term);
+            return true;
+            }
+        else
+            return false;
+        }
+
 #ifndef __HIPCC__
     //! Get the name of this potential
     /*! \returns The potential name.
@@ -170,6 +228,12 @@ class EvaluatorPairHertzian
         return std::string("hertzian");
         }
 
+    //! Get the names of the parameters with analytic derivatives
+    static std::vector<std::string> getParamNames()
+        {
+        return {"epsilon", "sigma"};
+        }
+
     std::string getShapeSpec() const
         {
         throw std::runtime_error("Shape definition not supported for this pair potential.");
@@ -183,6 +247,63 @@ class EvaluatorPairHertzian
     Scalar siginv;
     };
 
+//! Hertzian pair potential evaluated with approximate math
+/*! Replaces both square roots and the division of EvaluatorPairHertzian by
+   approx::rsqrt<1> (see ApproxMath.h): \f$ 1/r \f$ directly, \f$ r = r^2
+   \cdot (1/r) \f$ and \f$ \sqrt{\tau} = \tau / \sqrt{\tau} \f$ with \f$ \tau =
+   1 - r/\sigma \f$.
+
+    Relative error of the overlap term \f$ \tau \f$ is not bounded as \f$ r
+   \to \sigma \f$, so the bounds are stated in the natural scale of each
+   quantity. With \f$ \epsilon = 2.02 \cdot 10^{-7} \f$, \f$ |\Delta \tau| \le
+   \epsilon \f$ and
+
+    - \f$ |\Delta F/r| \le 3.5 \epsilon \, \varepsilon / (\sigma r) < 10^{-6}
+      \varepsilon / (\sigma r) \f$
+    - \f$ |\Delta V| \le 1.4 \epsilon \, \varepsilon < 10^{-6} \varepsilon \f$
+*/
+class EvaluatorPairHertzianApprox : public EvaluatorPairHertzian
+    {
+    public:
+    DEVICE EvaluatorPairHertzianApprox(Scalar _rsq, Scalar _rcutsq, const param_type& _params)
+        : EvaluatorPairHertzian(_rsq, _rcutsq, _params)
+        {
+        }
+
+    DEVICE bool evalForceAndEnergy(Scalar& force_divr, Scalar& pair_eng, bool energy_shift)
+        {
+        Scalar r, rinv;
+        return evalForceAndEnergyGranular(force_divr, pair_eng, r, rinv);
+        }
+
+    DEVICE bool
+    evalForceAndEnergyGranular(Scalar& force_divr, Scalar& pair_eng, Scalar& r, Scalar& rinv)
+        {
+        if (rsq < rcutsq && eps != 0)
+            {
+            rinv = approx::rsqrt<1>(rsq);
+            r = rsq * rinv;
+            Scalar term = Scalar(1.0) - r * siginv;
+            Scalar sqrt_term = term > Scalar(0.0) ? term * approx::rsqrt<1>(term) : Scalar(0.0);
+
+            force_divr = eps * siginv * rinv * term * sqrt_term;
+
+            pair_eng = 0.4 * eps * term * term * sqrt_term;
+
+            return true;
+            }
+        else
+            return false;
+        }
+
+#ifndef __HIPCC__
+    static std::string getName()
+        {
+        return std::string("hertzian_approx");
+        }
+#endif
+    };
+
     } // end namespace md
     } // end namespace hoomd
 
@@ -9,11 +9,14 @@
 
 #ifndef __HIPCC__
 #include <string>
+#include <vector>
 #endif
 
 // #include "hoomd/md/EvaluatorPairLJ.h"
 #include "hoomd/HOOMDMath.h"
 
+#include "ApproxMath.h"
+
 /*! \file EvaluatorPairMLJ.h
     \brief Defines the pair evaluator class for the modified LJ potential
     \details Modified version of the LJ potential
@@ -34,6 +37,54 @@ namespace hoomd
     {
 namespace md
     {
+namespace detail
+    {
+//! Derivatives of the modified LJ force and energy with respect to its parameters
+/*! \param r Distance between the particles
+    \param epsilon Energy parameter
+    \param sigma Size parameter
+    \param delta Shift of the distance
+    \param dforce_divr Output, derivatives of the force divided by r
+    \param dpair_eng Output, derivatives of the energy
+
+    Derivatives are written in the order epsilon, sigma, delta. With \f$ u =
+   \sigma' / (r - \Delta) \f$, \f$ \sigma' = \sigma (1 - \Delta / 2^{1/6})
+   \f$, the energy is \f$ 4 \varepsilon (u^{12} - u^6) \f$. The evaluators
+   that store derived parameters recover epsilon and sigma before calling.
+*/
+DEVICE inline void mljParamDerivatives(Scalar r,
+                                       Scalar epsilon,
+                                       Scalar sigma,
+                                       Scalar delta,
+                                       Scalar* dforce_divr,
+                                       Scalar* dpair_eng)
+    {
+    const Scalar c = Scalar(1.122462048309373); // 2^(1/6)
+    Scalar rinv = Scalar(1.0) / r;
+    Scalar rho = Scalar(1.0) / (r - delta);
+    Scalar u = sigma * (Scalar(1.0) - delta / c) * rho;
+    Scalar u6 = u * u * u;
+    u6 *= u6;
+
+    // repulsive and attractive terms of V / epsilon and their r and sigma'
+    // derivatives
+    Scalar a = Scalar(4.0) * u6 * u6;
+    Scalar b = Scalar(4.0) * u6;
+    Scalar g = Scalar(12.0) * a - Scalar(6.0) * b;
+    Scalar h = Scalar(144.0) * a - Scalar(36.0) * b;
+    // -d ln(sigma') / d delta
+    Scalar k = Scalar(1.0) / (c - delta);
+
+    dpair_eng[0] = a - b;
+    dpair_eng[1] = epsilon * g / sigma;
+    dpair_eng[2] = epsilon * g * (rho - k);
+    dforce_divr[0] = g * rho * rinv;
+    dforce_divr[1] = epsilon * h * rho * rinv / sigma;
+    dforce_divr[2] = epsilon * (h * (rho - k) + g * rho) * rho * rinv;
+    }
+
+    } // end namespace detail
+
 //! Class for evaluating the modified LJ pair potential
 /*! <b>Original</b>
     <b>General Overview</b>
@@ -282,6 +333,51 @@ class EvaluatorPairMLJ
         return 0;
         }
 
+    //! Number of parameters with analytic derivatives
+    static const unsigned int num_params = 3;
+
+    //! Evaluate the derivatives of the force and energy with respect to the parameters
+    /*! \param dforce_divr Output, derivatives of the force divided by r in the
+       order of getParamNames() \param dpair_eng Output, derivatives of the
+       energy \param energy_shift If true, the potential is shifted so that
+       V(r) is continuous at the cutoff
+
+        \return False beyond the cutoff and for epsilon = 0, where sigma can
+       not be recovered from the stored parameters
+    */
+    DEVICE bool evalParamDerivatives(Scalar* dforce_divr, Scalar* dpair_eng, bool energy_shift)
+        {
+        if (rsq < rcutsq && lj1 != 0)
+            {
+            const Scalar c = Scalar(1.122462048309373); // 2^(1/6)
+            Scalar epsilon = lj2 * lj2 / (Scalar(4.0) * lj1);
+            Scalar sigma = fast::pow(lj1 / lj2, Scalar(1.0 / 6.0)) * c / (c - dlt);
+            detail::mljParamDerivatives(fast::sqrt(rsq),
+                                        epsilon,
+                                        sigma,
+                                        dlt,
+                                        dforce_divr,
+                                        dpair_eng);
+
+            if (energy_shift)
+                {
+                Scalar dforce_cut[num_params];
+                Scalar deng_cut[num_params];
+                detail::mljParamDerivatives(fast::sqrt(rcutsq),
+                                            epsilon,
+                                            sigma,
+                                            dlt,
+                                            dforce_cut,
+                                            deng_cut);
+                for (unsigned int k = 0; k < num_params; k++)
+                    dpair_eng[k] -= deng_cut[k];
+                }
+            return true;
+            }
+        else
+            return false;
+        }
+
 #ifndef __HIPCC__
     //! Get the name of this potential
     /*! \returns The potential name.
@@ -291,6 +387,12 @@ class EvaluatorPairMLJ
         return std::string("modlj");
         }
 
+    //! Get the names of the parameters with analytic derivatives
+    static std::vector<std::string> getParamNames()
+        {
+        return {"epsilon", "sigma", "delta"};
+        }
+
     std::string getShapeSpec() const
         {
         throw std::runtime_error("Shape definition not supported for this pair potential.");
@@ -309,6 +411,61 @@ class EvaluatorPairMLJ
                 //!< the constructor
     };
 
+//! Modified LJ pair potential evaluated with approximate math
+/*! Forms \f$ 1/r \f$ with approx::rsqrt<2> and \f$ 1/(r - \Delta) \f$ with
+   approx::rcp<2> instead of a square root and two divisions (see
+   ApproxMath.h).
+
+    The twelfth power multiplies the relative error of \f$ 1/(r - \Delta)
+   \f$ by 12, and the error of \f$ r \f$ is further amplified by \f$ \kappa =
+   r/(r - \Delta) \f$. A single Newton step would leave \f$ 12 (\kappa \cdot
+   2.02 + 1.35) \cdot 10^{-7} > 4 \cdot 10^{-6} \f$, so both use two steps,
+   giving a relative error of the repulsive and attractive terms of force and
+   energy below \f$ 10^{-12} \kappa \f$.
+   The energy shift at the cutoff is computed exactly.
+*/
+class EvaluatorPairMLJApprox : public EvaluatorPairMLJ
+    {
+    public:
+    DEVICE EvaluatorPairMLJApprox(Scalar _rsq, Scalar _rcutsq, const param_type& _params)
+        : EvaluatorPairMLJ(_rsq, _rcutsq, _params)
+        {
+        }
+
+    DEVICE bool evalForceAndEnergy(Scalar& force_divr, Scalar& pair_eng, bool energy_shift)
+        {
+        if (rsq < rcutsq && lj1 != 0)
+            {
+            Scalar rinv_std = approx::rsqrt<2>(rsq);
+            Scalar rinv = approx::rcp<2>(rsq * rinv_std - dlt);
+            Scalar r2inv = rinv * rinv;
+
+            Scalar r6inv = r2inv * r2inv * r2inv;
+            force_divr = rinv_std * rinv * r6inv * (Scalar(12.0) * lj1 * r6inv - Scalar(6.0) * lj2);
+
+            pair_eng = r6inv * (lj1 * r6inv - lj2);
+
+            if (energy_shift)
+                {
+                Scalar rcutinv = Scalar(1.0) / (fast::sqrt(rcutsq) - dlt);
+                Scalar rcut2inv = rcutinv * rcutinv;
+                Scalar rcut6inv = rcut2inv * rcut2inv * rcut2inv;
+                pair_eng -= rcut6inv * (lj1 * rcut6inv - lj2);
+                }
+            return true;
+            }
+        else
+            return false;
+        }
+
+#ifndef __HIPCC__
+    static std::string getName()
+        {
+        return std::string("modlj_approx");
+        }
+#endif
+    };
+
     } // end namespace md
     } // end namespace hoomd
 
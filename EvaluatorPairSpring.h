@@ -82,7 +82,7 @@ class EvaluatorPairHarmSpring
             return v;
             }
 #endif
-        };
+        }
 #ifdef SINGLE_PRECISION
         __attribute__((aligned(8)));
 #else
@@ -182,6 +182,17 @@ class EvaluatorPairHarmSpring
        the HPF force compute.
     */
     DEVICE bool evalForceAndEnergyHPF(Scalar& force_divr, Scalar& pair_eng, Scalar& r, Scalar& rinv)
+        {
+        return evalForceAndEnergyGranular(force_divr, pair_eng, r, rinv);
+        }
+
+    /*! Specialization of the force/energy evaluator for GranularPotentialPair.
+
+        Returns r and 1/r alongside the force so the contact law does not need
+       to recompute them.
+    */
+    DEVICE bool
+    evalForceAndEnergyGranular(Scalar& force_divr, Scalar& pair_eng, Scalar& r, Scalar& rinv)
         {
         // compute the force divided by r in force_divr
         if (rsq < rcutsq && k != 0)
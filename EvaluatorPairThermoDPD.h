@@ -0,0 +1,248 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __PAIR_EVALUATOR_THERMO_DPD_H__
+#define __PAIR_EVALUATOR_THERMO_DPD_H__
+
+#ifndef __HIPCC__
+#include <string>
+#endif
+
+#include "hoomd/HOOMDMath.h"
+#include "hoomd/RNGIdentifiers.h"
+#include "hoomd/RandomNumbers.h"
+
+#include "EvaluatorPairMLJ.h"
+#include "EvaluatorPairWLJ.h"
+
+/*! \file EvaluatorPairThermoDPD.h
+    \brief Adds a DPD thermostat to a conservative pair evaluator
+*/
+
+// need to declare these class methods with __device__ qualifiers when building
+// in nvcc DEVICE is __host__ __device__ when included in nvcc and blank when
+// included into the host compiler
+#ifdef __HIPCC__
+#define DEVICE __device__
+#define HOSTDEVICE __host__ __device__
+#else
+#define DEVICE
+#define HOSTDEVICE
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! Conservative pair potential with a fused DPD thermostat
+/*! The evaluator follows the interface of HOOMD's EvaluatorPairDPDLJThermo,
+   so it is driven by PotentialPairDPDThermo and PotentialPairDPDThermoGPU:
+   the conservative force of \a base, the dissipative force and the random
+   force of every pair are computed in the same neighbor list traversal, with
+   one minimum image and one square root per pair.
+
+    With \f$ w(r) = 1 - r/r_{\mathrm{cut}} \f$ the added forces are
+    \f[ \vec{F}_D = -\gamma w(r)^2 (\hat{r}_{ij} \cdot \vec{v}_{ij})
+   \hat{r}_{ij} \f]
+    \f[ \vec{F}_R = \sqrt{\frac{6 \gamma k T}{\delta t}} w(r) \alpha
+   \hat{r}_{ij} \f]
+    where \f$ \alpha \f$ is uniform in [-1, 1]. Both are central and
+   antisymmetric in i, j, so momentum is conserved and the thermostat is
+   Galilean invariant. \f$ \alpha \f$ is drawn from a counter based RNG keyed
+   on the sorted tags of the pair, the time step and the simulation seed, so
+   both partners of a pair, on any rank, thread or device, draw the same
+   number without any shared state.
+
+    The conservative force is applied for r < r_cut exactly as \a base
+   computes it, also where \a base declines to evaluate (e.g. a zero
+   prefactor), in which case only the thermostat acts.
+
+    \tparam base Conservative pair evaluator
+*/
+template<class base> class EvaluatorPairThermoDPD : public base
+    {
+    public:
+    //! Parameters of \a base plus the drag coefficient
+    struct param_type
+        {
+        typename base::param_type cons; //!< Parameters of the conservative potential
+        Scalar gamma;                   //!< Drag coefficient
+
+        DEVICE void load_shared(char*& ptr, unsigned int& available_bytes)
+            {
+            cons.load_shared(ptr, available_bytes);
+            }
+
+        HOSTDEVICE void allocate_shared(char*& ptr, unsigned int& available_bytes) const
+            {
+            cons.allocate_shared(ptr, available_bytes);
+            }
+
+#ifdef ENABLE_HIP
+        //! Set CUDA memory hints
+        void set_memory_hint() const
+            {
+            cons.set_memory_hint();
+            }
+#endif
+
+#ifndef __HIPCC__
+        param_type() : cons(), gamma(0) { }
+
+        param_type(pybind11::dict v, bool managed = false)
+            : cons(v, managed), gamma(v["gamma"].cast<Scalar>())
+            {
+            }
+
+        pybind11::dict asDict()
+            {
+            pybind11::dict v = cons.asDict();
+            v["gamma"] = gamma;
+            return v;
+            }
+#endif
+        }
+#ifdef SINGLE_PRECISION
+        __attribute__((aligned(8)));
+#else
+        __attribute__((aligned(16)));
+#endif
+
+    //! Constructs the pair potential evaluator
+    /*! \param _rsq Squared distance between the particles
+        \param _rcutsq Squared distance at which the potential goes to 0
+        \param _params Per type pair parameters of this potential
+    */
+    DEVICE EvaluatorPairThermoDPD(Scalar _rsq, Scalar _rcutsq, const param_type& _params)
+        : base(_rsq, _rcutsq, _params.cons), gamma(_params.gamma)
+        {
+        }
+
+    //! Set the RNG seed, the tags of the pair and the time step
+    /*! \param seed User chosen random number seed
+        \param i Tag of particle i
+        \param j Tag of particle j
+        \param timestep Current time step
+    */
+    DEVICE void set_seed_ij_timestep(uint16_t seed, unsigned int i, unsigned int j, uint64_t timestep)
+        {
+        m_seed = seed;
+        m_i = i;
+        m_j = j;
+        m_timestep = timestep;
+        }
+
+    //! Set the time step size
+    DEVICE void setDeltaT(Scalar dt)
+        {
+        m_deltaT = dt;
+        }
+
+    //! Set the projection of the relative velocity on the separation
+    /*! \param dot \f$ \vec{r}_{ij} \cdot \vec{v}_{ij} \f$
+     */
+    DEVICE void setRDotV(Scalar dot)
+        {
+        m_dot = dot;
+        }
+
+    //! Set the temperature
+    DEVICE void setT(Scalar Temp)
+        {
+        m_T = Temp;
+        }
+
+    //! Evaluate the conservative force and energy only
+    DEVICE bool evalForceAndEnergy(Scalar& force_divr, Scalar& pair_eng, bool energy_shift)
+        {
+        if (this->rsq >= this->rcutsq)
+            return false;
+        if (!base::evalForceAndEnergy(force_divr, pair_eng, energy_shift))
+            {
+            force_divr = Scalar(0.0);
+            pair_eng = Scalar(0.0);
+            }
+        return true;
+        }
+
+    //! Evaluate the conservative, dissipative and random forces
+    /*! \param force_divr Output parameter to write the total force divided
+       by r \param force_divr_cons Output parameter to write the
+       conservative force divided by r, used for the virial \param pair_eng
+       Output parameter to write the computed pair energy \param
+       energy_shift If true, the potential must be shifted so that V(r) is
+       continuous at the cutoff
+
+        \return True if they are evaluated or false if they are not
+       because we are beyond the cutoff
+    */
+    DEVICE bool evalForceEnergyThermo(Scalar& force_divr,
+                                      Scalar& force_divr_cons,
+                                      Scalar& pair_eng,
+                                      bool energy_shift)
+        {
+        if (!evalForceAndEnergy(force_divr_cons, pair_eng, energy_shift))
+            return false;
+
+        Scalar rinv = fast::rsqrt(this->rsq);
+        Scalar r = Scalar(1.0) / rinv;
+        Scalar rcutinv = fast::rsqrt(this->rcutsq);
+        Scalar wR = Scalar(1.0) - r * rcutinv;
+
+        // the same number for (i, j) and (j, i)
+        unsigned int m_oi, m_oj;
+        if (m_i > m_j)
+            {
+            m_oi = m_j;
+            m_oj = m_i;
+            }
+        else
+            {
+            m_oi = m_i;
+            m_oj = m_j;
+            }
+        hoomd::RandomGenerator rng(
+            hoomd::Seed(hoomd::RNGIdentifier::EvaluatorPairDPDThermo, m_timestep, m_seed),
+            hoomd::Counter(m_oi, m_oj));
+        Scalar alpha = hoomd::UniformDistribution<Scalar>(-1, 1)(rng);
+
+        force_divr = force_divr_cons;
+        // drag term
+        force_divr -= gamma * m_dot * wR * wR * rinv * rinv;
+        // random force
+        force_divr += fast::rsqrt(m_deltaT / (m_T * gamma * Scalar(6.0))) * wR * rinv * alpha;
+        return true;
+        }
+
+#ifndef __HIPCC__
+    //! Get the name of this potential
+    /*! \returns The potential name.
+     */
+    static std::string getName()
+        {
+        return base::getName() + std::string("_dpd");
+        }
+#endif
+
+    protected:
+    Scalar gamma;             //!< Drag coefficient
+    uint16_t m_seed = 0;      //!< User set seed for the RNG
+    unsigned int m_i = 0;     //!< Tag of particle i
+    unsigned int m_j = 0;     //!< Tag of particle j
+    uint64_t m_timestep = 0;  //!< Current time step
+    Scalar m_deltaT = 0;      //!< Time step size
+    Scalar m_dot = 0;         //!< Projection of the relative velocity on the separation
+    Scalar m_T = 0;           //!< Temperature
+    };
+
+typedef EvaluatorPairThermoDPD<EvaluatorPairMLJ> EvaluatorPairMLJDPD;
+typedef EvaluatorPairThermoDPD<EvaluatorPairWLJ> EvaluatorPairWLJDPD;
+typedef EvaluatorPairThermoDPD<EvaluatorPairMLJApprox> EvaluatorPairMLJApproxDPD;
+typedef EvaluatorPairThermoDPD<EvaluatorPairWLJApprox> EvaluatorPairWLJApproxDPD;
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __PAIR_EVALUATOR_THERMO_DPD_H__
@@ -9,11 +9,15 @@
 
 #ifndef __HIPCC__
 #include <string>
+#include <vector>
 #endif
 
 // #include "hoomd/md/EvaluatorPairLJ.h"
 #include "hoomd/HOOMDMath.h"
 
+#include "ApproxMath.h"
+#include "EvaluatorPairMLJ.h"
+
 /*! \file EvaluatorPairWLJ.h
     \brief Defines the pair evaluator class for the modified LJ potential
     \details Modified version of the LJ potential
@@ -301,6 +305,75 @@ class EvaluatorPairWLJ
         return 0;
         }
 
+    //! Number of parameters with analytic derivatives
+    static const unsigned int num_params = 5;
+
+    //! Evaluate the derivatives of the force and energy with respect to the parameters
+    /*! \param dforce_divr Output, derivatives of the force divided by r in the
+       order of getParamNames() \param dpair_eng Output, derivatives of the
+       energy \param energy_shift If true, the potential is shifted so that
+       V(r) is continuous at the cutoff
+
+        Only the parameters of the branch at r enter, the other derivatives
+       are zero except for the energy offset of the repulsive branch. The
+       move of the branch point with sigma is not included.
+
+        \return False beyond the cutoff
+    */
+    DEVICE bool evalParamDerivatives(Scalar* dforce_divr, Scalar* dpair_eng, bool energy_shift)
+        {
+        if (rsq < rcutsq)
+            {
+            const Scalar c = Scalar(1.122462048309373); // 2^(1/6)
+            Scalar sigma = fast::sqrt(min_sqr) / c;
+            bool repulsive = rsq < min_sqr;
+            Scalar epsilon = repulsive ? epsilon_r : epsilon_a;
+            Scalar dlt = repulsive ? dlt_r : dlt_a;
+
+            Scalar dforce[3];
+            Scalar deng[3];
+            detail::mljParamDerivatives(fast::sqrt(rsq), epsilon, sigma, dlt, dforce, deng);
+            if (energy_shift)
+                {
+                Scalar dforce_cut[3];
+                Scalar deng_cut[3];
+                detail::mljParamDerivatives(fast::sqrt(rcutsq),
+                                            epsilon,
+                                            sigma,
+                                            dlt,
+                                            dforce_cut,
+                                            deng_cut);
+                for (unsigned int k = 0; k < 3; k++)
+                    deng[k] -= deng_cut[k];
+                }
+
+            // epsilon, delta of the branch and the shared sigma
+            const unsigned int eps_idx = repulsive ? 0 : 3;
+            const unsigned int dlt_idx = repulsive ? 2 : 4;
+            for (unsigned int k = 0; k < num_params; k++)
+                {
+                dforce_divr[k] = Scalar(0.0);
+                dpair_eng[k] = Scalar(0.0);
+                }
+            dforce_divr[eps_idx] = dforce[0];
+            dforce_divr[1] = dforce[1];
+            dforce_divr[dlt_idx] = dforce[2];
+            dpair_eng[eps_idx] = deng[0];
+            dpair_eng[1] = deng[1];
+            dpair_eng[dlt_idx] = deng[2];
+
+            // the repulsive branch is offset by epsilon - epsilon_a
+            if (repulsive)
+                {
+                dpair_eng[0] += Scalar(1.0);
+                dpair_eng[3] -= Scalar(1.0);
+                }
+            return true;
+            }
+        else
+            return false;
+        }
+
 #ifndef __HIPCC__
     //! Get the name of this potential
     /*! \returns The potential name.
@@ -310,6 +383,12 @@ class EvaluatorPairWLJ
         return std::string("wodlj");
         }
 
+    //! Get the names of the parameters with analytic derivatives
+    static std::vector<std::string> getParamNames()
+        {
+        return {"epsilon", "sigma", "delta", "epsilon_a", "delta_a"};
+        }
+
     std::string getShapeSpec() const
         {
         throw std::runtime_error("Shape definition not supported for this pair potential.");
@@ -338,6 +417,62 @@ class EvaluatorPairWLJ
     Scalar min_sqr;
     };
 
+//! WLJ pair potential evaluated with approximate math
+/*! Same approximations and error bound as EvaluatorPairMLJApprox.
+ */
+class EvaluatorPairWLJApprox : public EvaluatorPairWLJ
+    {
+    public:
+    DEVICE EvaluatorPairWLJApprox(Scalar _rsq, Scalar _rcutsq, const param_type& _params)
+        : EvaluatorPairWLJ(_rsq, _rcutsq, _params)
+        {
+        }
+
+    DEVICE bool evalForceAndEnergy(Scalar& force_divr, Scalar& pair_eng, bool energy_shift)
+        {
+        if (rsq < rcutsq)
+            {
+            Scalar lj1 = lj1_a;
+            Scalar lj2 = lj2_a;
+            Scalar dlt = dlt_a;
+            Scalar shift = 0.0;
+            if (rsq < min_sqr)
+                {
+                lj1 = lj1_r;
+                lj2 = lj2_r;
+                dlt = dlt_r;
+                shift = -epsilon_a + epsilon_r;
+                }
+            Scalar rinv_std = approx::rsqrt<2>(rsq);
+            Scalar rinv = approx::rcp<2>(rsq * rinv_std - dlt);
+            Scalar r2inv = rinv * rinv;
+
+            Scalar r6inv = r2inv * r2inv * r2inv;
+            force_divr = rinv_std * rinv * r6inv * (Scalar(12.0) * lj1 * r6inv - Scalar(6.0) * lj2);
+
+            pair_eng = r6inv * (lj1 * r6inv - lj2) + shift;
+
+            if (energy_shift)
+                {
+                Scalar rcutinv = Scalar(1.0) / (fast::sqrt(rcutsq) - dlt);
+                Scalar rcut2inv = rcutinv * rcutinv;
+                Scalar rcut6inv = rcut2inv * rcut2inv * rcut2inv;
+                pair_eng -= rcut6inv * (lj1 * rcut6inv - lj2);
+                }
+            return true;
+            }
+        else
+            return false;
+        }
+
+#ifndef __HIPCC__
+    static std::string getName()
+        {
+        return std::string("wodlj_approx");
+        }
+#endif
+    };
+
     } // end namespace md
     } // end namespace hoomd
 
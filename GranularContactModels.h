@@ -0,0 +1,211 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __GRANULAR_CONTACT_MODELS_H__
+#define __GRANULAR_CONTACT_MODELS_H__
+
+#ifndef __HIPCC__
+#include <string>
+#endif
+
+#include "hoomd/HOOMDMath.h"
+
+/*! \file GranularContactModels.h
+    \brief Defines the contact law policies used by GranularPotentialPair
+    \details The evaluator supplies the conservative normal force. The policies
+   below decide how the dissipative normal force and the tangential, rolling and
+   twisting springs are built on top of it. They are passed as template
+   parameters to GranularPotentialPair and selected at export time in module.cc,
+   so every query below is resolved at compile time and the inner loop of a given
+   instantiation carries no runtime model switch.
+*/
+
+// need to declare these class methods with __device__ qualifiers when building
+// in nvcc DEVICE is __host__ __device__ when included in nvcc and blank when
+// included into the host compiler
+#ifdef __HIPCC__
+#define DEVICE __device__
+#define HOSTDEVICE __host__ __device__
+#else
+#define DEVICE
+#define HOSTDEVICE
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+
+//! Linear tangential spring with no normal damping
+/*! This is the original GranularPotentialPair contact law: the sliding spring
+   has a constant stiffness \a ks and the normal force is purely the
+   conservative one returned by the evaluator.
+*/
+struct ContactLawLinear
+    {
+    //! The linear law does not dissipate in the normal direction
+    DEVICE static bool hasNormalDamping()
+        {
+        return false;
+        }
+
+    //! The linear law does not depend on the overlap
+    DEVICE static bool needsOverlap()
+        {
+        return false;
+        }
+
+    //! Stiffness of the sliding spring
+    /*! \param ks Sliding spring constant
+        \param a_ij Effective contact diameter 2 r_i r_j / (r_i + r_j)
+        \param overlap Overlap between the two particles
+    */
+    DEVICE static Scalar tangentialStiffness(Scalar ks, Scalar a_ij, Scalar overlap)
+        {
+        return ks;
+        }
+
+    //! Normal damping coefficient
+    /*! \param gamma_n Normal damping constant
+        \param a_ij Effective contact diameter
+        \param overlap Overlap between the two particles
+    */
+    DEVICE static Scalar normalDamping(Scalar gamma_n, Scalar a_ij, Scalar overlap)
+        {
+        return Scalar(0.0);
+        }
+
+#ifndef __HIPCC__
+    static std::string getName()
+        {
+        return std::string("linear");
+        }
+#endif
+    };
+
+//! Hookean spring-dashpot contact law
+/*! Constant tangential stiffness \a ks and a viscous normal dashpot
+    \f$ \vec{F}_n^{d} = -\gamma_n (\vec{v}_{ij} \cdot \hat{n}) \hat{n} \f$.
+*/
+struct ContactLawHookean
+    {
+    //! Hookean contacts carry a normal dashpot
+    DEVICE static bool hasNormalDamping()
+        {
+        return true;
+        }
+
+    //! Hookean contacts do not depend on the overlap
+    DEVICE static bool needsOverlap()
+        {
+        return false;
+        }
+
+    DEVICE static Scalar tangentialStiffness(Scalar ks, Scalar a_ij, Scalar overlap)
+        {
+        return ks;
+        }
+
+    DEVICE static Scalar normalDamping(Scalar gamma_n, Scalar a_ij, Scalar overlap)
+        {
+        return gamma_n;
+        }
+
+#ifndef __HIPCC__
+    static std::string getName()
+        {
+        return std::string("hookean");
+        }
+#endif
+    };
+
+//! Hertz-Mindlin contact law
+/*! The tangential stiffness grows with the contact radius,
+    \f$ k_t = k_s \sqrt{a_{ij} \delta} \f$, and the normal dashpot scales as
+    \f$ \gamma_n (a_{ij} \delta)^{1/4} \f$ so that the coefficient of restitution
+    is independent of the impact velocity. Pair with EvaluatorPairHertzian for
+    the conservative normal force.
+*/
+struct ContactLawHertzMindlin
+    {
+    //! Hertz-Mindlin contacts carry a normal dashpot
+    DEVICE static bool hasNormalDamping()
+        {
+        return true;
+        }
+
+    //! Stiffness and damping both depend on the overlap
+    DEVICE static bool needsOverlap()
+        {
+        return true;
+        }
+
+    DEVICE static Scalar tangentialStiffness(Scalar ks, Scalar a_ij, Scalar overlap)
+        {
+        return ks * fast::sqrt(a_ij * overlap);
+        }
+
+    DEVICE static Scalar normalDamping(Scalar gamma_n, Scalar a_ij, Scalar overlap)
+        {
+        return gamma_n * fast::sqrt(fast::sqrt(a_ij * overlap));
+        }
+
+#ifndef __HIPCC__
+    static std::string getName()
+        {
+        return std::string("hertz_mindlin");
+        }
+#endif
+    };
+
+//! Rolling spring with Coulomb capping (stiffness \a kr, coefficient \a mur)
+struct RollingSpring
+    {
+    DEVICE static bool hasRolling()
+        {
+        return true;
+        }
+
+    DEVICE static bool hasTwisting()
+        {
+        return false;
+        }
+
+#ifndef __HIPCC__
+    static std::string getName()
+        {
+        return std::string("rolling");
+        }
+#endif
+    };
+
+//! Rolling spring plus a twisting spring about the contact normal
+/*! The twisting spring has stiffness \a kt and is capped at
+    \f$ \mu_t a_{ij} |\vec{F}_n| \f$.
+*/
+struct RollingTwistingSpring
+    {
+    DEVICE static bool hasRolling()
+        {
+        return true;
+        }
+
+    DEVICE static bool hasTwisting()
+        {
+        return true;
+        }
+
+#ifndef __HIPCC__
+    static std::string getName()
+        {
+        return std::string("rolling_twisting");
+        }
+#endif
+    };
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __GRANULAR_CONTACT_MODELS_H__
@@ -0,0 +1,596 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __GRANULAR_PAIR_KERNEL_H__
+#define __GRANULAR_PAIR_KERNEL_H__
+
+#include <stdint.h>
+
+#include "hoomd/BoxDim.h"
+#include "hoomd/HOOMDMath.h"
+#include "hoomd/Index1D.h"
+#include "hoomd/ParticleData.cuh"
+#include "hoomd/VectorMath.h"
+
+#include "GranularContactModels.h"
+
+/*! \file GranularPairKernel.h
+    \brief Single source granular contact code shared by the CPU and GPU
+   force computes
+    \details granular_contact() holds the physics of one contact on top of the
+   conservative normal force. granular_particle_forces() is the per particle
+   body: it walks the neighbors of one particle, evaluates every contact and
+   accumulates the force, torque, energy and virial on that particle only.
+
+    The body is templated on an execution backend that decides which
+   neighbors a lane visits and how the lanes of one particle are reduced.
+   SerialBackend (one lane, no reduction) is used by the threaded CPU engine of
+   GranularPotentialPair, and WarpBackend (GranularPotentialPairGPU.cuh) runs
+   \a tpp lanes per particle with a warp reduction. Because the body only
+   writes to its own particle and to the history slots of its own neighbor
+   list row, it needs a full neighbor list and is free of races.
+*/
+
+// need to declare these class methods with __device__ qualifiers when building
+// in nvcc DEVICE is __host__ __device__ when included in nvcc and blank when
+// included into the host compiler
+#ifdef __HIPCC__
+#define DEVICE __device__
+#define HOSTDEVICE __host__ __device__
+#else
+#define DEVICE
+#define HOSTDEVICE
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+namespace kernel
+    {
+//! Friction and damping coefficients shared by all contacts
+struct granular_coeffs_t
+    {
+    Scalar mus;     //!< Sliding friction coefficient
+    Scalar mur;     //!< Rolling friction coefficient
+    Scalar ks;      //!< Sliding friction spring constant
+    Scalar kr;      //!< Rolling friction spring constant
+    Scalar gamma_n; //!< Normal damping constant
+    Scalar mut;     //!< Twisting friction coefficient
+    Scalar kt;      //!< Twisting friction spring constant
+    Scalar deltaT;  //!< Time step, used to integrate the history
+    };
+
+//! Real space angular velocity of one particle
+/*! \param orientation Orientation quaternion
+    \param angmom Angular momentum quaternion
+    \param inertia Principal moments of inertia
+
+    Axes with a zero moment of inertia do not rotate.
+*/
+HOSTDEVICE inline Scalar3
+angular_velocity(const Scalar4& orientation, const Scalar4& angmom, const Scalar3& inertia)
+    {
+    quat<Scalar> q(orientation);
+    quat<Scalar> p(angmom);
+    vec3<Scalar> s((conj(q) * p).v / Scalar(2.0));
+    vec3<Scalar> w(inertia.x == Scalar(0.0) ? Scalar(0.0) : s.x / inertia.x,
+                   inertia.y == Scalar(0.0) ? Scalar(0.0) : s.y / inertia.y,
+                   inertia.z == Scalar(0.0) ? Scalar(0.0) : s.z / inertia.z);
+    return vec_to_scalar3(rotate(q, w)); // body frame to real frame
+    }
+
+//! Entry of the inner contact list
+/*! Packs the offset of a pair in the neighbor list row of i and the index of
+   the neighbor relative to i into 32 bits, so that the force loop reads one
+   word per pair instead of a row offset and a neighbor index. After a
+   spatial sort most neighbors are close to i in index; neighbors further
+   than the range of \a delta (ghosts, mostly) store \a escape and are read
+   from the neighbor list.
+*/
+struct compact_neighbor_t
+    {
+    uint16_t offset; //!< Offset of the pair in the neighbor list row of i
+    int16_t delta;   //!< j - i, or escape
+
+    static constexpr int16_t escape = -32768; //!< j is too far from i, read the neighbor list
+    };
+
+//! Encode the pair (i, j) found at \a offset in the neighbor list row of i
+HOSTDEVICE inline compact_neighbor_t
+make_compact_neighbor(unsigned int i, unsigned int j, unsigned int offset)
+    {
+    compact_neighbor_t entry;
+    entry.offset = uint16_t(offset);
+    const int delta = int(j) - int(i);
+    entry.delta = (delta > compact_neighbor_t::escape && delta <= 32767)
+                      ? int16_t(delta)
+                      : compact_neighbor_t::escape;
+    return entry;
+    }
+
+//! Decode the neighbor index of an inner contact list entry of particle i
+/*! \param entry Inner contact list entry
+    \param i Index of the particle that owns the row
+    \param nlist Neighbor list, read for escaped entries only
+    \param slot Neighbor list slot of the pair
+*/
+HOSTDEVICE inline unsigned int decode_compact_neighbor(const compact_neighbor_t& entry,
+                                                       unsigned int i,
+                                                       const unsigned int* nlist,
+                                                       size_t slot)
+    {
+    return entry.delta != compact_neighbor_t::escape ? (unsigned int)(int(i) + entry.delta)
+                                                     : nlist[slot];
+    }
+
+//! Check whether two particles are sub-spheres of the same rigid clump
+/*! \param body Body tag of every local and ghost particle, null when clumps
+   are disabled. Free particles (NO_BODY) and floppy bodies never match.
+*/
+HOSTDEVICE inline bool same_clump(const unsigned int* body, unsigned int i, unsigned int j)
+    {
+    return body && body[i] < MIN_FLOPPY && body[i] == body[j];
+    }
+
+//! Check whether neither particle of a pair is active
+/*! \param active Active flag of every local and ghost particle, null when
+   all particles are active.
+*/
+HOSTDEVICE inline bool frozen_pair(const unsigned char* active, unsigned int i, unsigned int j)
+    {
+    return active && !active[i] && !active[j];
+    }
+
+//! Minimum image separation of two quantized positions
+/*! Quantized positions hold the fractional coordinates in the global box
+   scaled to the range of 32 bit unsigned integers, and the type in \a w.
+   Unsigned differences wrap around, so their signed value is the minimum
+   image fractional separation of a periodic box, with a resolution of
+   L / 2^32.
+
+    \param box Global simulation box
+    \param a Quantized position of the first particle
+    \param b Quantized position of the second particle
+    \returns Separation a - b
+*/
+HOSTDEVICE inline Scalar3 packed_separation(const BoxDim& box, const uint4& a, const uint4& b)
+    {
+    const Scalar scale = Scalar(1.0) / Scalar(4294967296.0);
+    const Scalar3 L = box.getL();
+    const Scalar fx = Scalar(int(a.x - b.x)) * scale * L.x;
+    const Scalar fy = Scalar(int(a.y - b.y)) * scale * L.y;
+    const Scalar fz = Scalar(int(a.z - b.z)) * scale * L.z;
+    return make_scalar3(fx + box.getTiltFactorXY() * fy + box.getTiltFactorXZ() * fz,
+                        fy + box.getTiltFactorYZ() * fz,
+                        fz);
+    }
+
+//! Arguments of granular_particle_forces()
+/*! All pointers address the memory of the backend that runs the body (host
+   or device). \a d_inner_nlist and \a d_inner_n_neigh may be null, in which
+   case the full neighbor list rows are walked. \a d_body is null unless
+   pairs within one clump are to be skipped, \a d_active is null unless
+   pairs of two frozen particles are to be skipped, and \a d_temperature is
+   null unless the contact heat flow is written to \a d_heat_flow.
+   When \a d_packed_pos is set, neighbor positions and types are read from it
+   instead of \a d_pos.
+*/
+template<class param_type> struct granular_args_t
+    {
+    Scalar4* d_force;    //!< Force (and energy) to write
+    Scalar4* d_torque;   //!< Torque to write
+    Scalar* d_virial;    //!< Virial to write
+    size_t virial_pitch; //!< Pitch of the virial array
+
+    const Scalar4* d_pos;      //!< Particle positions and types
+    const uint4* d_packed_pos; //!< Quantized positions and types of the neighbors
+    const Scalar4* d_vel;      //!< Particle velocities
+    const Scalar* d_diameter;  //!< Particle diameters
+    const Scalar* d_charge;    //!< Particle charges
+    const Scalar3* d_omega;    //!< Real space angular velocities
+
+    const unsigned int* d_n_neigh;       //!< Number of neighbors of each particle
+    const unsigned int* d_nlist;         //!< Neighbor list
+    const size_t* d_head_list;           //!< Head of each particle's row
+    const compact_neighbor_t* d_inner_nlist; //!< Inner contact list
+    const unsigned int* d_inner_n_neigh; //!< Number of inner contacts of each particle
+    const unsigned int* d_body;          //!< Body tag of each particle
+    const unsigned char* d_active;       //!< Active flag of each particle
+    const Scalar* d_temperature;         //!< Temperature of each particle
+    Scalar* d_heat_flow;                 //!< Heat flow to write
+
+    Scalar3* d_xi;  //!< Sliding history, per neighbor list slot
+    Scalar3* d_psi; //!< Rolling history, per neighbor list slot
+    Scalar* d_phi;  //!< Twisting history, per neighbor list slot
+
+    const Scalar* d_rcutsq;      //!< r_cut squared per type pair
+    const param_type* d_params;  //!< Evaluator parameters per type pair
+    unsigned int ntypes;         //!< Number of particle types
+
+    BoxDim box;               //!< Global simulation box
+    granular_coeffs_t coeffs; //!< Contact coefficients
+    Scalar gamma;             //!< Drag coefficient of the hydrodynamic background
+    Scalar3 hi_shear_rate;    //!< Shear rate of the hydrodynamic background
+    Scalar conductivity;      //!< Thermal conductivity of the grains
+    bool compute_virial;      //!< True when the virial is requested
+    };
+
+//! Backend for one lane per particle on the host
+struct SerialBackend
+    {
+    //! Index of this lane among the lanes of a particle
+    unsigned int lane() const
+        {
+        return 0;
+        }
+
+    //! Number of lanes per particle
+    unsigned int width() const
+        {
+        return 1;
+        }
+
+    //! Sum over the lanes of a particle
+    Scalar sum(Scalar x)
+        {
+        return x;
+        }
+    };
+
+//! Heat flow into i through its contact with j
+/*! \param conductivity Thermal conductivity of the grains
+    \param di Radius of particle i
+    \param dj Radius of particle j
+    \param r Separation distance
+    \param rcutsq Contact distance squared
+    \param T_i Temperature of particle i
+    \param T_j Temperature of particle j
+
+    The conductance of a contact is \f$ 2 k a \f$ with the Hertzian contact
+   radius \f$ a = \sqrt{R^* \delta} \f$, \f$ R^* = r_i r_j / (r_i + r_j) \f$
+   and the overlap \f$ \delta \f$ taken from the contact distance, like the
+   overlap of the contact laws.
+*/
+HOSTDEVICE inline Scalar contact_heat_flow(Scalar conductivity,
+                                           Scalar di,
+                                           Scalar dj,
+                                           Scalar r,
+                                           Scalar rcutsq,
+                                           Scalar T_i,
+                                           Scalar T_j)
+    {
+    const Scalar overlap = fast::sqrt(rcutsq) - r;
+    const Scalar r_eff = di * dj / (di + dj);
+    return Scalar(2.0) * conductivity * fast::sqrt(r_eff * overlap) * (T_j - T_i);
+    }
+
+//! Dissipative and frictional forces of one contact
+/*! \param c Contact coefficients
+    \param dx Separation r_i - r_j (minimum image)
+    \param r Separation distance
+    \param rinv 1 / r
+    \param rcutsq Contact distance squared
+    \param force_divr Conservative normal force divided by r
+    \param di Radius of particle i
+    \param dj Radius of particle j
+    \param v_i Velocity of particle i
+    \param v_j Velocity of particle j
+    \param w_i Angular velocity of particle i
+    \param w_j Angular velocity of particle j
+    \param xi Sliding history of the contact (updated)
+    \param psi Rolling history of the contact (updated)
+    \param phi Twisting history of the contact (updated)
+    \param force Output: total force on i
+    \param torque_i Output: torque on i
+    \param torque_j Output: torque on j
+
+    The sliding history is antisymmetric under i <-> j and the rolling and
+   twisting histories are symmetric, so evaluating the same contact from the
+   row of j gives -force and torque_j.
+*/
+template<class contact_law, class rolling_model>
+DEVICE inline void granular_contact(const granular_coeffs_t& c,
+                                    const Scalar3& dx,
+                                    Scalar r,
+                                    Scalar rinv,
+                                    Scalar rcutsq,
+                                    Scalar force_divr,
+                                    Scalar di,
+                                    Scalar dj,
+                                    const vec3<Scalar>& v_i,
+                                    const vec3<Scalar>& v_j,
+                                    const vec3<Scalar>& w_i,
+                                    const vec3<Scalar>& w_j,
+                                    Scalar3& xi,
+                                    Scalar3& psi,
+                                    Scalar& phi,
+                                    vec3<Scalar>& force,
+                                    vec3<Scalar>& torque_i,
+                                    vec3<Scalar>& torque_j)
+    {
+    vec3<Scalar> v_unit_dx(dx.x * rinv, dx.y * rinv, dx.z * rinv);
+    vec3<Scalar> v_ij = v_j - v_i;
+
+    Scalar a_ij = Scalar(2.0) * di * dj / (di + dj);
+    Scalar overlap = Scalar(0.0);
+    if (contact_law::needsOverlap())
+        overlap = fast::sqrt(rcutsq) - r;
+
+    // conservative normal force from the evaluator
+    force = force_divr * vec3<Scalar>(dx.x, dx.y, dx.z);
+    Scalar force_sqr = force_divr * force_divr * r * r;
+
+    // dissipative normal force, pushes i away from j while they approach
+    if (contact_law::hasNormalDamping())
+        {
+        Scalar gamma_n = contact_law::normalDamping(c.gamma_n, a_ij, overlap);
+        force += gamma_n * dot(v_ij, v_unit_dx) * v_unit_dx;
+        }
+
+    // sliding friction
+    vec3<Scalar> xi_ij(xi);
+    vec3<Scalar> force_slide = contact_law::tangentialStiffness(c.ks, a_ij, overlap) * xi_ij;
+    Scalar slide_sqr = dot(force_slide, force_slide);
+    if (slide_sqr > c.mus * c.mus * force_sqr)
+        force_slide *= c.mus * fast::rsqrt(slide_sqr) * force_divr * r;
+
+    force += force_slide;
+
+    vec3<Scalar> torque_slide = cross(v_unit_dx, force_slide);
+    torque_i = di * torque_slide;
+    torque_j = dj * torque_slide;
+
+    vec3<Scalar> ur_pre = v_ij - cross(di * w_i + dj * w_j, v_unit_dx);
+    vec3<Scalar> ur_t = ur_pre - v_unit_dx * dot(ur_pre, v_unit_dx);
+    xi = vec_to_scalar3(xi_ij + ur_t * c.deltaT);
+
+    // rolling friction
+    if (rolling_model::hasRolling())
+        {
+        vec3<Scalar> psi_ij(psi);
+        vec3<Scalar> force_roll = c.kr * psi_ij;
+        Scalar roll_sqr = dot(force_roll, force_roll);
+        if (roll_sqr > c.mur * c.mur * force_sqr)
+            force_roll *= c.mur * fast::rsqrt(roll_sqr) * force_divr * r;
+
+        vec3<Scalar> torque_roll = cross(v_unit_dx, force_roll);
+        torque_i += a_ij * torque_roll;
+        torque_j -= a_ij * torque_roll;
+
+        psi = vec_to_scalar3(psi_ij + a_ij * cross(w_i - w_j, v_unit_dx) * c.deltaT);
+        }
+
+    // twisting friction about the contact normal
+    if (rolling_model::hasTwisting())
+        {
+        Scalar torque_twist = c.kt * phi;
+        Scalar twist_max = c.mut * a_ij * fast::sqrt(force_sqr);
+        if (torque_twist * torque_twist > twist_max * twist_max)
+            torque_twist = torque_twist > Scalar(0.0) ? twist_max : -twist_max;
+
+        torque_i += torque_twist * v_unit_dx;
+        torque_j -= torque_twist * v_unit_dx;
+
+        phi = phi + dot(w_j - w_i, v_unit_dx) * c.deltaT;
+        }
+    }
+
+//! Compute the granular forces on one particle
+/*! \param args Arguments, see granular_args_t
+    \param i Index of the particle
+    \param active False for padding lanes, which only join the reduction
+    \param backend Execution backend (lane layout and reduction)
+
+    The force, torque, energy and virial of \a i are written to the output
+   arrays by lane 0, replacing what was there, so the arrays need not be
+   zeroed first. Contacts that are not evaluated have their history
+   cleared.
+*/
+template<class evaluator, class contact_law, class rolling_model, class Backend>
+DEVICE inline void
+granular_particle_forces(const granular_args_t<typename evaluator::param_type>& args,
+                         unsigned int i,
+                         bool active,
+                         Backend& backend)
+    {
+    Index2D typpair_idx(args.ntypes);
+
+    Scalar3 fi = make_scalar3(0, 0, 0);
+    Scalar3 ti = make_scalar3(0, 0, 0);
+    Scalar pei = Scalar(0.0);
+    Scalar virialxxi = Scalar(0.0);
+    Scalar virialxyi = Scalar(0.0);
+    Scalar virialxzi = Scalar(0.0);
+    Scalar virialyyi = Scalar(0.0);
+    Scalar virialyzi = Scalar(0.0);
+    Scalar virialzzi = Scalar(0.0);
+    Scalar heat_i = Scalar(0.0);
+
+    if (active)
+        {
+        Scalar4 postypei = args.d_pos[i];
+        Scalar3 pi = make_scalar3(postypei.x, postypei.y, postypei.z);
+        unsigned int typei = __scalar_as_int(postypei.w);
+        const uint4 packedi = args.d_packed_pos ? args.d_packed_pos[i] : make_uint4(0, 0, 0, 0);
+
+        vec3<Scalar> v_i(args.d_vel[i].x, args.d_vel[i].y, args.d_vel[i].z);
+        vec3<Scalar> w_i(args.d_omega[i]);
+
+        Scalar di = Scalar(0.5) * args.d_diameter[i];
+        Scalar qi = Scalar(0.0);
+        if (evaluator::needsCharge())
+            qi = args.d_charge[i];
+
+        const size_t myHead = args.d_head_list[i];
+        const unsigned int size
+            = args.d_inner_n_neigh ? args.d_inner_n_neigh[i] : args.d_n_neigh[i];
+        for (unsigned int k = backend.lane(); k < size; k += backend.width())
+            {
+            size_t slot = myHead + k;
+            unsigned int j;
+            if (args.d_inner_nlist)
+                {
+                const compact_neighbor_t entry = args.d_inner_nlist[myHead + k];
+                slot = myHead + entry.offset;
+                j = decode_compact_neighbor(entry, i, args.d_nlist, slot);
+                }
+            else
+                {
+                j = args.d_nlist[slot];
+                }
+            if (same_clump(args.d_body, i, j) || frozen_pair(args.d_active, i, j))
+                continue;
+
+            Scalar3 dx;
+            unsigned int typej;
+            if (args.d_packed_pos)
+                {
+                const uint4 packedj = args.d_packed_pos[j];
+                dx = packed_separation(args.box, packedi, packedj);
+                typej = packedj.w;
+                }
+            else
+                {
+                Scalar4 postypej = args.d_pos[j];
+                dx = args.box.minImage(pi - make_scalar3(postypej.x, postypej.y, postypej.z));
+                typej = __scalar_as_int(postypej.w);
+                }
+
+            Scalar dj = Scalar(0.5) * args.d_diameter[j];
+            Scalar qj = Scalar(0.0);
+            if (evaluator::needsCharge())
+                qj = args.d_charge[j];
+
+            Scalar rsq = dot(dx, dx);
+
+            unsigned int typpair = typpair_idx(typei, typej);
+            Scalar rcutsq = args.d_rcutsq[typpair];
+
+            Scalar force_divr = Scalar(0.0);
+            Scalar pair_eng = Scalar(0.0);
+            Scalar r = Scalar(0.0);
+            Scalar rinv = Scalar(0.0);
+            evaluator eval(rsq, rcutsq, args.d_params[typpair]);
+            if (evaluator::needsDiameter())
+                eval.setDiameter(di, dj);
+            if (evaluator::needsCharge())
+                eval.setCharge(qi, qj);
+
+            if (eval.evalForceAndEnergyGranular(force_divr, pair_eng, r, rinv))
+                {
+                vec3<Scalar> v_j(args.d_vel[j].x, args.d_vel[j].y, args.d_vel[j].z);
+                vec3<Scalar> w_j(args.d_omega[j]);
+
+                vec3<Scalar> force;
+                vec3<Scalar> torque_i;
+                vec3<Scalar> torque_j;
+                granular_contact<contact_law, rolling_model>(args.coeffs,
+                                                             dx,
+                                                             r,
+                                                             rinv,
+                                                             rcutsq,
+                                                             force_divr,
+                                                             di,
+                                                             dj,
+                                                             v_i,
+                                                             v_j,
+                                                             w_i,
+                                                             w_j,
+                                                             args.d_xi[slot],
+                                                             args.d_psi[slot],
+                                                             args.d_phi[slot],
+                                                             force,
+                                                             torque_i,
+                                                             torque_j);
+
+                fi += make_scalar3(force.x, force.y, force.z);
+                ti += make_scalar3(torque_i.x, torque_i.y, torque_i.z);
+                pei += pair_eng * Scalar(0.5);
+                if (args.d_temperature)
+                    heat_i += contact_heat_flow(args.conductivity,
+                                                di,
+                                                dj,
+                                                r,
+                                                rcutsq,
+                                                args.d_temperature[i],
+                                                args.d_temperature[j]);
+                if (args.compute_virial)
+                    {
+                    Scalar3 force2 = make_scalar3(force.x, force.y, force.z) * Scalar(0.5);
+                    virialxxi += dx.x * force2.x;
+                    virialxyi += dx.y * force2.x;
+                    virialxzi += dx.z * force2.x;
+                    virialyyi += dx.y * force2.y;
+                    virialyzi += dx.z * force2.y;
+                    virialzzi += dx.z * force2.z;
+                    }
+                }
+            else
+                {
+                // contact is broken, forget its history
+                args.d_xi[slot] = make_scalar3(0.0, 0.0, 0.0);
+                if (rolling_model::hasRolling())
+                    args.d_psi[slot] = make_scalar3(0.0, 0.0, 0.0);
+                if (rolling_model::hasTwisting())
+                    args.d_phi[slot] = Scalar(0.0);
+                }
+            }
+
+        if (args.gamma != Scalar(0.0) && backend.lane() == 0)
+            {
+            const Scalar drag = args.gamma * args.coeffs.deltaT;
+            const Scalar3& sr = args.hi_shear_rate;
+            fi.x -= (v_i.x - sr.x * pi.y - sr.y * pi.z) * drag;
+            fi.y -= (v_i.y - sr.z * pi.z) * drag;
+            fi.z -= v_i.z * drag;
+            ti.x -= w_i.x * drag;
+            ti.y -= w_i.y * drag;
+            ti.z -= w_i.z * drag;
+            }
+        }
+
+    fi.x = backend.sum(fi.x);
+    fi.y = backend.sum(fi.y);
+    fi.z = backend.sum(fi.z);
+    ti.x = backend.sum(ti.x);
+    ti.y = backend.sum(ti.y);
+    ti.z = backend.sum(ti.z);
+    pei = backend.sum(pei);
+    if (args.d_temperature)
+        heat_i = backend.sum(heat_i);
+    if (args.compute_virial)
+        {
+        virialxxi = backend.sum(virialxxi);
+        virialxyi = backend.sum(virialxyi);
+        virialxzi = backend.sum(virialxzi);
+        virialyyi = backend.sum(virialyyi);
+        virialyzi = backend.sum(virialyzi);
+        virialzzi = backend.sum(virialzzi);
+        }
+
+    if (active && backend.lane() == 0)
+        {
+        args.d_force[i] = make_scalar4(fi.x, fi.y, fi.z, pei);
+        args.d_torque[i] = make_scalar4(ti.x, ti.y, ti.z, Scalar(0.0));
+        if (args.d_temperature)
+            args.d_heat_flow[i] = heat_i;
+        if (args.compute_virial)
+            {
+            args.d_virial[0 * args.virial_pitch + i] = virialxxi;
+            args.d_virial[1 * args.virial_pitch + i] = virialxyi;
+            args.d_virial[2 * args.virial_pitch + i] = virialxzi;
+            args.d_virial[3 * args.virial_pitch + i] = virialyyi;
+            args.d_virial[4 * args.virial_pitch + i] = virialyzi;
+            args.d_virial[5 * args.virial_pitch + i] = virialzzi;
+            }
+        }
+    }
+
+    } // end namespace kernel
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __GRANULAR_PAIR_KERNEL_H__
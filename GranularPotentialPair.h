@@ -4,11 +4,13 @@
 #ifndef __GRANULAR_POTENTIAL_PAIR_H__
 #define __GRANULAR_POTENTIAL_PAIR_H__
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <stdexcept>
+#include <vector>
 
 #include "hoomd/ForceCompute.h"
 #include "hoomd/GSDShapeSpecWriter.h"
@@ -19,6 +21,14 @@
 #include "hoomd/md/EvaluatorPairLJ.h"
 #include "hoomd/md/NeighborList.h"
 
+#include "ActiveMask.h"
+#include "GranularContactModels.h"
+#include "CpuDispatch.h"
+#include "GranularPairKernel.h"
+#include "HostArrayPlacement.h"
+#include "StressProfile.h"
+#include "WorkerPool.h"
+
 #ifdef ENABLE_HIP
 #include <hip/hip_runtime.h>
 #endif
@@ -72,8 +82,20 @@ struct pair_hash
    param_type in the potential evaluator class passed in. See the
    appropriate documentation for the evaluator for the definition of
    each element of the parameters.
+
+    <b>Contact laws</b>
+
+    The evaluator only provides the conservative normal force. The
+   dissipative normal force and the tangential spring are chosen by \a
+   contact_law (ContactLawLinear, ContactLawHookean,
+   ContactLawHertzMindlin) and the rolling/twisting resistance by \a
+   rolling_model (RollingSpring, RollingTwistingSpring).
+   See GranularContactModels.h. Every combination is its own template
+   instantiation, so the model queries in the inner loop are compile
+   time constants.
 */
-template<class evaluator> class GranularPotentialPair : public ForceCompute
+template<class evaluator, class contact_law = ContactLawLinear, class rolling_model = RollingSpring>
+class GranularPotentialPair : public ForceCompute
     {
     public:
     //! Param type from evaluator
@@ -157,6 +179,18 @@ template<class evaluator> class GranularPotentialPair : public ForceCompute
         // m_hi_vorticity = vec_to_scalar3(shear_rate); // This is wrong
         }
 
+    //! Insert particles into the system
+    pybind11::array_t<unsigned int> insertParticles(
+        pybind11::array_t<Scalar, pybind11::array::c_style | pybind11::array::forcecast> position,
+        pybind11::array_t<unsigned int, pybind11::array::c_style | pybind11::array::forcecast>
+            type_id,
+        pybind11::array_t<Scalar, pybind11::array::c_style | pybind11::array::forcecast> diameter,
+        pybind11::array_t<Scalar, pybind11::array::c_style | pybind11::array::forcecast> velocity);
+
+    //! Remove particles from the system
+    void removeParticles(
+        pybind11::array_t<unsigned int, pybind11::array::c_style | pybind11::array::forcecast> tags);
+
     void clearDynamicState()
         {
         m_dynamic_state_flag = false;
@@ -183,6 +217,221 @@ template<class evaluator> class GranularPotentialPair : public ForceCompute
     virtual CommFlags getRequestedCommFlags(uint64_t timestep);
 #endif
 
+    //! Skip the per particle energy and virial writes
+    /*! The totals are published as the external energy and virial, which
+       HOOMD does not treat consistently as local or global under domain
+       decomposition, so totals_only is limited to a single rank.
+    */
+    void setTotalsOnly(bool totals_only)
+        {
+        if (totals_only && m_sysdef->isDomainDecomposed())
+            {
+            throw std::runtime_error("totals_only is not supported with domain decomposition.");
+            }
+        m_totals_only = totals_only;
+        }
+
+    bool getTotalsOnly()
+        {
+        return m_totals_only;
+        }
+
+    //! Set whether particles that share a body are sub-spheres of one rigid clump
+    void setClumps(bool clumps)
+        {
+        m_clumps = clumps;
+        m_inner_valid = false;
+        }
+
+    bool getClumps()
+        {
+        return m_clumps;
+        }
+
+    //! Set the group of active particles, nullptr makes every particle active
+    void setActiveGroup(std::shared_ptr<ParticleGroup> group)
+        {
+        m_active.setGroup(group);
+        m_active_dirty = true;
+        }
+
+    std::shared_ptr<ParticleGroup> getActiveGroup()
+        {
+        return m_active.getGroup();
+        }
+
+    //! Set the thermal conductivity of the grains, 0 disables heat conduction
+    void setConductivity(Scalar conductivity)
+        {
+        if (conductivity < Scalar(0.0))
+            {
+            throw std::runtime_error("conductivity must be non-negative.");
+            }
+        if (conductivity > Scalar(0.0) && evaluator::needsCharge())
+            {
+            throw std::runtime_error("Heat conduction keeps the temperatures in the charges, which "
+                                     + evaluator::getName() + " uses.");
+            }
+        m_conductivity = conductivity;
+        }
+
+    Scalar getConductivity()
+        {
+        return m_conductivity;
+        }
+
+    //! Set the temperatures of all particles, indexed by tag
+    void setTemperatures(
+        pybind11::array_t<Scalar, pybind11::array::c_style | pybind11::array::forcecast>
+            temperature);
+
+    //! Get the temperatures of all particles, indexed by tag
+    pybind11::array_t<Scalar> getTemperatures();
+
+    //! Set the skin of the inner contact list
+    void setInnerSkin(Scalar inner_skin)
+        {
+        if (inner_skin < Scalar(0.0))
+            {
+            throw std::runtime_error("inner_skin must be non-negative.");
+            }
+        m_inner_skin = inner_skin;
+        m_inner_valid = false;
+        }
+
+    Scalar getInnerSkin()
+        {
+        return m_inner_skin;
+        }
+
+    //! Get the number of inner contact list builds
+    uint64_t getInnerListBuilds()
+        {
+        return m_inner_builds;
+        }
+
+    //! Set the tolerance of the normal force cache, relative to the overlap
+    void setForceCacheTolerance(Scalar tol)
+        {
+        if (tol < Scalar(0.0) || tol >= Scalar(1.0))
+            {
+            throw std::runtime_error("force_cache_tol must be in [0, 1).");
+            }
+        m_force_cache_tol = tol;
+        m_force_cache_valid = false;
+        }
+
+    Scalar getForceCacheTolerance()
+        {
+        return m_force_cache_tol;
+        }
+
+    //! Set whether the force loops read quantized neighbor positions
+    void setPackedPositions(bool packed_positions)
+        {
+        m_packed_positions = packed_positions;
+        }
+
+    bool getPackedPositions()
+        {
+        return m_packed_positions;
+        }
+
+    //! Set the number of host threads of the force loop
+    /*! The threaded engine writes each particle from its own row only, so it
+       needs a full neighbor list. The storage mode is not switched here,
+       since the list may be shared with forces that expect half storage:
+       the caller gives the pair a list of its own in full storage first.
+       The worker threads are started here and kept until the count changes.
+    */
+    void setNumThreads(unsigned int num_threads)
+        {
+        if (num_threads == 0)
+            {
+            throw std::runtime_error("num_threads must be at least 1.");
+            }
+        if (num_threads > 1 && m_nlist->getStorageMode() != NeighborList::full)
+            {
+            throw std::runtime_error(
+                "num_threads > 1 requires a dedicated neighbor list in full storage mode.");
+            }
+        if (num_threads != m_num_threads)
+            {
+            m_pool.reset();
+            if (num_threads > 1)
+                m_pool.reset(new detail::WorkerPool(num_threads));
+            }
+        m_num_threads = num_threads;
+        m_placement_dirty = true;
+        }
+
+    unsigned int getNumThreads()
+        {
+        return m_num_threads;
+        }
+
+    //! Set whether the large host arrays are backed by transparent huge pages
+    void setHugePages(bool huge_pages)
+        {
+        m_huge_pages = huge_pages;
+        m_placement_dirty = true;
+        }
+
+    bool getHugePages()
+        {
+        return m_huge_pages;
+        }
+
+    //! Set the number of slabs of the stress profile, 0 disables it
+    void setProfileBins(unsigned int n_bins)
+        {
+        m_stress_profile.configure(m_stress_profile.getAxis(), n_bins);
+        }
+
+    unsigned int getProfileBins()
+        {
+        return m_stress_profile.getNumBins();
+        }
+
+    //! Set the axis normal to the slabs of the stress profile
+    void setProfileAxis(const std::string& axis)
+        {
+        m_stress_profile.configure(StressProfile::axisFromName(axis),
+                                   m_stress_profile.getNumBins());
+        }
+
+    std::string getProfileAxis()
+        {
+        return StressProfile::axisName(m_stress_profile.getAxis());
+        }
+
+    //! Set the number of time steps between stress profile samples
+    void setProfilePeriod(uint64_t period)
+        {
+        m_stress_profile.setPeriod(period);
+        }
+
+    uint64_t getProfilePeriod()
+        {
+        return m_stress_profile.getPeriod();
+        }
+
+    //! Get the mean stress profile over all samples
+    pybind11::array_t<double> getStressProfile()
+        {
+        return m_stress_profile.get(m_exec_conf, m_sysdef->isDomainDecomposed());
+        }
+
+    uint64_t getStressProfileSamples()
+        {
+        return m_stress_profile.getNumSamples();
+        }
+
+    void resetStressProfile()
+        {
+        m_stress_profile.reset();
+        }
+
     std::vector<std::string> getTypeShapeMapping() const
         {
         std::vector<std::string> type_shape_mapping(m_pdata->getNTypes());
@@ -199,6 +448,10 @@ template<class evaluator> class GranularPotentialPair : public ForceCompute
     Scalar3 m_hi_shear_rate = make_scalar3(0.0, 0.0, 0.0); //!< Shear rate for hydrodynamic interactions
     Scalar3 m_hi_vorticity = make_scalar3(0.0, 0.0, 0.0); //!< Shear rate for hydrodynamic interactions
     Scalar m_gamma = Scalar(0.0);
+    Scalar m_gamma_n = Scalar(0.0); //!< Normal damping constant (used by damped contact laws)
+    Scalar m_mut = Scalar(0.0);     //!< Twisting friction coefficient
+    Scalar m_kt = Scalar(0.0);      //!< Twisting friction spring constant
+    Scalar m_specific_heat = Scalar(1.0); //!< Heat capacity per unit mass
 
     protected:
     std::shared_ptr<NeighborList> m_nlist; //!< The neighborlist to use for the computation
@@ -225,6 +478,7 @@ template<class evaluator> class GranularPotentialPair : public ForceCompute
     // TODO NEW remake friction members so that they transfer well to GPU
     GlobalArray<Scalar3> m_xi;
     GlobalArray<Scalar3> m_psi;
+    GlobalArray<Scalar> m_phi; //!< twisting angle integrated (RollingTwistingSpring only)
     // Dynamically track quantities relevant to contact friction
     // Angular momentum quaternion needs to be converted to real space
     // frame vector for these computations
@@ -245,10 +499,26 @@ template<class evaluator> class GranularPotentialPair : public ForceCompute
     GlobalArray<Scalar3> m_omega;
 
     // Keep local copies of the neighborlist
-    // Necessary for to update list when the neighborlist is updated
-    GlobalArray<unsigned int> m_local_nlist;
-    GlobalArray<unsigned int> m_local_n_neigh;
-    GlobalArray<size_t> m_local_head_list;
+    // Necessary for to update list when the neighborlist is updated. They
+    // are keyed by particle tag (not index) so that the history survives
+    // particle sorts, insertions and removals.
+    GlobalArray<unsigned int> m_local_nlist;   //!< Tag of the neighbor in each slot
+    GlobalArray<unsigned int> m_local_n_neigh; //!< Number of neighbors, indexed by tag
+    GlobalArray<size_t> m_local_head_list;     //!< Head of the neighbor list, indexed by tag
+
+    // Copies of the above (and of the history) from the previous rebuild,
+    // which are the source of the remap
+    GlobalArray<unsigned int> m_prev_nlist;
+    GlobalArray<unsigned int> m_prev_n_neigh;
+    GlobalArray<size_t> m_prev_head_list;
+    GlobalArray<Scalar3> m_prev_xi;
+    GlobalArray<Scalar3> m_prev_psi;
+    GlobalArray<Scalar> m_prev_phi;
+
+    /// Tags handed out by insertParticles since the last remap. HOOMD
+    /// recycles tags, so these must not inherit history from a removed
+    /// particle that held the same tag.
+    std::vector<unsigned int> m_inserted_tags;
 
     /// r_cut (not squared) given to the neighbor list
     std::shared_ptr<GlobalArray<Scalar>> m_r_cut_nlist;
@@ -266,16 +536,193 @@ template<class evaluator> class GranularPotentialPair : public ForceCompute
     std::shared_ptr<Communicator> m_comm;
 #endif
 
+    /// When true, energy and virial are only reduced to totals (published as
+    /// the external energy and virial) and the per particle arrays stay zero
+    bool m_totals_only = false;
+
+    // Rigid clumps: pairs of particles with the same body tag are skipped,
+    // sub-spheres move with the velocity and angular velocity of their
+    // central particle, and their forces and torques are moved onto the
+    // central particle after the force loops. The contact history stays per
+    // sub-sphere pair, keyed by tag like any other contact.
+    bool m_clumps = false;
+    GlobalArray<Scalar4> m_clump_vel; //!< Contact velocities of local and ghost particles
+
+    // Frozen particles: pairs in which neither particle is active are never
+    // evaluated and keep no contact history. The flags are refreshed with
+    // every neighbor list build.
+    ActiveMask m_active;
+    bool m_active_dirty = false; //!< True when the active group changed
+
+    // Contact heat conduction. The temperature of each particle is its
+    // charge, so it migrates with the particle and reaches ghosts through
+    // the communicator. The force loops accumulate the heat flow of every
+    // contact and the temperatures take an explicit Euler step after them.
+    Scalar m_conductivity = Scalar(0.0); //!< Thermal conductivity, 0 disables conduction
+    GlobalArray<Scalar> m_heat_flow;     //!< Heat flow into each local particle
+
+    // Inner contact list: the pairs of each neighbor list row within
+    // r_cut + m_inner_skin, stored as offsets into the row so that the
+    // history arrays stay indexed by neighbor list slot, packed with the
+    // neighbor index relative to i (kernel::compact_neighbor_t). Rebuilt with the
+    // neighbor list and whenever a particle has moved more than half the
+    // inner skin since the last build. Disabled when m_inner_skin is 0.
+    Scalar m_inner_skin = Scalar(0.0);
+    bool m_inner_valid = false;             //!< False when the inner list must be rebuilt
+    GlobalArray<kernel::compact_neighbor_t> m_inner_nlist; //!< Inner pairs of each row
+    GlobalArray<unsigned int> m_inner_n_neigh; //!< Number of inner pairs of each local particle
+    GlobalArray<Scalar3> m_inner_ref_pos;      //!< Local and ghost positions at the last build
+    unsigned int m_inner_n_ref = 0;            //!< Number of valid entries in m_inner_ref_pos
+    BoxDim m_inner_box;                        //!< Box at the last build
+    uint64_t m_inner_builds = 0;               //!< Number of inner list builds
+
+    // Quantized positions: fractional coordinates in the global box as 32 bit
+    // fixed point numbers plus the type, 16 bytes per particle instead of the
+    // 32 of a double precision Scalar4. Refreshed once per step together
+    // with the angular velocities, and read for every neighbor by the force
+    // loops when m_packed_positions is set.
+    bool m_packed_positions = false;
+    GlobalArray<uint4> m_packed_pos; //!< Quantized positions of local and ghost particles
+
+    // Normal force cache: (r, overlap, force_divr, energy) of the last
+    // evaluation of each contact, indexed by neighbor list slot, where the
+    // overlap is r_cut - r. A contact whose separation moved by at most
+    // m_force_cache_tol times the cached overlap reuses the cached normal
+    // force, so the tolerance stays meaningful for nearly touching pairs. An
+    // overlap of 0 marks an empty entry. Disabled when m_force_cache_tol is 0.
+    Scalar m_force_cache_tol = Scalar(0.0);
+    bool m_force_cache_valid = false;  //!< False when the cache must be cleared
+    GlobalArray<Scalar4> m_force_cache; //!< Cached (r, overlap, force_divr, energy) per slot
+
+    /// Number of host threads. With more than one, the forces are computed by
+    /// the single source body in GranularPairKernel.h on a full neighbor list.
+    unsigned int m_num_threads = 1;
+    std::unique_ptr<detail::WorkerPool> m_pool; //!< Workers when m_num_threads > 1
+
+    // Page placement of the large host arrays (see HostArrayPlacement.h).
+    // The arrays are placed again after they grow or the thread count
+    // changes, with the particle split of the threaded force loop.
+    bool m_huge_pages = false;     //!< Back the arrays by transparent huge pages
+    bool m_placement_dirty = true; //!< True when the arrays must be placed again
+
+    /// Irving-Kirkwood stress profile, sampled by the single threaded loop
+    StressProfile m_stress_profile;
+    bool m_profile_sample = false; //!< True while the current step is sampled
+
+    //! Start a stress profile sample if \a timestep is a sample step
+    void beginProfileSample(uint64_t timestep)
+        {
+        m_profile_sample = m_stress_profile.isSampleStep(timestep);
+        if (m_profile_sample)
+            {
+            m_stress_profile.beginSample(m_pdata->getGlobalBox(),
+                                         m_sysdef->getNDimensions() == 2);
+            }
+        }
+
     //! Actually compute the forces
     virtual void computeForces(uint64_t timestep);
 
+    //! Carry the contact history over to a freshly built neighbor list
+    void remapContactHistory(bool keep_history);
+
+    //! Find the slot holding \a tag_j in the previous list of \a tag_i
+    bool findPrevSlot(const unsigned int* h_prev_nlist,
+                      const unsigned int* h_prev_n_neigh,
+                      const size_t* h_prev_head_list,
+                      unsigned int tag_i,
+                      unsigned int tag_j,
+                      size_t& slot) const;
+
+    //! Compute the real space angular velocity of particles [first, last)
+    void computeOmega(unsigned int first, unsigned int last);
+
+    //! Quantize the positions of particles [first, last)
+    void packPositions(unsigned int first, unsigned int last);
+
+    //! Give sub-spheres the rigid body velocity of their clump
+    void computeClumpVelocities();
+
+    //! Move the forces and torques on sub-spheres onto their central particles
+    void reduceClumpForces();
+
+    //! Zero the heat flow of local particles
+    void resetHeatFlow();
+
+    //! Advance the temperatures of local particles by one time step
+    void updateTemperatures();
+
+    //! Bring the contact history, the force cache and the inner list up to date
+    void prepareForces(bool nlist_updated);
+
+    //! Prepare the inputs of the host force loops and zero the output arrays
+    void prepareHostArrays();
+
+    //! Check whether a particle moved too far since the inner list was built
+    bool innerListExpired();
+
+    //! Build the inner contact list from the neighbor list
+    void buildInnerList();
+
+    //! Compute the forces on the local particles on the host
+    void computeForcesHost();
+
+    //! Compute the forces on the local particles in a single loop
+    void computeForcesSerial();
+
+#ifdef PAIR_PLUGIN_MULTIVERSION
+    //! computeForcesSerial() compiled for AVX2
+    PAIR_PLUGIN_TARGET_AVX2 void computeForcesSerialAVX2()
+        {
+        computeForcesSerial();
+        }
+
+    //! computeForcesSerial() compiled for AVX-512
+    PAIR_PLUGIN_TARGET_AVX512 void computeForcesSerialAVX512()
+        {
+        computeForcesSerial();
+        }
+#endif
+
+    //! Compute the forces on the local particles with host threads
+    void computeForcesThreaded();
+
+    //! First touch the large host arrays from the threads that read them
+    void placeHostArrays();
+
+    //! Place a single array with the element split \a bounds
+    template<class T> void placeArray(GlobalArray<T>& array, const std::vector<size_t>& bounds)
+        {
+        ArrayHandle<T> h_array(array, access_location::host, access_mode::readwrite);
+        detail::placeHostArray(h_array.data,
+                               array.getNumElements(),
+                               bounds,
+                               m_huge_pages,
+                               m_pool.get());
+        }
+
+    //! Gather the contact coefficients for the kernel layer
+    kernel::granular_coeffs_t getContactCoeffs() const
+        {
+        kernel::granular_coeffs_t coeffs;
+        coeffs.mus = m_mus;
+        coeffs.mur = m_mur;
+        coeffs.ks = m_ks;
+        coeffs.kr = m_kr;
+        coeffs.gamma_n = m_gamma_n;
+        coeffs.mut = m_mut;
+        coeffs.kt = m_kt;
+        coeffs.deltaT = m_deltaT;
+        return coeffs;
+        }
+
     }; // end class GranularPotentialPair
 
 /*! \param sysdef System to compute forces on
     \param nlist Neighborlist to use for computing the forces
 */
-template<class evaluator>
-GranularPotentialPair<evaluator>::GranularPotentialPair(std::shared_ptr<SystemDefinition> sysdef,
+template<class evaluator, class contact_law, class rolling_model>
+GranularPotentialPair<evaluator, contact_law, rolling_model>::GranularPotentialPair(std::shared_ptr<SystemDefinition> sysdef,
                                               std::shared_ptr<NeighborList> nlist,
                                               Scalar mus,
                                               Scalar mur,
@@ -284,8 +731,9 @@ GranularPotentialPair<evaluator>::GranularPotentialPair(std::shared_ptr<SystemDe
     : ForceCompute(sysdef), m_nlist(nlist), m_shift_mode(no_shift),
       m_typpair_idx(m_pdata->getNTypes()), m_mus(mus), m_mur(mur), m_ks(ks), m_kr(kr)
     {
-    m_exec_conf->msg->notice(5) << "Constructing GranularPotentialPair<" << evaluator::getName() << ">"
-                                << std::endl;
+    m_exec_conf->msg->notice(5) << "Constructing GranularPotentialPair<" << evaluator::getName()
+                                << ", " << contact_law::getName() << ", "
+                                << rolling_model::getName() << ">" << std::endl;
 
     assert(m_pdata);
     assert(m_nlist);
@@ -308,7 +756,7 @@ GranularPotentialPair<evaluator>::GranularPotentialPair(std::shared_ptr<SystemDe
     // m_pair_idx.swap(pair_idx);
     // m_w_cache.swap(w_cache);
 
-    auto friction_array_size = m_nlist->getNListArray().m_num_elements;
+    auto friction_array_size = m_nlist->getNListArray().getNumElements();
     GlobalArray<Scalar3> xi(friction_array_size, m_exec_conf);
     m_xi.swap(xi);
     TAG_ALLOCATION(m_xi);
@@ -317,22 +765,66 @@ GranularPotentialPair<evaluator>::GranularPotentialPair(std::shared_ptr<SystemDe
     m_psi.swap(psi);
     TAG_ALLOCATION(m_psi);
 
+    GlobalArray<Scalar> phi(friction_array_size, m_exec_conf);
+    m_phi.swap(phi);
+    TAG_ALLOCATION(m_phi);
+
     GlobalArray<Scalar3> omega(m_pdata->getN() + m_pdata->getNGhosts(), m_exec_conf);
     m_omega.swap(omega);
     TAG_ALLOCATION(m_omega);
 
-    GlobalArray<unsigned int> local_nlist(m_nlist->getNListArray().m_num_elements, m_exec_conf);
+    GlobalArray<Scalar4> force_cache(friction_array_size, m_exec_conf);
+    m_force_cache.swap(force_cache);
+    TAG_ALLOCATION(m_force_cache);
+
+    GlobalArray<kernel::compact_neighbor_t> inner_nlist(friction_array_size, m_exec_conf);
+    m_inner_nlist.swap(inner_nlist);
+    TAG_ALLOCATION(m_inner_nlist);
+
+    GlobalArray<unsigned int> inner_n_neigh(m_pdata->getN(), m_exec_conf);
+    m_inner_n_neigh.swap(inner_n_neigh);
+    TAG_ALLOCATION(m_inner_n_neigh);
+
+    GlobalArray<Scalar3> inner_ref_pos(m_pdata->getN() + m_pdata->getNGhosts(), m_exec_conf);
+    m_inner_ref_pos.swap(inner_ref_pos);
+    TAG_ALLOCATION(m_inner_ref_pos);
+
+    GlobalArray<unsigned int> local_nlist(friction_array_size, m_exec_conf);
     m_local_nlist.swap(local_nlist);
     TAG_ALLOCATION(m_local_nlist);
 
-    GlobalArray<unsigned int> local_n_neigh(m_nlist->getNNeighArray().m_num_elements, m_exec_conf);
+    const unsigned int n_tags = m_pdata->getMaximumTag() + 1;
+    GlobalArray<unsigned int> local_n_neigh(n_tags, m_exec_conf);
     m_local_n_neigh.swap(local_n_neigh);
     TAG_ALLOCATION(m_local_n_neigh);
 
-    GlobalArray<size_t> local_head_list(m_nlist->getHeadListArray().m_num_elements, m_exec_conf);
+    GlobalArray<size_t> local_head_list(n_tags, m_exec_conf);
     m_local_head_list.swap(local_head_list);
     TAG_ALLOCATION(m_local_head_list);
-    
+
+    GlobalArray<unsigned int> prev_nlist(friction_array_size, m_exec_conf);
+    m_prev_nlist.swap(prev_nlist);
+    TAG_ALLOCATION(m_prev_nlist);
+
+    GlobalArray<unsigned int> prev_n_neigh(n_tags, m_exec_conf);
+    m_prev_n_neigh.swap(prev_n_neigh);
+    TAG_ALLOCATION(m_prev_n_neigh);
+
+    GlobalArray<size_t> prev_head_list(n_tags, m_exec_conf);
+    m_prev_head_list.swap(prev_head_list);
+    TAG_ALLOCATION(m_prev_head_list);
+
+    GlobalArray<Scalar3> prev_xi(friction_array_size, m_exec_conf);
+    m_prev_xi.swap(prev_xi);
+    TAG_ALLOCATION(m_prev_xi);
+
+    GlobalArray<Scalar3> prev_psi(friction_array_size, m_exec_conf);
+    m_prev_psi.swap(prev_psi);
+    TAG_ALLOCATION(m_prev_psi);
+
+    GlobalArray<Scalar> prev_phi(friction_array_size, m_exec_conf);
+    m_prev_phi.swap(prev_phi);
+    TAG_ALLOCATION(m_prev_phi);
 
     GlobalArray<Scalar> rcutsq(m_typpair_idx.getNumElements(), m_exec_conf);
     m_rcutsq.swap(rcutsq);
@@ -417,10 +909,12 @@ GranularPotentialPair<evaluator>::GranularPotentialPair(std::shared_ptr<SystemDe
 #endif
     }
 
-template<class evaluator> GranularPotentialPair<evaluator>::~GranularPotentialPair()
+template<class evaluator, class contact_law, class rolling_model>
+GranularPotentialPair<evaluator, contact_law, rolling_model>::~GranularPotentialPair()
     {
-    m_exec_conf->msg->notice(5) << "Destroying GranularPotentialPair<" << evaluator::getName() << ">"
-                                << std::endl;
+    m_exec_conf->msg->notice(5) << "Destroying GranularPotentialPair<" << evaluator::getName()
+                                << ", " << contact_law::getName() << ", "
+                                << rolling_model::getName() << ">" << std::endl;
 
     if (m_attached)
         {
@@ -434,25 +928,27 @@ template<class evaluator> GranularPotentialPair<evaluator>::~GranularPotentialPa
     \note When setting the value for (\a typ1, \a typ2), the parameter
    for (\a typ2, \a typ1) is automatically set.
 */
-template<class evaluator>
-void GranularPotentialPair<evaluator>::setParams(unsigned int typ1,
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::setParams(unsigned int typ1,
                                             unsigned int typ2,
                                             const param_type& param)
     {
     validateTypes(typ1, typ2, "setting params");
     m_params[m_typpair_idx(typ1, typ2)] = param;
     m_params[m_typpair_idx(typ2, typ1)] = param;
+    m_force_cache_valid = false;
     }
 
-template<class evaluator>
-void GranularPotentialPair<evaluator>::setParamsPython(pybind11::tuple typ, pybind11::dict params)
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::setParamsPython(pybind11::tuple typ, pybind11::dict params)
     {
     auto typ1 = m_pdata->getTypeByName(typ[0].cast<std::string>());
     auto typ2 = m_pdata->getTypeByName(typ[1].cast<std::string>());
     setParams(typ1, typ2, param_type(params, m_exec_conf->isCUDAEnabled()));
     }
 
-template<class evaluator> pybind11::dict GranularPotentialPair<evaluator>::getParams(pybind11::tuple typ)
+template<class evaluator, class contact_law, class rolling_model>
+pybind11::dict GranularPotentialPair<evaluator, contact_law, rolling_model>::getParams(pybind11::tuple typ)
     {
     auto typ1 = m_pdata->getTypeByName(typ[0].cast<std::string>());
     auto typ2 = m_pdata->getTypeByName(typ[1].cast<std::string>());
@@ -461,8 +957,8 @@ template<class evaluator> pybind11::dict GranularPotentialPair<evaluator>::getPa
     return m_params[m_typpair_idx(typ1, typ2)].asDict();
     }
 
-template<class evaluator>
-void GranularPotentialPair<evaluator>::validateTypes(unsigned int typ1,
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::validateTypes(unsigned int typ1,
                                                 unsigned int typ2,
                                                 std::string action)
     {
@@ -479,8 +975,8 @@ void GranularPotentialPair<evaluator>::validateTypes(unsigned int typ1,
     \note When setting the value for (\a typ1, \a typ2), the parameter
    for (\a typ2, \a typ1) is automatically set.
 */
-template<class evaluator>
-void GranularPotentialPair<evaluator>::setRcut(unsigned int typ1, unsigned int typ2, Scalar rcut)
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::setRcut(unsigned int typ1, unsigned int typ2, Scalar rcut)
     {
     validateTypes(typ1, typ2, "setting r_cut");
         {
@@ -500,17 +996,20 @@ void GranularPotentialPair<evaluator>::setRcut(unsigned int typ1, unsigned int t
 
     // notify the neighbor list that we have changed r_cut values
     m_nlist->notifyRCutMatrixChange();
+    m_inner_valid = false;
+    m_force_cache_valid = false;
     }
 
-template<class evaluator>
-void GranularPotentialPair<evaluator>::setRCutPython(pybind11::tuple types, Scalar r_cut)
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::setRCutPython(pybind11::tuple types, Scalar r_cut)
     {
     auto typ1 = m_pdata->getTypeByName(types[0].cast<std::string>());
     auto typ2 = m_pdata->getTypeByName(types[1].cast<std::string>());
     setRcut(typ1, typ2, r_cut);
     }
 
-template<class evaluator> Scalar GranularPotentialPair<evaluator>::getRCut(pybind11::tuple types)
+template<class evaluator, class contact_law, class rolling_model>
+Scalar GranularPotentialPair<evaluator, contact_law, rolling_model>::getRCut(pybind11::tuple types)
     {
     auto typ1 = m_pdata->getTypeByName(types[0].cast<std::string>());
     auto typ2 = m_pdata->getTypeByName(types[1].cast<std::string>());
@@ -519,19 +1018,19 @@ template<class evaluator> Scalar GranularPotentialPair<evaluator>::getRCut(pybin
     return sqrt(h_rcutsq.data[m_typpair_idx(typ1, typ2)]);
     }
 
-template<class evaluator>
-void GranularPotentialPair<evaluator>::connectGSDShapeSpec(std::shared_ptr<GSDDumpWriter> writer)
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::connectGSDShapeSpec(std::shared_ptr<GSDDumpWriter> writer)
     {
     typedef hoomd::detail::SharedSignalSlot<int(gsd_handle&)> SlotType;
-    auto func = std::bind(&GranularPotentialPair<evaluator>::slotWriteGSDShapeSpec,
+    auto func = std::bind(&GranularPotentialPair<evaluator, contact_law, rolling_model>::slotWriteGSDShapeSpec,
                           this,
                           std::placeholders::_1);
     std::shared_ptr<hoomd::detail::SignalSlot> pslot(new SlotType(writer->getWriteSignal(), func));
     addSlot(pslot);
     }
 
-template<class evaluator>
-int GranularPotentialPair<evaluator>::slotWriteGSDShapeSpec(gsd_handle& handle) const
+template<class evaluator, class contact_law, class rolling_model>
+int GranularPotentialPair<evaluator, contact_law, rolling_model>::slotWriteGSDShapeSpec(gsd_handle& handle) const
     {
     hoomd::detail::GSDShapeSpecWriter shapespec(m_exec_conf);
     m_exec_conf->msg->notice(10) << "GranularPotentialPair writing to GSD File to name: "
@@ -540,24 +1039,83 @@ int GranularPotentialPair<evaluator>::slotWriteGSDShapeSpec(gsd_handle& handle)
     return retval;
     }
 
-/*! \post The pair forces are computed for the given timestep. The
-   neighborlist's compute method is called to ensure that it is up to
-   date before proceeding.
+/*! \param h_prev_nlist Neighbor tags from the previous rebuild
+    \param h_prev_n_neigh Number of neighbors from the previous rebuild, by tag
+    \param h_prev_head_list Head list from the previous rebuild, by tag
+    \param tag_i Tag of the particle owning the list
+    \param tag_j Tag of the neighbor to look up
+    \param slot Output: slot of the pair in the previous history arrays
+    \returns True if the pair was in the previous list of \a tag_i
+*/
+template<class evaluator, class contact_law, class rolling_model>
+bool GranularPotentialPair<evaluator, contact_law, rolling_model>::findPrevSlot(
+    const unsigned int* h_prev_nlist,
+    const unsigned int* h_prev_n_neigh,
+    const size_t* h_prev_head_list,
+    unsigned int tag_i,
+    unsigned int tag_j,
+    size_t& slot) const
+    {
+    if (tag_i >= m_prev_n_neigh.getNumElements())
+        return false;
 
-    \param timestep specifies the current time step of the simulation
+    // lists are short, a linear scan beats any hashing here
+    const size_t head = h_prev_head_list[tag_i];
+    const unsigned int n = h_prev_n_neigh[tag_i];
+    for (unsigned int k = 0; k < n; k++)
+        {
+        if (h_prev_nlist[head + k] == tag_j)
+            {
+            slot = head + k;
+            return true;
+            }
+        }
+    return false;
+    }
+
+/*! The history arrays are indexed by neighbor list slot, so every rebuild
+   moves the history of each pair to its new slot. The previous list is
+   stored by tag, which makes the remap O(number of slots) without hashing
+   and independent of particle sorting, insertion and removal.
+
+    With a half neighbor list a pair may switch owner between rebuilds. In
+   that case it is found in the previous list of the neighbor and the
+   sliding history, which is antisymmetric under i <-> j, changes sign. The
+   rolling and twisting histories are symmetric.
+
+    \param keep_history If false, all history is reset to zero
 */
-template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(uint64_t timestep)
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::remapContactHistory(
+    bool keep_history)
     {
-    // start by updating the neighborlist
-    m_nlist->compute(timestep);
-    bool nlist_updated = m_nlist->hasBeenUpdated(timestep);
+    const size_t n_slots = m_nlist->getNListArray().getNumElements();
+    const unsigned int n_tags = m_pdata->getMaximumTag() + 1;
+
+    // the current state becomes the source of the remap
+    m_xi.swap(m_prev_xi);
+    m_psi.swap(m_prev_psi);
+    m_phi.swap(m_prev_phi);
+    m_local_nlist.swap(m_prev_nlist);
+    m_local_n_neigh.swap(m_prev_n_neigh);
+    m_local_head_list.swap(m_prev_head_list);
+
+    if (m_xi.getNumElements() < n_slots)
+        {
+        m_xi.resize(n_slots);
+        m_psi.resize(n_slots);
+        m_phi.resize(n_slots);
+        m_local_nlist.resize(n_slots);
+        m_placement_dirty = true;
+        }
+    if (m_local_n_neigh.getNumElements() < n_tags)
+        {
+        m_local_n_neigh.resize(n_tags);
+        m_local_head_list.resize(n_tags);
+        }
 
-    // depending on the neighborlist settings, we can take advantage of
-    // newton's third law to reduce computations at the cost of memory
-    // access complexity: set that flag now
-    bool third_law = m_nlist->getStorageMode() == NeighborList::half;
+    std::sort(m_inserted_tags.begin(), m_inserted_tags.end());
 
-    // access the neighbor list, particle data, and system box
     ArrayHandle<unsigned int> h_n_neigh(m_nlist->getNNeighArray(),
                                         access_location::host,
                                         access_mode::read);
@@ -567,13 +1125,117 @@ template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(u
     ArrayHandle<size_t> h_head_list(m_nlist->getHeadList(),
                                     access_location::host,
                                     access_mode::read);
+    ArrayHandle<unsigned int> h_tag(m_pdata->getTags(), access_location::host, access_mode::read);
+
+    ArrayHandle<unsigned int> h_prev_nlist(m_prev_nlist, access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_prev_n_neigh(m_prev_n_neigh,
+                                             access_location::host,
+                                             access_mode::read);
+    ArrayHandle<size_t> h_prev_head_list(m_prev_head_list,
+                                         access_location::host,
+                                         access_mode::read);
+    ArrayHandle<Scalar3> h_prev_xi(m_prev_xi, access_location::host, access_mode::read);
+    ArrayHandle<Scalar3> h_prev_psi(m_prev_psi, access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_prev_phi(m_prev_phi, access_location::host, access_mode::read);
+
+    ArrayHandle<unsigned int> h_local_nlist(m_local_nlist,
+                                            access_location::host,
+                                            access_mode::overwrite);
+    ArrayHandle<unsigned int> h_local_n_neigh(m_local_n_neigh,
+                                              access_location::host,
+                                              access_mode::overwrite);
+    ArrayHandle<size_t> h_local_head_list(m_local_head_list,
+                                          access_location::host,
+                                          access_mode::overwrite);
+    ArrayHandle<Scalar3> h_xi(m_xi, access_location::host, access_mode::overwrite);
+    ArrayHandle<Scalar3> h_psi(m_psi, access_location::host, access_mode::overwrite);
+    ArrayHandle<Scalar> h_phi(m_phi, access_location::host, access_mode::overwrite);
+    const unsigned char* active = m_active.data();
+
+    // tags that are not local after this rebuild own no list
+    memset((void*)h_local_n_neigh.data, 0, sizeof(unsigned int) * m_local_n_neigh.getNumElements());
+
+    for (unsigned int i = 0; i < m_pdata->getN(); i++)
+        {
+        const unsigned int tag_i = h_tag.data[i];
+        const size_t myHead = h_head_list.data[i];
+        const unsigned int size = (unsigned int)h_n_neigh.data[i];
+        h_local_head_list.data[tag_i] = myHead;
+        h_local_n_neigh.data[tag_i] = size;
+
+        const bool new_i = !m_inserted_tags.empty()
+                           && std::binary_search(m_inserted_tags.begin(),
+                                                 m_inserted_tags.end(),
+                                                 tag_i);
+
+        for (unsigned int k = 0; k < size; k++)
+            {
+            const size_t slot = myHead + k;
+            const unsigned int tag_j = h_tag.data[h_nlist.data[slot]];
+            h_local_nlist.data[slot] = tag_j;
+
+            Scalar3 xi = make_scalar3(0.0, 0.0, 0.0);
+            Scalar3 psi = make_scalar3(0.0, 0.0, 0.0);
+            Scalar phi = Scalar(0.0);
+
+            const bool new_j = !m_inserted_tags.empty()
+                               && std::binary_search(m_inserted_tags.begin(),
+                                                     m_inserted_tags.end(),
+                                                     tag_j);
+
+            size_t prev_slot = 0;
+            if (keep_history && !new_i && !new_j
+                && !kernel::frozen_pair(active, i, h_nlist.data[slot]))
+                {
+                if (findPrevSlot(h_prev_nlist.data,
+                                 h_prev_n_neigh.data,
+                                 h_prev_head_list.data,
+                                 tag_i,
+                                 tag_j,
+                                 prev_slot))
+                    {
+                    xi = h_prev_xi.data[prev_slot];
+                    psi = h_prev_psi.data[prev_slot];
+                    phi = h_prev_phi.data[prev_slot];
+                    }
+                else if (findPrevSlot(h_prev_nlist.data,
+                                      h_prev_n_neigh.data,
+                                      h_prev_head_list.data,
+                                      tag_j,
+                                      tag_i,
+                                      prev_slot))
+                    {
+                    xi = -h_prev_xi.data[prev_slot];
+                    psi = h_prev_psi.data[prev_slot];
+                    phi = h_prev_phi.data[prev_slot];
+                    }
+                }
+
+            h_xi.data[slot] = xi;
+            h_psi.data[slot] = psi;
+            h_phi.data[slot] = phi;
+            }
+        }
+
+    m_inserted_tags.clear();
+    }
+
+/*! Angular velocities are needed for both partners of every contact, so they
+   are converted from angular momenta once per step rather than per pair.
+
+    \param first First particle index to convert
+    \param last One past the last particle index to convert
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::computeOmega(unsigned int first,
+                                                                              unsigned int last)
+    {
+    if (m_omega.getNumElements() < last)
+        {
+        m_omega.resize(last);
+        m_placement_dirty = true;
+        }
 
-    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
-    ArrayHandle<Scalar4> h_vel(m_pdata->getVelocities(), access_location::host, access_mode::read);
-    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(),
-                                   access_location::host,
-                                   access_mode::read);
-    ArrayHandle<Scalar> h_charge(m_pdata->getCharges(), access_location::host, access_mode::read);
     ArrayHandle<Scalar4> h_orientation(m_pdata->getOrientationArray(),
                                        access_location::host,
                                        access_mode::read);
@@ -583,114 +1245,630 @@ template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(u
     ArrayHandle<Scalar3> h_inertia(m_pdata->getMomentsOfInertiaArray(),
                                    access_location::host,
                                    access_mode::read);
-    ArrayHandle<unsigned int> h_tag(m_pdata->getTags(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar3> h_omega(m_omega, access_location::host, access_mode::readwrite);
 
-    // force arrays
-    ArrayHandle<Scalar4> h_force(m_force, access_location::host, access_mode::overwrite);
-    ArrayHandle<Scalar4> h_torque(m_torque, access_location::host, access_mode::overwrite);
-    ArrayHandle<Scalar> h_virial(m_virial, access_location::host, access_mode::overwrite);
+    for (unsigned int i = first; i < last; i++)
+        {
+        h_omega.data[i] = kernel::angular_velocity(h_orientation.data[i],
+                                                   h_angmom.data[i],
+                                                   h_inertia.data[i]);
+        }
+    }
 
-    const BoxDim box = m_pdata->getGlobalBox();
-    ArrayHandle<Scalar> h_rcutsq(m_rcutsq, access_location::host, access_mode::read);
+/*! Fractional coordinates are wrapped into [0, 1) first, so ghosts beyond the
+   box edge get the same code as their periodic image.
 
-    PDataFlags flags = this->m_pdata->getFlags();
-    bool compute_virial = flags[pdata_flag::pressure_tensor];
+    \param first First particle index to quantize
+    \param last One past the last particle index to quantize
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::packPositions(unsigned int first,
+                                                                               unsigned int last)
+    {
+    if (m_packed_pos.getNumElements() < last)
+        {
+        m_packed_pos.resize(last);
+        m_placement_dirty = true;
+        }
 
-    // need to start from a zero force, energy and virial
-    memset((void*)h_force.data, 0, sizeof(Scalar4) * m_force.getNumElements());
-    memset((void*)h_force.data, 0, sizeof(Scalar4) * m_torque.getNumElements());
-    memset((void*)h_virial.data, 0, sizeof(Scalar) * m_virial.getNumElements());
+    const BoxDim box = m_pdata->getGlobalBox();
+    const Scalar scale = Scalar(4294967296.0);
+    auto quantize = [scale](Scalar f)
+    {
+        f -= floor(f);
+        // f * 2^32 may round up to 2^32, which wraps to 0 like f = 1 should
+        return (unsigned int)(uint64_t(f * scale));
+    };
 
-    // let's handle the startup and rebuild case
-    if (!m_dynamic_state_flag || nlist_updated)
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<uint4> h_packed_pos(m_packed_pos, access_location::host, access_mode::readwrite);
+
+    for (unsigned int i = first; i < last; i++)
         {
-        m_dynamic_state_flag = true;
+        const Scalar4 postype = h_pos.data[i];
+        const Scalar3 f = box.makeFraction(make_scalar3(postype.x, postype.y, postype.z));
+        h_packed_pos.data[i] = make_uint4(quantize(f.x),
+                                          quantize(f.y),
+                                          quantize(f.z),
+                                          __scalar_as_int(postype.w));
+        }
+    }
 
-        // std::vector<Scalar3, hoomd::detail::managed_allocator<Scalar3>> xi;
-        // std::vector<Scalar3, hoomd::detail::managed_allocator<Scalar3>> psi;
-        // std::unordered_map<std::pair<unsigned int, unsigned int>, unsigned int, pair_hash> pair_idx;
-
-        // // maybe we don't need to reserve?
-        // xi.reserve(m_xi.size());
-        // psi.reserve(m_psi.size());
-        // pair_idx.reserve(m_pair_idx.bucket_count());
-
-        // xi.swap(m_xi);
-        // psi.swap(m_psi);
-        // pair_idx.swap(m_pair_idx);
-
-        // clearDynamicState();
-
-        // unsigned int idx = 0;
-        // for (int i = 0; i < (int)m_pdata->getN(); i++)
-        //     {
-        //     auto tag_i = h_tag.data[i];
-        //     const size_t myHead = h_head_list.data[i];
-        //     const unsigned int size = (unsigned int)h_n_neigh.data[i];
-        //     for (unsigned int k = 0; k < size; k++)
-        //         {
-        //         // access the index of this neighbor (MEM TRANSFER: 1
-        //         // scalar)
-        //         unsigned int j = h_nlist.data[myHead + k];
-        //         auto tag_j = h_tag.data[j];
-        //         auto pair = std::make_pair(tag_i, tag_j);
-        //         if (pair_idx.empty() || pair_idx.find(pair) == pair_idx.end())
-        //             {
-        //             m_xi.push_back(make_scalar3(0, 0, 0));
-        //             m_psi.push_back(make_scalar3(0, 0, 0));
-        //             }
-        //         else
-        //             {
-        //             unsigned int mapped_idx = pair_idx[pair];
-
-        //             m_xi.push_back(xi[mapped_idx]);
-        //             m_psi.push_back(psi[mapped_idx]);
-        //             }
-        //         m_pair_idx[pair] = idx;
-        //         idx++;
-        //         }
-        //     }
-        }
-
-    auto xi_it = m_xi.begin();
-    auto psi_it = m_psi.begin();
-
-    m_w_cache.clear(); // clear angular velocity cache for the upcoming run
+/*! HOOMD places the sub-spheres of a rigid body but does not give them the
+   body's velocity or spin, which the contact damping and friction need. A
+   sub-sphere at r_i in the clump centred at r_c moves with v_c + w_c x (r_i -
+   r_c) and spins with w_c. Other particles, and sub-spheres whose central
+   particle is neither local nor a ghost, keep their own velocity.
 
-    // for each particle
-    for (int i = 0; i < (int)m_pdata->getN(); i++)
+    \pre m_omega holds the angular velocities of all local and ghost particles
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::computeClumpVelocities()
+    {
+    const unsigned int n = m_pdata->getN() + m_pdata->getNGhosts();
+    if (m_clump_vel.getNumElements() < n)
         {
-        // access the particle's position and type (MEM TRANSFER: 4
-        // scalars)
-        Scalar3 pi = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z);
-        unsigned int typei = __scalar_as_int(h_pos.data[i].w);
+        m_clump_vel.resize(n);
+        m_placement_dirty = true;
+        }
 
-        vec3<Scalar> v_i(h_vel.data[i].x, h_vel.data[i].y, h_vel.data[i].z);
-        vec3<Scalar> w_i(0.0, 0.0, 0.0);
-        auto tag_i = h_tag.data[i];
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar4> h_vel(m_pdata->getVelocities(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_body(m_pdata->getBodies(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_rtag(m_pdata->getRTags(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar3> h_omega(m_omega, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar4> h_clump_vel(m_clump_vel, access_location::host, access_mode::overwrite);
 
-        auto search = m_w_cache.find(tag_i);
-        if (search == m_w_cache.end())
-            {
-            quat<Scalar> q_i(h_orientation.data[i]);
-            quat<Scalar> p_i(h_angmom.data[i]);
-
-            Scalar3 I_i(h_inertia.data[i]);
-            vec3<Scalar> s_i((conj(q_i) * p_i).v / Scalar(2.0));
-            // I might be able to get rid of the ? operator
-            // this would assume that any componenet of s_i is always
-            // zero if I_i is zero
-            w_i = vec3<Scalar>(I_i.x == 0.0 ? 0.0 : s_i.x / I_i.x,
-                               I_i.y == 0.0 ? 0.0 : s_i.y / I_i.y,
-                               I_i.z == 0.0 ? 0.0 : s_i.z / I_i.z);
-            w_i = rotate(q_i, w_i); // now rotate into real frame
-            m_w_cache[tag_i] = make_scalar3(w_i.x, w_i.y, w_i.z);
+    const BoxDim box = m_pdata->getGlobalBox();
+    const unsigned int max_tag = m_pdata->getMaximumTag();
+
+    for (unsigned int i = 0; i < n; i++)
+        {
+        h_clump_vel.data[i] = h_vel.data[i];
+
+        const unsigned int body = h_body.data[i];
+        if (body >= MIN_FLOPPY || body > max_tag)
+            continue;
+        const unsigned int c = h_rtag.data[body];
+        if (c >= n || c == i)
+            continue;
+
+        Scalar3 dr = box.minImage(make_scalar3(h_pos.data[i].x - h_pos.data[c].x,
+                                               h_pos.data[i].y - h_pos.data[c].y,
+                                               h_pos.data[i].z - h_pos.data[c].z));
+        vec3<Scalar> w_c(h_omega.data[c]);
+        vec3<Scalar> v_i = vec3<Scalar>(h_vel.data[c].x, h_vel.data[c].y, h_vel.data[c].z)
+                           + cross(w_c, vec3<Scalar>(dr));
+        h_clump_vel.data[i] = make_scalar4(v_i.x, v_i.y, v_i.z, h_vel.data[i].w);
+        h_omega.data[i] = h_omega.data[c];
+        }
+    }
+
+/*! Each local sub-sphere hands its force, and its torque plus the torque of
+   its force about the centre, to a local central particle, so rigid body
+   integration finds the contact forces where it needs them. Energies and
+   virials stay on the sub-spheres. A sub-sphere whose central particle is a
+   ghost keeps its force; the reduction done by md.constrain.Rigid is
+   additive and moves it later.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::reduceClumpForces()
+    {
+    const unsigned int N = m_pdata->getN();
+
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_body(m_pdata->getBodies(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_rtag(m_pdata->getRTags(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar4> h_force(m_force, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar4> h_torque(m_torque, access_location::host, access_mode::readwrite);
+
+    const BoxDim box = m_pdata->getGlobalBox();
+    const unsigned int max_tag = m_pdata->getMaximumTag();
+
+    for (unsigned int i = 0; i < N; i++)
+        {
+        const unsigned int body = h_body.data[i];
+        if (body >= MIN_FLOPPY || body > max_tag)
+            continue;
+        const unsigned int c = h_rtag.data[body];
+        if (c >= N || c == i)
+            continue;
+
+        Scalar3 dr = box.minImage(make_scalar3(h_pos.data[i].x - h_pos.data[c].x,
+                                               h_pos.data[i].y - h_pos.data[c].y,
+                                               h_pos.data[i].z - h_pos.data[c].z));
+        vec3<Scalar> f_i(h_force.data[i].x, h_force.data[i].y, h_force.data[i].z);
+        vec3<Scalar> t_i = vec3<Scalar>(h_torque.data[i].x, h_torque.data[i].y, h_torque.data[i].z)
+                           + cross(vec3<Scalar>(dr), f_i);
+
+        h_force.data[c].x += f_i.x;
+        h_force.data[c].y += f_i.y;
+        h_force.data[c].z += f_i.z;
+        h_torque.data[c].x += t_i.x;
+        h_torque.data[c].y += t_i.y;
+        h_torque.data[c].z += t_i.z;
+
+        h_force.data[i].x = h_force.data[i].y = h_force.data[i].z = Scalar(0.0);
+        h_torque.data[i].x = h_torque.data[i].y = h_torque.data[i].z = Scalar(0.0);
+        }
+    }
+
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::resetHeatFlow()
+    {
+    const unsigned int N = m_pdata->getN();
+    if (m_heat_flow.getNumElements() < N)
+        {
+        m_heat_flow.resize(N);
+        }
+
+    ArrayHandle<Scalar> h_heat_flow(m_heat_flow, access_location::host, access_mode::overwrite);
+    memset((void*)h_heat_flow.data, 0, sizeof(Scalar) * m_heat_flow.getNumElements());
+    }
+
+/*! Explicit Euler step \f$ T_i \leftarrow T_i + \Delta t Q_i / (m_i c) \f$
+   with the heat flow \f$ Q_i \f$ of this step's contacts. Stable while
+   \f$ \Delta t \f$ is small compared to \f$ m c / (2 k a) \f$ of the
+   stiffest contact. Each rank advances its local particles only; the new
+   values reach the ghosts with the next ghost update. Massless particles
+   have no heat capacity and keep their temperature.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::updateTemperatures()
+    {
+    const unsigned int N = m_pdata->getN();
+
+    ArrayHandle<Scalar4> h_vel(m_pdata->getVelocities(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_heat_flow(m_heat_flow, access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_temperature(m_pdata->getCharges(),
+                                      access_location::host,
+                                      access_mode::readwrite);
+
+    for (unsigned int i = 0; i < N; i++)
+        {
+        const Scalar mass = h_vel.data[i].w;
+        if (mass > Scalar(0.0))
+            h_temperature.data[i] += m_deltaT * h_heat_flow.data[i] / (mass * m_specific_heat);
+        }
+    }
+
+/*! \param temperature Temperature of every tag up to the maximum tag
+
+    Every rank is given the whole array and sets its local particles.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::setTemperatures(
+    pybind11::array_t<Scalar, pybind11::array::c_style | pybind11::array::forcecast> temperature)
+    {
+    if (temperature.size() != m_pdata->getMaximumTag() + 1)
+        {
+        throw std::runtime_error("Error setting temperatures. Expected one per particle tag.");
+        }
+
+    const Scalar* h_values = temperature.data();
+    ArrayHandle<unsigned int> h_tag(m_pdata->getTags(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_temperature(m_pdata->getCharges(),
+                                      access_location::host,
+                                      access_mode::readwrite);
+    for (unsigned int i = 0; i < m_pdata->getN(); i++)
+        {
+        h_temperature.data[i] = h_values[h_tag.data[i]];
+        }
+    }
+
+/*! Tags without a particle read 0. The local values are summed over ranks,
+   which is only done here, when the temperatures are read.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+pybind11::array_t<Scalar>
+GranularPotentialPair<evaluator, contact_law, rolling_model>::getTemperatures()
+    {
+    std::vector<Scalar> result(m_pdata->getMaximumTag() + 1, Scalar(0.0));
+        {
+        ArrayHandle<unsigned int> h_tag(m_pdata->getTags(),
+                                        access_location::host,
+                                        access_mode::read);
+        ArrayHandle<Scalar> h_temperature(m_pdata->getCharges(),
+                                          access_location::host,
+                                          access_mode::read);
+        for (unsigned int i = 0; i < m_pdata->getN(); i++)
+            {
+            result[h_tag.data[i]] = h_temperature.data[i];
             }
-        else
+        }
+
+#ifdef ENABLE_MPI
+    if (m_sysdef->isDomainDecomposed())
+        {
+        MPI_Allreduce(MPI_IN_PLACE,
+                      result.data(),
+                      (int)result.size(),
+                      MPI_HOOMD_SCALAR,
+                      MPI_SUM,
+                      m_exec_conf->getMPICommunicator());
+        }
+#endif
+
+    return pybind11::array_t<Scalar>(result.size(), result.data());
+    }
+
+/*! Two particles that each moved less than half the inner skin cannot have
+   closed a gap of more than the skin, so no pair outside the inner list can
+   have come within r_cut. Ghosts are checked as well, their indices do not
+   change between neighbor list builds. A changed box or particle count also
+   expires the list.
+
+    \returns True if the inner list must be rebuilt
+*/
+template<class evaluator, class contact_law, class rolling_model>
+bool GranularPotentialPair<evaluator, contact_law, rolling_model>::innerListExpired()
+    {
+    const unsigned int n = m_pdata->getN() + m_pdata->getNGhosts();
+    const BoxDim box = m_pdata->getGlobalBox();
+    if (!m_inner_valid || n != m_inner_n_ref || box != m_inner_box)
+        return true;
+
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar3> h_ref_pos(m_inner_ref_pos, access_location::host, access_mode::read);
+
+    const Scalar max_disp = Scalar(0.5) * m_inner_skin;
+    const Scalar max_dispsq = max_disp * max_disp;
+    for (unsigned int i = 0; i < n; i++)
+        {
+        Scalar3 dx = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z)
+                     - h_ref_pos.data[i];
+        dx = box.minImage(dx);
+        if (dot(dx, dx) > max_dispsq)
+            return true;
+        }
+    return false;
+    }
+
+/*! Pairs are kept within r_cut + inner skin of their type pair. Dropped pairs
+   are at least the skin beyond r_cut, so they are not in contact; their
+   history is cleared here, since the force loop no longer visits them.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::buildInnerList()
+    {
+    const unsigned int N = m_pdata->getN();
+    const unsigned int n = N + m_pdata->getNGhosts();
+    const size_t n_slots = m_nlist->getNListArray().getNumElements();
+    if (m_inner_nlist.getNumElements() < n_slots)
+        {
+        m_inner_nlist.resize(n_slots);
+        m_placement_dirty = true;
+        }
+    if (m_inner_n_neigh.getNumElements() < N)
+        {
+        m_inner_n_neigh.resize(N);
+        m_placement_dirty = true;
+        }
+    if (m_inner_ref_pos.getNumElements() < n)
+        {
+        m_inner_ref_pos.resize(n);
+        m_placement_dirty = true;
+        }
+
+    const BoxDim box = m_pdata->getGlobalBox();
+
+    // (r_cut + skin)^2 per type pair
+    std::vector<Scalar> r_listsq(m_typpair_idx.getNumElements());
+        {
+        ArrayHandle<Scalar> h_rcutsq(m_rcutsq, access_location::host, access_mode::read);
+        for (unsigned int k = 0; k < r_listsq.size(); k++)
+            {
+            Scalar r_list = fast::sqrt(h_rcutsq.data[k]) + m_inner_skin;
+            r_listsq[k] = r_list * r_list;
+            }
+        }
+
+    ArrayHandle<unsigned int> h_n_neigh(m_nlist->getNNeighArray(),
+                                        access_location::host,
+                                        access_mode::read);
+    ArrayHandle<unsigned int> h_nlist(m_nlist->getNListArray(),
+                                      access_location::host,
+                                      access_mode::read);
+    ArrayHandle<size_t> h_head_list(m_nlist->getHeadList(),
+                                    access_location::host,
+                                    access_mode::read);
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_body(m_pdata->getBodies(), access_location::host, access_mode::read);
+    const unsigned int* body = m_clumps ? h_body.data : nullptr;
+    const unsigned char* active = m_active.data();
+
+    ArrayHandle<Scalar3> h_xi(m_xi, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar3> h_psi(m_psi, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar> h_phi(m_phi, access_location::host, access_mode::readwrite);
+
+    ArrayHandle<kernel::compact_neighbor_t> h_inner_nlist(m_inner_nlist,
+                                                          access_location::host,
+                                                          access_mode::overwrite);
+    ArrayHandle<unsigned int> h_inner_n_neigh(m_inner_n_neigh,
+                                              access_location::host,
+                                              access_mode::overwrite);
+    ArrayHandle<Scalar3> h_ref_pos(m_inner_ref_pos, access_location::host, access_mode::overwrite);
+
+    for (unsigned int i = 0; i < N; i++)
+        {
+        Scalar3 pi = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z);
+        unsigned int typei = __scalar_as_int(h_pos.data[i].w);
+
+        const size_t myHead = h_head_list.data[i];
+        const unsigned int size = (unsigned int)h_n_neigh.data[i];
+        if (size > 65536)
+            {
+            throw std::runtime_error("inner_skin supports at most 65536 neighbors per particle.");
+            }
+        unsigned int n_inner = 0;
+        for (unsigned int k = 0; k < size; k++)
+            {
+            const size_t slot = myHead + k;
+            unsigned int j = h_nlist.data[slot];
+            Scalar3 pj = make_scalar3(h_pos.data[j].x, h_pos.data[j].y, h_pos.data[j].z);
+            Scalar3 dx = box.minImage(pi - pj);
+            unsigned int typej = __scalar_as_int(h_pos.data[j].w);
+
+            // pairs within one clump or of two frozen particles never enter
+            // the inner list
+            if (!kernel::same_clump(body, i, j) && !kernel::frozen_pair(active, i, j)
+                && dot(dx, dx) < r_listsq[m_typpair_idx(typei, typej)])
+                {
+                h_inner_nlist.data[myHead + n_inner++] = kernel::make_compact_neighbor(i, j, k);
+                }
+            else
+                {
+                h_xi.data[slot] = make_scalar3(0.0, 0.0, 0.0);
+                h_psi.data[slot] = make_scalar3(0.0, 0.0, 0.0);
+                h_phi.data[slot] = Scalar(0.0);
+                }
+            }
+        h_inner_n_neigh.data[i] = n_inner;
+        }
+
+    for (unsigned int i = 0; i < n; i++)
+        {
+        h_ref_pos.data[i] = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z);
+        }
+
+    m_inner_n_ref = n;
+    m_inner_box = box;
+    m_inner_valid = true;
+    m_inner_builds++;
+    }
+
+/*! \param nlist_updated True if the neighbor list was rebuilt this step
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::prepareForces(
+    bool nlist_updated)
+    {
+    // let's handle the startup and rebuild case
+    if (!m_dynamic_state_flag || nlist_updated || m_active_dirty)
+        {
+        m_active.update(*m_pdata);
+        m_active_dirty = false;
+        remapContactHistory(m_dynamic_state_flag);
+        m_dynamic_state_flag = true;
+        m_inner_valid = false;
+        m_force_cache_valid = false;
+        }
+
+    // slots mean different pairs after a rebuild, so start over
+    if (m_force_cache_tol > Scalar(0.0) && !m_force_cache_valid)
+        {
+        const size_t n_slots = m_nlist->getNListArray().getNumElements();
+        if (m_force_cache.getNumElements() < n_slots)
             {
-            Scalar3 _w = search->second;
-            w_i = vec3<Scalar>(_w.x, _w.y, _w.z);
+            m_force_cache.resize(n_slots);
+            m_placement_dirty = true;
             }
+        ArrayHandle<Scalar4> h_force_cache(m_force_cache,
+                                           access_location::host,
+                                           access_mode::overwrite);
+        memset((void*)h_force_cache.data, 0, sizeof(Scalar4) * m_force_cache.getNumElements());
+        m_force_cache_valid = true;
+        }
+
+    if (m_inner_skin > Scalar(0.0) && innerListExpired())
+        {
+        buildInnerList();
+        }
+
+    m_external_energy = Scalar(0.0);
+    for (unsigned int k = 0; k < 6; k++)
+        m_external_virial[k] = Scalar(0.0);
+    }
+
+/*! The serial loop accumulates into both particles of a pair, so the output
+   arrays start from zero here. The GPU computes the same inputs on the
+   device and does not call this.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::prepareHostArrays()
+    {
+    computeOmega(0, m_pdata->getN() + m_pdata->getNGhosts());
+    if (m_packed_positions)
+        packPositions(0, m_pdata->getN() + m_pdata->getNGhosts());
+
+    if (m_conductivity > Scalar(0.0))
+        {
+        resetHeatFlow();
+        }
+
+    // need to start from a zero force, energy and virial
+    ArrayHandle<Scalar4> h_force(m_force, access_location::host, access_mode::overwrite);
+    ArrayHandle<Scalar4> h_torque(m_torque, access_location::host, access_mode::overwrite);
+    ArrayHandle<Scalar> h_virial(m_virial, access_location::host, access_mode::overwrite);
+    memset((void*)h_force.data, 0, sizeof(Scalar4) * m_force.getNumElements());
+    memset((void*)h_torque.data, 0, sizeof(Scalar4) * m_torque.getNumElements());
+    memset((void*)h_virial.data, 0, sizeof(Scalar) * m_virial.getNumElements());
+    }
+
+/*! \post The pair forces are computed for the given timestep. The
+   neighborlist's compute method is called to ensure that it is up to
+   date before proceeding.
+
+    \param timestep specifies the current time step of the simulation
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::computeForces(uint64_t timestep)
+    {
+    // another force sharing the list may have switched it back to half
+    if (m_num_threads > 1 && m_nlist->getStorageMode() != NeighborList::full)
+        {
+        throw std::runtime_error(
+            "The neighbor list of a pair with num_threads > 1 must stay in full storage mode.");
+        }
+
+    // start by updating the neighborlist
+    m_nlist->compute(timestep);
+    bool nlist_updated = m_nlist->hasBeenUpdated(timestep);
+
+    beginProfileSample(timestep);
+    prepareForces(nlist_updated);
+    prepareHostArrays();
+    if (m_clumps)
+        computeClumpVelocities();
+    computeForcesHost();
+
+    if (m_clumps)
+        reduceClumpForces();
+    if (m_conductivity > Scalar(0.0))
+        updateTemperatures();
+
+    if (m_profile_sample)
+        {
+        m_stress_profile.endSample();
+        m_profile_sample = false;
+        }
+    }
+
+/*! Forces are accumulated into the output arrays, which must have been
+   zeroed by prepareHostArrays. Both loops run in the version selected by
+   detail::selectCpuIsa().
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::computeForcesHost()
+    {
+    if (m_placement_dirty && (m_num_threads > 1 || m_huge_pages)
+        && !m_exec_conf->isCUDAEnabled())
+        {
+        placeHostArrays();
+        }
+
+    // the normal force cache, the stress profile and the totals live in this
+    // loop only
+    if (m_num_threads > 1 && m_force_cache_tol == Scalar(0.0) && !m_profile_sample
+        && !m_totals_only && m_nlist->getStorageMode() == NeighborList::full)
+        {
+        computeForcesThreaded();
+        return;
+        }
+
+#ifdef PAIR_PLUGIN_MULTIVERSION
+    switch (detail::cpuIsa())
+        {
+    case detail::CpuIsa::avx512:
+        computeForcesSerialAVX512();
+        return;
+    case detail::CpuIsa::avx2:
+        computeForcesSerialAVX2();
+        return;
+    default:
+        break;
+        }
+#endif
+    computeForcesSerial();
+    }
+
+/*! The loop behind computeForcesHost() that handles every option: half
+   and full neighbor lists, the normal force cache, the stress profile and
+   totals only.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::computeForcesSerial()
+    {
+    // depending on the neighborlist settings, we can take advantage of
+    // newton's third law to reduce computations at the cost of memory
+    // access complexity: set that flag now
+    bool third_law = m_nlist->getStorageMode() == NeighborList::half;
+
+    // access the neighbor list, particle data, and system box
+    ArrayHandle<unsigned int> h_n_neigh(m_nlist->getNNeighArray(),
+                                        access_location::host,
+                                        access_mode::read);
+    ArrayHandle<unsigned int> h_nlist(m_nlist->getNListArray(),
+                                      access_location::host,
+                                      access_mode::read);
+    ArrayHandle<size_t> h_head_list(m_nlist->getHeadList(),
+                                    access_location::host,
+                                    access_mode::read);
+
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar4> h_vel(m_clumps ? m_clump_vel : m_pdata->getVelocities(),
+                               access_location::host,
+                               access_mode::read);
+    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(),
+                                   access_location::host,
+                                   access_mode::read);
+    ArrayHandle<Scalar> h_charge(m_pdata->getCharges(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar3> h_omega(m_omega, access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_body(m_pdata->getBodies(), access_location::host, access_mode::read);
+    const unsigned int* body = m_clumps ? h_body.data : nullptr;
+    const unsigned char* active = m_active.data();
+    ArrayHandle<uint4> h_packed_pos(m_packed_pos, access_location::host, access_mode::read);
+    const uint4* packed_pos = m_packed_positions ? h_packed_pos.data : nullptr;
+
+    // contact heat conduction
+    const bool conduction = m_conductivity > Scalar(0.0);
+    ArrayHandle<Scalar> h_heat_flow(m_heat_flow, access_location::host, access_mode::readwrite);
+
+    // contact history
+    ArrayHandle<Scalar3> h_xi(m_xi, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar3> h_psi(m_psi, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar> h_phi(m_phi, access_location::host, access_mode::readwrite);
+
+    // walk the inner contact list when there is one
+    const bool use_inner = m_inner_skin > Scalar(0.0);
+
+    // reuse cached normal forces for |r - r_cached| <= tol * overlap_cached
+    const bool use_cache = m_force_cache_tol > Scalar(0.0);
+    ArrayHandle<Scalar4> h_force_cache(m_force_cache, access_location::host, access_mode::readwrite);
+    ArrayHandle<kernel::compact_neighbor_t> h_inner_nlist(m_inner_nlist,
+                                                          access_location::host,
+                                                          access_mode::read);
+    ArrayHandle<unsigned int> h_inner_n_neigh(m_inner_n_neigh,
+                                              access_location::host,
+                                              access_mode::read);
+
+    // force arrays
+    ArrayHandle<Scalar4> h_force(m_force, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar4> h_torque(m_torque, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar> h_virial(m_virial, access_location::host, access_mode::readwrite);
+
+    const BoxDim box = m_pdata->getGlobalBox();
+    ArrayHandle<Scalar> h_rcutsq(m_rcutsq, access_location::host, access_mode::read);
+
+    PDataFlags flags = this->m_pdata->getFlags();
+    bool compute_virial = flags[pdata_flag::pressure_tensor];
+
+    const kernel::granular_coeffs_t coeffs = getContactCoeffs();
+
+    // only used when m_totals_only is set
+    Scalar energy_total = Scalar(0.0);
+    Scalar virial_total[6] = {Scalar(0.0)};
+
+    // for each particle
+    for (unsigned int i = 0; i < m_pdata->getN(); i++)
+        {
+        // access the particle's position and type (MEM TRANSFER: 4
+        // scalars)
+        Scalar3 pi = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z);
+        unsigned int typei = __scalar_as_int(h_pos.data[i].w);
+
+        vec3<Scalar> v_i(h_vel.data[i].x, h_vel.data[i].y, h_vel.data[i].z);
+        vec3<Scalar> w_i(h_omega.data[i]);
 
         // sanity check
         assert(typei < m_pdata->getNTypes());
@@ -714,24 +1892,48 @@ template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(u
         Scalar virialyyi = 0.0;
         Scalar virialyzi = 0.0;
         Scalar virialzzi = 0.0;
+        Scalar heat_i = 0.0;
 
         // loop over all of the neighbors of this particle
         const size_t myHead = h_head_list.data[i];
-        const unsigned int size = (unsigned int)h_n_neigh.data[i];
+        const unsigned int size
+            = use_inner ? h_inner_n_neigh.data[i] : (unsigned int)h_n_neigh.data[i];
         for (unsigned int k = 0; k < size; k++)
             {
             // access the index of this neighbor (MEM TRANSFER: 1
-            // scalar)
-            unsigned int j = h_nlist.data[myHead + k];
+            // scalar, the neighbor list is only read for escaped inner entries)
+            size_t slot = myHead + k;
+            unsigned int j;
+            if (use_inner)
+                {
+                const kernel::compact_neighbor_t entry = h_inner_nlist.data[myHead + k];
+                slot = myHead + entry.offset;
+                j = kernel::decode_compact_neighbor(entry, i, h_nlist.data, slot);
+                }
+            else
+                {
+                j = h_nlist.data[slot];
+                }
             assert(j < m_pdata->getN() + m_pdata->getNGhosts());
-
-            // calculate dr_ji (MEM TRANSFER: 3 scalars / FLOPS: 3)
-            Scalar3 pj = make_scalar3(h_pos.data[j].x, h_pos.data[j].y, h_pos.data[j].z);
-            Scalar3 dx = pi - pj;
-
-            // access the type of the neighbor particle (MEM TRANSFER: 1
-            // scalar)
-            unsigned int typej = __scalar_as_int(h_pos.data[j].w);
+            if (kernel::same_clump(body, i, j) || kernel::frozen_pair(active, i, j))
+                continue;
+
+            // calculate dr_ji and access the type of the neighbor particle,
+            // applying periodic boundary conditions (MEM TRANSFER: 4 scalars,
+            // or 4 words when quantized)
+            Scalar3 dx;
+            unsigned int typej;
+            if (packed_pos)
+                {
+                dx = kernel::packed_separation(box, packed_pos[i], packed_pos[j]);
+                typej = packed_pos[j].w;
+                }
+            else
+                {
+                Scalar3 pj = make_scalar3(h_pos.data[j].x, h_pos.data[j].y, h_pos.data[j].z);
+                dx = box.minImage(pi - pj);
+                typej = __scalar_as_int(h_pos.data[j].w);
+                }
             assert(typej < m_pdata->getNTypes());
 
             // access diameter and charge (if needed)
@@ -742,15 +1944,11 @@ template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(u
             if (evaluator::needsCharge())
                 qj = h_charge.data[j];
 
-            // apply periodic boundary conditions
-            dx = box.minImage(dx);
-
             // calculate r_ij squared (FLOPS: 5)
             Scalar rsq = dot(dx, dx);
 
             // get parameters for this type pair
             unsigned int typpair_idx = m_typpair_idx(typei, typej);
-            param_type param = m_params[typpair_idx];
             Scalar rcutsq = h_rcutsq.data[typpair_idx];
 
             // compute the force and potential energy
@@ -758,106 +1956,99 @@ template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(u
             Scalar pair_eng = Scalar(0.0);
             Scalar r = Scalar(0.0);
             Scalar rinv = Scalar(0.0);
-            evaluator eval(rsq, rcutsq, param);
-            if (evaluator::needsDiameter())
-                eval.setDiameter(di, dj);
-            if (evaluator::needsCharge())
-                eval.setCharge(qi, qj);
+            bool evaluated = false;
+
+            Scalar4 cached = make_scalar4(0.0, 0.0, 0.0, 0.0);
+            if (use_cache && rsq < rcutsq)
+                {
+                cached = h_force_cache.data[slot];
+                if (cached.y > Scalar(0.0))
+                    r = fast::sqrt(rsq);
+                }
 
-            //! This is the normal force of the conservative pair
-            //! interaction. We'll also need to calculate the
-            //! non-conservative friction forces if the conservative
-            //! interaction is non-zero (in contact).
-            bool evaluated = eval.evalForceAndEnergyGranular(force_divr, pair_eng, r, rinv);
+            if (cached.y > Scalar(0.0) && fabs(r - cached.x) <= m_force_cache_tol * cached.y)
+                {
+                // the contact barely moved compared to its overlap, reuse the
+                // normal force
+                force_divr = cached.z;
+                pair_eng = cached.w;
+                rinv = Scalar(1.0) / r;
+                evaluated = true;
+                }
+            else
+                {
+                param_type param = m_params[typpair_idx];
+                evaluator eval(rsq, rcutsq, param);
+                if (evaluator::needsDiameter())
+                    eval.setDiameter(di, dj);
+                if (evaluator::needsCharge())
+                    eval.setCharge(qi, qj);
+
+                //! This is the normal force of the conservative pair
+                //! interaction. We'll also need to calculate the
+                //! non-conservative friction forces if the conservative
+                //! interaction is non-zero (in contact).
+                evaluated = eval.evalForceAndEnergyGranular(force_divr, pair_eng, r, rinv);
+
+                if (use_cache)
+                    h_force_cache.data[slot]
+                        = evaluated ? make_scalar4(r,
+                                                   fast::sqrt(rcutsq) - r,
+                                                   force_divr,
+                                                   pair_eng)
+                                    : make_scalar4(0.0, 0.0, 0.0, 0.0);
+                }
 
             if (evaluated)
                 {
-                // grab data from particle j and calculate it if it
-                // isn't cached
                 vec3<Scalar> v_j(h_vel.data[j].x, h_vel.data[j].y, h_vel.data[j].z);
-                vec3<Scalar> w_j(0.0, 0.0, 0.0);
-                auto tag_j = h_tag.data[j];
-
-                //!> NOTE - eventually we probably want to avoid some of
-                //! these computations if mus or mur are zero
-
-                auto search = m_w_cache.find(tag_j);
-                if (search == m_w_cache.end())
-                    {
-                    quat<Scalar> q_j(h_orientation.data[j]);
-                    quat<Scalar> p_j(h_angmom.data[j]);
-                    Scalar3 I_j(h_inertia.data[j]);
-                    vec3<Scalar> s_j((conj(q_j) * p_j).v / Scalar(2.0));
-                    // I might be able to get rid of the ? operator
-                    // this would assume that any componenet of s_i is
-                    // always zero if I_i is zero
-                    w_j = vec3<Scalar>(I_j.x == 0.0 ? 0.0 : s_j.x / I_j.x,
-                                       I_j.y == 0.0 ? 0.0 : s_j.y / I_j.y,
-                                       I_j.z == 0.0 ? 0.0 : s_j.z / I_j.z);
-                    w_j = rotate(q_j, w_i); // now rotate into real frame
-                    m_w_cache[tag_j] = make_scalar3(w_j.x, w_j.y, w_j.z);
-                    }
-                else
-                    {
-                    Scalar3 _w = search->second;
-                    w_j = vec3<Scalar>(_w.x, _w.y, _w.z);
-                    }
-
-                // add up conservate and non-conservative forces and
-                // compute torque
-                vec3<Scalar> force = force_divr * vec3<Scalar>(dx.x, dx.y, dx.z);
-                vec3<Scalar> force_slide(0.0, 0.0, 0.0);
-                vec3<Scalar> force_roll(0.0, 0.0, 0.0);
-                vec3<Scalar> torque_i(0.0, 0.0, 0.0);
-                vec3<Scalar> torque_j(0.0, 0.0, 0.0);
-
-                vec3<Scalar> xi_ij(*xi_it);
-                vec3<Scalar> psi_ij(*psi_it);
-
-                // non-conservative force and torque
-                Scalar force_sqr = force_divr * force_divr * rsq;
-                vec3<Scalar> v_unit_dx(dx.x * rinv, dx.y * rinv, dx.z * rinv);
-
-                Scalar a_ij = Scalar(2.0) * di * dj / (di + dj);
-
-                force_slide = m_ks * xi_ij;
-                force_roll = m_kr * psi_ij;
-                Scalar slide_sqr = dot(force_slide, force_slide);
-                Scalar roll_sqr = dot(force_roll, force_roll);
-                if (slide_sqr > m_mus * m_mus * force_sqr)
-                    force_slide *= m_mus * fast::rsqrt(slide_sqr) * force_divr * r;
-                if (roll_sqr > m_mur * m_mur * force_sqr)
-                    force_roll *= m_mur * fast::rsqrt(roll_sqr) * force_divr * r;
-
-                force += force_slide;
-
-                auto torque_slide = cross(v_unit_dx, force_slide);
-                auto torque_roll = cross(v_unit_dx, force_roll);
-                torque_i = di * torque_slide + a_ij * torque_roll;
+                vec3<Scalar> w_j(h_omega.data[j]);
+
+                vec3<Scalar> force;
+                vec3<Scalar> torque_i;
+                vec3<Scalar> torque_j;
+                kernel::granular_contact<contact_law, rolling_model>(coeffs,
+                                                                     dx,
+                                                                     r,
+                                                                     rinv,
+                                                                     rcutsq,
+                                                                     force_divr,
+                                                                     di,
+                                                                     dj,
+                                                                     v_i,
+                                                                     v_j,
+                                                                     w_i,
+                                                                     w_j,
+                                                                     h_xi.data[slot],
+                                                                     h_psi.data[slot],
+                                                                     h_phi.data[slot],
+                                                                     force,
+                                                                     torque_i,
+                                                                     torque_j);
 
                 ti.x += torque_i.x;
                 ti.y += torque_i.y;
                 ti.z += torque_i.z;
 
-                
-                vec3<Scalar> ur_pre = (v_j - v_i) - cross(di * w_i + dj * w_j, v_unit_dx);
-                auto tmp = ur_pre - v_unit_dx * dot(ur_pre, v_unit_dx) * m_deltaT;
-                *xi_it += make_scalar3(tmp.x, tmp.y, tmp.z);
-                tmp = a_ij * cross(w_i - w_j, v_unit_dx) * m_deltaT;
-                *psi_it += make_scalar3(tmp.x, tmp.y, tmp.z);
-
-                // TODO need to verify that this is the correct, but
-                // since we assume the bodies are spherical, their
-                // torques should just as simple as negating the force
-                // and multiplying by the other radius
-                if (third_law)
-                    torque_j = -dj * torque_slide - a_ij * torque_roll;
-
                 Scalar3 force2 = make_scalar3(force.x, force.y, force.z) * Scalar(0.5);
                 // add the force, potential energy and virial to the
                 // particle i (FLOPS: 8)
                 fi += make_scalar3(force.x, force.y, force.z);
                 pei += pair_eng * Scalar(0.5);
+
+                // heat flows through the same contact, from the same r
+                Scalar heat_ij = Scalar(0.0);
+                if (conduction)
+                    {
+                    heat_ij = kernel::contact_heat_flow(m_conductivity,
+                                                        di,
+                                                        dj,
+                                                        r,
+                                                        rcutsq,
+                                                        h_charge.data[i],
+                                                        h_charge.data[j]);
+                    heat_i += heat_ij;
+                    }
                 if (compute_virial)
                     {
                     virialxxi += dx.x * force2.x;
@@ -868,6 +2059,17 @@ template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(u
                     virialzzi += dx.z * force2.z;
                     }
 
+                // spread the pair virial over the slabs it crosses, a pair
+                // seen from both sides counts half each time
+                if (m_profile_sample)
+                    {
+                    m_stress_profile.addPair(pi,
+                                             dx,
+                                             make_scalar3(force.x, force.y, force.z),
+                                             third_law && j < m_pdata->getN() ? Scalar(1.0)
+                                                                              : Scalar(0.5));
+                    }
+
                 // add the force to particle j if we are using the third
                 // law (MEM TRANSFER: 10 scalars / FLOPS: 8) only add
                 // force to local particles
@@ -877,31 +2079,49 @@ template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(u
                     h_force.data[mem_idx].x -= force.x;
                     h_force.data[mem_idx].y -= force.y;
                     h_force.data[mem_idx].z -= force.z;
-                    // might be a bug, buth this should probably be +,
-                    // not - signs
+                    // the torque the row of j would compute, see granular_contact()
                     h_torque.data[j].x += torque_j.x;
                     h_torque.data[j].y += torque_j.y;
                     h_torque.data[j].z += torque_j.z;
-                    h_force.data[mem_idx].w += pair_eng * Scalar(0.5);
-                    if (compute_virial)
+                    if (conduction)
+                        h_heat_flow.data[j] -= heat_ij;
+                    if (!m_totals_only)
+                        {
+                        h_force.data[mem_idx].w += pair_eng * Scalar(0.5);
+                        if (compute_virial)
+                            {
+                            h_virial.data[0 * m_virial_pitch + j] += dx.x * force2.x;
+                            h_virial.data[1 * m_virial_pitch + j] += dx.y * force2.x;
+                            h_virial.data[2 * m_virial_pitch + j] += dx.z * force2.x;
+                            h_virial.data[3 * m_virial_pitch + j] += dx.y * force2.y;
+                            h_virial.data[4 * m_virial_pitch + j] += dx.z * force2.y;
+                            h_virial.data[5 * m_virial_pitch + j] += dx.z * force2.z;
+                            }
+                        }
+                    else
                         {
-                        h_virial.data[0 * m_virial_pitch + j] += dx.x * force2.x;
-                        h_virial.data[1 * m_virial_pitch + j] += dx.y * force2.x;
-                        h_virial.data[2 * m_virial_pitch + j] += dx.z * force2.x;
-                        h_virial.data[3 * m_virial_pitch + j] += dx.y * force2.y;
-                        h_virial.data[4 * m_virial_pitch + j] += dx.z * force2.y;
-                        h_virial.data[5 * m_virial_pitch + j] += dx.z * force2.z;
+                        energy_total += pair_eng * Scalar(0.5);
+                        if (compute_virial)
+                            {
+                            virial_total[0] += dx.x * force2.x;
+                            virial_total[1] += dx.y * force2.x;
+                            virial_total[2] += dx.z * force2.x;
+                            virial_total[3] += dx.y * force2.y;
+                            virial_total[4] += dx.z * force2.y;
+                            virial_total[5] += dx.z * force2.z;
+                            }
                         }
                     }
                 }
             else
                 {
-                *xi_it = make_scalar3(0.0, 0.0, 0.0);
-                *psi_it = make_scalar3(0.0, 0.0, 0.0);
+                // contact is broken, forget its history
+                h_xi.data[slot] = make_scalar3(0.0, 0.0, 0.0);
+                if (rolling_model::hasRolling())
+                    h_psi.data[slot] = make_scalar3(0.0, 0.0, 0.0);
+                if (rolling_model::hasTwisting())
+                    h_phi.data[slot] = Scalar(0.0);
                 }
-
-            ++xi_it;
-            ++psi_it;
             }
 
         if (m_gamma != 0.0)
@@ -923,32 +2143,354 @@ template<class evaluator> void GranularPotentialPair<evaluator>::computeForces(u
         h_torque.data[mem_idx].x += ti.x;
         h_torque.data[mem_idx].y += ti.y;
         h_torque.data[mem_idx].z += ti.z;
-        h_force.data[mem_idx].w += pei;
-        if (compute_virial)
+        if (conduction)
+            h_heat_flow.data[mem_idx] += heat_i;
+        if (!m_totals_only)
+            {
+            h_force.data[mem_idx].w += pei;
+            if (compute_virial)
+                {
+                h_virial.data[0 * m_virial_pitch + mem_idx] += virialxxi;
+                h_virial.data[1 * m_virial_pitch + mem_idx] += virialxyi;
+                h_virial.data[2 * m_virial_pitch + mem_idx] += virialxzi;
+                h_virial.data[3 * m_virial_pitch + mem_idx] += virialyyi;
+                h_virial.data[4 * m_virial_pitch + mem_idx] += virialyzi;
+                h_virial.data[5 * m_virial_pitch + mem_idx] += virialzzi;
+                }
+            }
+        else
             {
-            h_virial.data[0 * m_virial_pitch + mem_idx] += virialxxi;
-            h_virial.data[1 * m_virial_pitch + mem_idx] += virialxyi;
-            h_virial.data[2 * m_virial_pitch + mem_idx] += virialxzi;
-            h_virial.data[3 * m_virial_pitch + mem_idx] += virialyyi;
-            h_virial.data[4 * m_virial_pitch + mem_idx] += virialyzi;
-            h_virial.data[5 * m_virial_pitch + mem_idx] += virialzzi;
+            energy_total += pei;
+            if (compute_virial)
+                {
+                virial_total[0] += virialxxi;
+                virial_total[1] += virialxyi;
+                virial_total[2] += virialxzi;
+                virial_total[3] += virialyyi;
+                virial_total[4] += virialyzi;
+                virial_total[5] += virialzzi;
+                }
             }
         }
+
+    // publish the totals, HOOMD adds them to the per particle sums
+    if (m_totals_only)
+        {
+        m_external_energy += energy_total;
+        for (unsigned int k = 0; k < 6; k++)
+            m_external_virial[k] += virial_total[k];
+        }
+    }
+
+namespace detail
+    {
+//! Run the granular per particle body on particles [first, last)
+template<class evaluator, class contact_law, class rolling_model, class param_type>
+inline void granularRangeForces(const kernel::granular_args_t<param_type>& args,
+                                unsigned int first,
+                                unsigned int last)
+    {
+    kernel::SerialBackend backend;
+    for (unsigned int i = first; i < last; i++)
+        {
+        kernel::granular_particle_forces<evaluator, contact_law, rolling_model>(args,
+                                                                                i,
+                                                                                true,
+                                                                                backend);
+        }
+    }
+
+#ifdef PAIR_PLUGIN_MULTIVERSION
+//! granularRangeForces() compiled for AVX2
+template<class evaluator, class contact_law, class rolling_model, class param_type>
+PAIR_PLUGIN_TARGET_AVX2 void granularRangeForcesAVX2(const kernel::granular_args_t<param_type>& args,
+                                                     unsigned int first,
+                                                     unsigned int last)
+    {
+    granularRangeForces<evaluator, contact_law, rolling_model>(args, first, last);
+    }
+
+//! granularRangeForces() compiled for AVX-512
+template<class evaluator, class contact_law, class rolling_model, class param_type>
+PAIR_PLUGIN_TARGET_AVX512 void
+granularRangeForcesAVX512(const kernel::granular_args_t<param_type>& args,
+                          unsigned int first,
+                          unsigned int last)
+    {
+    granularRangeForces<evaluator, contact_law, rolling_model>(args, first, last);
+    }
+#endif
+
+//! Pick the version of granularRangeForces() for the selected instruction set
+template<class evaluator, class contact_law, class rolling_model, class param_type>
+auto selectGranularRangeForces() -> decltype(
+    &granularRangeForces<evaluator, contact_law, rolling_model, param_type>)
+    {
+#ifdef PAIR_PLUGIN_MULTIVERSION
+    switch (cpuIsa())
+        {
+    case CpuIsa::avx512:
+        return &granularRangeForcesAVX512<evaluator, contact_law, rolling_model, param_type>;
+    case CpuIsa::avx2:
+        return &granularRangeForcesAVX2<evaluator, contact_law, rolling_model, param_type>;
+    default:
+        break;
+        }
+#endif
+    return &granularRangeForces<evaluator, contact_law, rolling_model, param_type>;
+    }
+
+    } // end namespace detail
+
+/*! The local particles are split into contiguous chunks, one per worker of
+   m_pool, and each runs kernel::granular_particle_forces() with the serial
+   backend, in the version selected by detail::selectCpuIsa(). Every
+   particle only writes to itself and to the history of its own row, so the
+   threads share no output. The result matches the serial loop on a full
+   neighbor list; the per particle energy and virial are always written.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::computeForcesThreaded()
+    {
+    ArrayHandle<unsigned int> h_n_neigh(m_nlist->getNNeighArray(),
+                                        access_location::host,
+                                        access_mode::read);
+    ArrayHandle<unsigned int> h_nlist(m_nlist->getNListArray(),
+                                      access_location::host,
+                                      access_mode::read);
+    ArrayHandle<size_t> h_head_list(m_nlist->getHeadList(),
+                                    access_location::host,
+                                    access_mode::read);
+    ArrayHandle<kernel::compact_neighbor_t> h_inner_nlist(m_inner_nlist,
+                                                          access_location::host,
+                                                          access_mode::read);
+    ArrayHandle<unsigned int> h_inner_n_neigh(m_inner_n_neigh,
+                                              access_location::host,
+                                              access_mode::read);
+
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar4> h_vel(m_clumps ? m_clump_vel : m_pdata->getVelocities(),
+                               access_location::host,
+                               access_mode::read);
+    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(),
+                                   access_location::host,
+                                   access_mode::read);
+    ArrayHandle<Scalar> h_charge(m_pdata->getCharges(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar3> h_omega(m_omega, access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_body(m_pdata->getBodies(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_heat_flow(m_heat_flow, access_location::host, access_mode::readwrite);
+
+    ArrayHandle<Scalar3> h_xi(m_xi, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar3> h_psi(m_psi, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar> h_phi(m_phi, access_location::host, access_mode::readwrite);
+
+    ArrayHandle<Scalar4> h_force(m_force, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar4> h_torque(m_torque, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar> h_virial(m_virial, access_location::host, access_mode::readwrite);
+    ArrayHandle<Scalar> h_rcutsq(m_rcutsq, access_location::host, access_mode::read);
+
+    const bool use_inner = m_inner_skin > Scalar(0.0);
+
+    ArrayHandle<uint4> h_packed_pos(m_packed_pos, access_location::host, access_mode::read);
+
+    kernel::granular_args_t<param_type> args;
+    args.d_force = h_force.data;
+    args.d_torque = h_torque.data;
+    args.d_virial = h_virial.data;
+    args.virial_pitch = m_virial_pitch;
+    args.d_pos = h_pos.data;
+    args.d_packed_pos = m_packed_positions ? h_packed_pos.data : nullptr;
+    args.d_vel = h_vel.data;
+    args.d_diameter = h_diameter.data;
+    args.d_charge = h_charge.data;
+    args.d_omega = h_omega.data;
+    args.d_n_neigh = h_n_neigh.data;
+    args.d_nlist = h_nlist.data;
+    args.d_head_list = h_head_list.data;
+    args.d_inner_nlist = use_inner ? h_inner_nlist.data : nullptr;
+    args.d_inner_n_neigh = use_inner ? h_inner_n_neigh.data : nullptr;
+    args.d_body = m_clumps ? h_body.data : nullptr;
+    args.d_active = m_active.data();
+    args.d_temperature = m_conductivity > Scalar(0.0) ? h_charge.data : nullptr;
+    args.d_heat_flow = h_heat_flow.data;
+    args.d_xi = h_xi.data;
+    args.d_psi = h_psi.data;
+    args.d_phi = h_phi.data;
+    args.d_rcutsq = h_rcutsq.data;
+    args.d_params = m_params.data();
+    args.ntypes = m_pdata->getNTypes();
+    args.box = m_pdata->getGlobalBox();
+    args.coeffs = getContactCoeffs();
+    args.gamma = m_gamma;
+    args.hi_shear_rate = m_hi_shear_rate;
+    args.conductivity = m_conductivity;
+    args.compute_virial = m_pdata->getFlags()[pdata_flag::pressure_tensor];
+
+    const unsigned int n_particles = m_pdata->getN();
+    const unsigned int n_threads = m_pool->size();
+    const auto range_forces
+        = detail::selectGranularRangeForces<evaluator, contact_law, rolling_model, param_type>();
+    m_pool->run(
+        [&args, range_forces, n_particles, n_threads](unsigned int t)
+        {
+            range_forces(args,
+                         detail::chunkBegin(t, n_particles, n_threads),
+                         detail::chunkBegin(t + 1, n_particles, n_threads));
+        });
+    }
+
+/*! The history, the local neighbor list, the inner list and the force cache
+   are indexed by neighbor list slot, and the angular velocities and inner
+   reference positions by particle. Every worker of the force loop touches
+   the slots of its own particles first, ghost particles go to the last
+   worker. Without workers the calling thread, which runs the serial loop,
+   touches everything. The split follows the particle order at the time of placement;
+   HOOMD's spatial sort keeps it close to later orders.
+
+    The previous history is placed as well, since it takes turns with the
+   current one.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::placeHostArrays()
+    {
+    m_placement_dirty = false;
+
+    const unsigned int N = m_pdata->getN();
+    const unsigned int n_threads = m_pool ? m_pool->size() : 1;
+
+    std::vector<size_t> particle_bounds(n_threads + 1);
+    std::vector<size_t> slot_bounds(n_threads + 1);
+        {
+        ArrayHandle<unsigned int> h_n_neigh(m_nlist->getNNeighArray(),
+                                            access_location::host,
+                                            access_mode::read);
+        ArrayHandle<size_t> h_head_list(m_nlist->getHeadList(),
+                                        access_location::host,
+                                        access_mode::read);
+        const size_t n_used = N > 0 ? h_head_list.data[N - 1] + h_n_neigh.data[N - 1] : 0;
+        for (unsigned int t = 0; t <= n_threads; t++)
+            {
+            const unsigned int p = detail::chunkBegin(t, N, n_threads);
+            particle_bounds[t] = p;
+            slot_bounds[t] = p < N ? h_head_list.data[p] : n_used;
+            }
+        }
+
+    placeArray(m_xi, slot_bounds);
+    placeArray(m_psi, slot_bounds);
+    placeArray(m_phi, slot_bounds);
+    placeArray(m_local_nlist, slot_bounds);
+    placeArray(m_prev_xi, slot_bounds);
+    placeArray(m_prev_psi, slot_bounds);
+    placeArray(m_prev_phi, slot_bounds);
+    placeArray(m_prev_nlist, slot_bounds);
+    placeArray(m_inner_nlist, slot_bounds);
+    placeArray(m_force_cache, slot_bounds);
+    placeArray(m_omega, particle_bounds);
+    placeArray(m_packed_pos, particle_bounds);
+    placeArray(m_inner_n_neigh, particle_bounds);
+    placeArray(m_inner_ref_pos, particle_bounds);
+    }
+
+/*! \param position (N, 3) positions of the new particles
+    \param type_id (N,) type ids of the new particles
+    \param diameter (N,) diameters of the new particles
+    \param velocity (N, 3) velocities of the new particles
+    \returns The tags of the new particles
+
+    The new particles pick up contacts at the next neighbor list update.
+   Existing contacts keep their history because it is keyed by tag.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+pybind11::array_t<unsigned int>
+GranularPotentialPair<evaluator, contact_law, rolling_model>::insertParticles(
+    pybind11::array_t<Scalar, pybind11::array::c_style | pybind11::array::forcecast> position,
+    pybind11::array_t<unsigned int, pybind11::array::c_style | pybind11::array::forcecast> type_id,
+    pybind11::array_t<Scalar, pybind11::array::c_style | pybind11::array::forcecast> diameter,
+    pybind11::array_t<Scalar, pybind11::array::c_style | pybind11::array::forcecast> velocity)
+    {
+    const size_t n = type_id.size();
+    if (position.size() != 3 * n || diameter.size() != n || velocity.size() != 3 * n)
+        {
+        throw std::runtime_error("Error inserting particles. Array sizes do not match.");
+        }
+
+    const Scalar* h_position = position.data();
+    const unsigned int* h_type_id = type_id.data();
+    const Scalar* h_diameter = diameter.data();
+    const Scalar* h_velocity = velocity.data();
+
+    for (size_t i = 0; i < n; i++)
+        {
+        if (h_type_id[i] >= m_pdata->getNTypes())
+            {
+            throw std::runtime_error("Error inserting particles. Invalid type");
+            }
+        }
+
+    pybind11::array_t<unsigned int> tags(n);
+    unsigned int* h_tags = tags.mutable_data();
+    for (size_t i = 0; i < n; i++)
+        {
+        unsigned int tag = m_pdata->addParticle(h_type_id[i]);
+        m_pdata->setPosition(tag,
+                             make_scalar3(h_position[3 * i],
+                                          h_position[3 * i + 1],
+                                          h_position[3 * i + 2]),
+                             false);
+        m_pdata->setVelocity(tag,
+                             make_scalar3(h_velocity[3 * i],
+                                          h_velocity[3 * i + 1],
+                                          h_velocity[3 * i + 2]));
+        m_pdata->setDiameter(tag, h_diameter[i]);
+        m_inserted_tags.push_back(tag);
+        h_tags[i] = tag;
+        }
+
+    m_exec_conf->msg->notice(7) << "GranularPotentialPair inserted " << n << " particles"
+                                << std::endl;
+    return tags;
+    }
+
+/*! \param tags Tags of the particles to remove
+
+    The history of the removed particles is dropped at the next neighbor
+   list update, all other contacts keep theirs.
+*/
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPair<evaluator, contact_law, rolling_model>::removeParticles(
+    pybind11::array_t<unsigned int, pybind11::array::c_style | pybind11::array::forcecast> tags)
+    {
+    const unsigned int* h_tags = tags.data();
+    for (size_t i = 0; i < tags.size(); i++)
+        {
+        m_pdata->removeParticle(h_tags[i]);
+        }
+
+    m_exec_conf->msg->notice(7) << "GranularPotentialPair removed " << tags.size()
+                                << " particles" << std::endl;
     }
 
 #ifdef ENABLE_MPI
 /*! \param timestep Current time step
  */
-template<class evaluator>
-CommFlags GranularPotentialPair<evaluator>::getRequestedCommFlags(uint64_t timestep)
+template<class evaluator, class contact_law, class rolling_model>
+CommFlags GranularPotentialPair<evaluator, contact_law, rolling_model>::getRequestedCommFlags(uint64_t timestep)
     {
     CommFlags flags = CommFlags(0);
 
-    if (evaluator::needsCharge())
+    // the charges of the ghosts are also their temperatures
+    if (evaluator::needsCharge() || m_conductivity > Scalar(0.0))
         flags[comm_flag::charge] = 1;
 
-    if (evaluator::needsDiameter())
-        flags[comm_flag::diameter] = 1;
+    // contacts always need the radii, velocities and spins of ghosts
+    flags[comm_flag::diameter] = 1;
+    flags[comm_flag::velocity] = 1;
+    flags[comm_flag::orientation] = 1;
+    if (m_clumps)
+        flags[comm_flag::body] = 1;
+    if (m_active.enabled())
+        flags[comm_flag::tag] = 1;
 
     flags |= ForceCompute::getRequestedCommFlags(timestep);
 
@@ -961,11 +2503,14 @@ namespace detail
 //! Export this pair potential to python
 /*! \param name Name of the class in the exported python module
     \tparam T Evaluator type to export.
+    \tparam contact_law Contact law policy (see GranularContactModels.h)
+    \tparam rolling_model Rolling/twisting resistance policy
 */
-template<class T> void export_GranularPotentialPair(pybind11::module& m, const std::string& name)
+template<class T, class contact_law = ContactLawLinear, class rolling_model = RollingSpring>
+void export_GranularPotentialPair(pybind11::module& m, const std::string& name)
     {
-    pybind11::class_<GranularPotentialPair<T>, ForceCompute, std::shared_ptr<GranularPotentialPair<T>>>
-        potentialpair(m, name.c_str());
+    typedef GranularPotentialPair<T, contact_law, rolling_model> pair_t;
+    pybind11::class_<pair_t, ForceCompute, std::shared_ptr<pair_t>> potentialpair(m, name.c_str());
     potentialpair
         .def(pybind11::init<std::shared_ptr<SystemDefinition>,
                             std::shared_ptr<NeighborList>,
@@ -973,16 +2518,46 @@ template<class T> void export_GranularPotentialPair(pybind11::module& m, const s
                             Scalar,
                             Scalar,
                             Scalar>())
-        .def("setParams", &GranularPotentialPair<T>::setParamsPython)
-        .def("getParams", &GranularPotentialPair<T>::getParams)
-        .def("setRCut", &GranularPotentialPair<T>::setRCutPython)
-        .def("getRCut", &GranularPotentialPair<T>::getRCut)
-        // .def("_evaluate", &GranularPotentialPair<T>::evaluate)
-        .def("slotWriteGSDShapeSpec", &GranularPotentialPair<T>::slotWriteGSDShapeSpec)
-        .def("connectGSDShapeSpec", &GranularPotentialPair<T>::connectGSDShapeSpec)
-        .def_readwrite("log_pair_info", &GranularPotentialPair<T>::m_log_pair_info)
-        .def_readwrite("gamma", &GranularPotentialPair<T>::m_gamma)
-        .def_property("hi_shear_rate", &GranularPotentialPair<T>::getHIShearRate, &GranularPotentialPair<T>::setHIShearRate);
+        .def("setParams", &pair_t::setParamsPython)
+        .def("getParams", &pair_t::getParams)
+        .def("setRCut", &pair_t::setRCutPython)
+        .def("getRCut", &pair_t::getRCut)
+        // .def("_evaluate", &pair_t::evaluate)
+        .def("slotWriteGSDShapeSpec", &pair_t::slotWriteGSDShapeSpec)
+        .def("connectGSDShapeSpec", &pair_t::connectGSDShapeSpec)
+        .def("insertParticles", &pair_t::insertParticles)
+        .def("removeParticles", &pair_t::removeParticles)
+        .def_readwrite("log_pair_info", &pair_t::m_log_pair_info)
+        .def_readwrite("gamma", &pair_t::m_gamma)
+        .def_readwrite("gamma_n", &pair_t::m_gamma_n)
+        .def_property("totals_only", &pair_t::getTotalsOnly, &pair_t::setTotalsOnly)
+        .def_property("clumps", &pair_t::getClumps, &pair_t::setClumps)
+        .def("setActiveGroup", &pair_t::setActiveGroup)
+        .def("getActiveGroup", &pair_t::getActiveGroup)
+        .def_property("conductivity", &pair_t::getConductivity, &pair_t::setConductivity)
+        .def_readwrite("specific_heat", &pair_t::m_specific_heat)
+        .def("setTemperatures", &pair_t::setTemperatures)
+        .def("getTemperatures", &pair_t::getTemperatures)
+        .def_property("inner_skin", &pair_t::getInnerSkin, &pair_t::setInnerSkin)
+        .def_property_readonly("inner_list_builds", &pair_t::getInnerListBuilds)
+        .def_property("force_cache_tol",
+                      &pair_t::getForceCacheTolerance,
+                      &pair_t::setForceCacheTolerance)
+        .def_property("packed_positions",
+                      &pair_t::getPackedPositions,
+                      &pair_t::setPackedPositions)
+        .def_property("num_threads", &pair_t::getNumThreads, &pair_t::setNumThreads)
+        .def_property("huge_pages", &pair_t::getHugePages, &pair_t::setHugePages)
+        .def_property("profile_bins", &pair_t::getProfileBins, &pair_t::setProfileBins)
+        .def_property("profile_axis", &pair_t::getProfileAxis, &pair_t::setProfileAxis)
+        .def_property("profile_period", &pair_t::getProfilePeriod, &pair_t::setProfilePeriod)
+        .def("getStressProfile", &pair_t::getStressProfile)
+        .def_property_readonly("stress_profile_samples", &pair_t::getStressProfileSamples)
+        .def("resetStressProfile", &pair_t::resetStressProfile)
+        .def_readwrite("mut", &pair_t::m_mut)
+        .def_readwrite("kt", &pair_t::m_kt)
+        .def_property("mode", &pair_t::getShiftMode, &pair_t::setShiftModePython)
+        .def_property("hi_shear_rate", &pair_t::getHIShearRate, &pair_t::setHIShearRate);
     }
 
     } // end namespace detail
@@ -1,17 +1,17 @@
 // Copyright (c) 2009-2022 The Regents of the University of Michigan.
 // Part of HOOMD-blue, released under the BSD 3-Clause License.
 
-#ifndef __HPF_POTENTIAL_PAIR_GPU_H__
-#define __HPF_POTENTIAL_PAIR_GPU_H__
+#ifndef __GRANULAR_POTENTIAL_PAIR_GPU_H__
+#define __GRANULAR_POTENTIAL_PAIR_GPU_H__
 
 #ifdef ENABLE_HIP
 
-#include "HPFPotentialPair.h"
-#include "HPFPotentialPairGPU.cuh"
+#include "GranularPotentialPair.h"
+#include "GranularPotentialPairGPU.cuh"
 #include "hoomd/Autotuner.h"
 
-/*! \file HPFPotentialPairGPU.h
-    \brief Defines the template class for standard pair potentials on the GPU
+/*! \file GranularPotentialPairGPU.h
+    \brief Defines the template class for granular contact forces on the GPU
     \note This header cannot be compiled by nvcc
 */
 
@@ -25,28 +25,36 @@ namespace hoomd
     {
 namespace md
     {
-//! Template class for computing anisotropic pair potentials on the GPU
-/*! Derived from HPFPotentialPair, this class provides exactly the same interface for computing
-   anisotropic pair potentials, forces and torques.  In the same way as PotentialPair, this class
-   serves as a shell dealing with all the details common to every pair potential calculation while
-   te \a evaluator calculates \f$V(\vec r,\vec e_i, \vec e_j)\f$ in a generic way.
-
-    \tparam evaluator EvaluatorPair class used to evaluate potential, force and torque.
-    \sa export_HPFPotentialPairGPU()
+//! Template class for computing granular contact forces on the GPU
+/*! Derived from GranularPotentialPair, this class provides exactly the same
+   interface. The contact history remap and the inner contact list are still
+   prepared on the host when the neighbor list changes. The angular
+   velocities are computed on the device, and the force loop writes every
+   output element of the local particles, so the outputs are not zeroed
+   first. The loop is kernel::granular_particle_forces(), the same
+   code the threaded CPU engine runs, so the two agree to round-off.
+
+    The force cache is a host feature and is not used here; totals_only is
+   rejected.
+
+    \tparam evaluator EvaluatorPair class used to evaluate the normal force
+    \tparam contact_law Contact law policy (see GranularContactModels.h)
+    \tparam rolling_model Rolling/twisting resistance policy
+    \sa export_GranularPotentialPairGPU()
 */
-template<class evaluator> class HPFPotentialPairGPU : public HPFPotentialPair<evaluator>
+template<class evaluator, class contact_law = ContactLawLinear, class rolling_model = RollingSpring>
+class GranularPotentialPairGPU : public GranularPotentialPair<evaluator, contact_law, rolling_model>
     {
     public:
     //! Construct the pair potential
-    HPFPotentialPairGPU(std::shared_ptr<SystemDefinition> sysdef,
-                          std::shared_ptr<NeighborList> nlist);
+    GranularPotentialPairGPU(std::shared_ptr<SystemDefinition> sysdef,
+                             std::shared_ptr<NeighborList> nlist,
+                             Scalar mus,
+                             Scalar mur,
+                             Scalar ks,
+                             Scalar kr);
     //! Destructor
-    virtual ~HPFPotentialPairGPU() {};
-
-    virtual void
-    setParams(unsigned int typ1, unsigned int typ2, const typename evaluator::param_type& param);
-
-    virtual void setShape(unsigned int typ, const typename evaluator::shape_type& shape_param);
+    virtual ~GranularPotentialPairGPU() {};
 
     protected:
     std::shared_ptr<Autotuner<2>> m_tuner; //!< Autotuner for block size and threads per particle
@@ -55,27 +63,35 @@ template<class evaluator> class HPFPotentialPairGPU : public HPFPotentialPair<ev
     virtual void computeForces(uint64_t timestep);
     };
 
-template<class evaluator>
-HPFPotentialPairGPU<evaluator>::HPFPotentialPairGPU(std::shared_ptr<SystemDefinition> sysdef,
-                                                        std::shared_ptr<NeighborList> nlist)
-    : HPFPotentialPair<evaluator>(sysdef, nlist)
+template<class evaluator, class contact_law, class rolling_model>
+GranularPotentialPairGPU<evaluator, contact_law, rolling_model>::GranularPotentialPairGPU(
+    std::shared_ptr<SystemDefinition> sysdef,
+    std::shared_ptr<NeighborList> nlist,
+    Scalar mus,
+    Scalar mur,
+    Scalar ks,
+    Scalar kr)
+    : GranularPotentialPair<evaluator, contact_law, rolling_model>(sysdef, nlist, mus, mur, ks, kr)
     {
     // can't run on the GPU if there aren't any GPUs in the execution configuration
     if (!this->m_exec_conf->isCUDAEnabled())
         {
         this->m_exec_conf->msg->error()
-            << "ai_pair." << evaluator::getName()
-            << ": Creating a HPFPotentialPairGPU with no GPU in the execution configuration"
+            << "pair." << evaluator::getName()
+            << ": Creating a GranularPotentialPairGPU with no GPU in the execution configuration"
             << std::endl
             << std::endl;
-        throw std::runtime_error("Error initializing HPFPotentialPairGPU");
+        throw std::runtime_error("Error initializing GranularPotentialPairGPU");
         }
 
+    // every thread only writes to its own particle
+    this->m_nlist->setStorageMode(NeighborList::full);
+
     // Initialize autotuner that tunes block sizes and threads per particle.
     m_tuner.reset(new Autotuner<2>({AutotunerBase::makeBlockSizeRange(this->m_exec_conf),
                                     AutotunerBase::getTppListPow2(this->m_exec_conf)},
                                    this->m_exec_conf,
-                                   "aniso_pair_" + evaluator::getName()));
+                                   "granular_pair_" + evaluator::getName()));
     this->m_autotuners.push_back(m_tuner);
 
 #ifdef ENABLE_MPI
@@ -84,21 +100,82 @@ HPFPotentialPairGPU<evaluator>::HPFPotentialPairGPU(std::shared_ptr<SystemDefini
 #endif
     }
 
-template<class evaluator> void HPFPotentialPairGPU<evaluator>::computeForces(uint64_t timestep)
+template<class evaluator, class contact_law, class rolling_model>
+void GranularPotentialPairGPU<evaluator, contact_law, rolling_model>::computeForces(
+    uint64_t timestep)
     {
     this->m_nlist->compute(timestep);
+    bool nlist_updated = this->m_nlist->hasBeenUpdated(timestep);
 
     // The GPU implementation CANNOT handle a half neighborlist, error out now
-    bool third_law = this->m_nlist->getStorageMode() == NeighborList::half;
-    if (third_law)
+    if (this->m_nlist->getStorageMode() == NeighborList::half)
         {
         this->m_exec_conf->msg->error()
-            << "ai_pair." << evaluator::getName()
-            << ": HPFPotentialPairGPU cannot handle a half neighborlist" << std::endl
+            << "pair." << evaluator::getName()
+            << ": GranularPotentialPairGPU cannot handle a half neighborlist" << std::endl
             << std::endl;
-        throw std::runtime_error("Error computing forces in HPFPotentialPairGPU");
+        throw std::runtime_error("Error computing forces in GranularPotentialPairGPU");
+        }
+
+    if (this->m_totals_only)
+        {
+        throw std::runtime_error("totals_only is not supported on the GPU.");
+        }
+
+    if (this->m_clumps)
+        {
+        throw std::runtime_error("clumps is not supported on the GPU.");
+        }
+
+    if (this->m_active.enabled())
+        {
+        throw std::runtime_error("active is not supported on the GPU.");
+        }
+
+    if (this->m_packed_positions)
+        {
+        throw std::runtime_error("packed_positions is not supported on the GPU.");
+        }
+
+    if (this->m_conductivity > Scalar(0.0))
+        {
+        throw std::runtime_error("Heat conduction is not supported on the GPU.");
+        }
+
+    // host side bookkeeping, then all local and ghost angular velocities
+    this->prepareForces(nlist_updated);
+
+    const unsigned int n_all = this->m_pdata->getN() + this->m_pdata->getNGhosts();
+    if (this->m_omega.getNumElements() < n_all)
+        {
+        this->m_omega.resize(n_all);
         }
 
+        {
+        ArrayHandle<Scalar4> d_orientation(this->m_pdata->getOrientationArray(),
+                                           access_location::device,
+                                           access_mode::read);
+        ArrayHandle<Scalar4> d_angmom(this->m_pdata->getAngularMomentumArray(),
+                                      access_location::device,
+                                      access_mode::read);
+        ArrayHandle<Scalar3> d_inertia(this->m_pdata->getMomentsOfInertiaArray(),
+                                       access_location::device,
+                                       access_mode::read);
+        ArrayHandle<Scalar3> d_omega(this->m_omega,
+                                     access_location::device,
+                                     access_mode::overwrite);
+        kernel::gpu_compute_granular_omega(d_omega.data,
+                                           d_orientation.data,
+                                           d_angmom.data,
+                                           d_inertia.data,
+                                           n_all,
+                                           256);
+        if (this->m_exec_conf->isCUDAErrorCheckingEnabled())
+            CHECK_CUDA_ERROR();
+        }
+
+    const bool use_inner = this->m_inner_skin > Scalar(0.0);
+
     // access the neighbor list
     ArrayHandle<unsigned int> d_n_neigh(this->m_nlist->getNNeighArray(),
                                         access_location::device,
@@ -109,113 +186,110 @@ template<class evaluator> void HPFPotentialPairGPU<evaluator>::computeForces(uin
     ArrayHandle<size_t> d_head_list(this->m_nlist->getHeadList(),
                                     access_location::device,
                                     access_mode::read);
+    ArrayHandle<kernel::compact_neighbor_t> d_inner_nlist(this->m_inner_nlist,
+                                                          access_location::device,
+                                                          access_mode::read);
+    ArrayHandle<unsigned int> d_inner_n_neigh(this->m_inner_n_neigh,
+                                              access_location::device,
+                                              access_mode::read);
 
     // access the particle data
     ArrayHandle<Scalar4> d_pos(this->m_pdata->getPositions(),
                                access_location::device,
                                access_mode::read);
+    ArrayHandle<Scalar4> d_vel(this->m_pdata->getVelocities(),
+                               access_location::device,
+                               access_mode::read);
     ArrayHandle<Scalar> d_diameter(this->m_pdata->getDiameters(),
                                    access_location::device,
                                    access_mode::read);
     ArrayHandle<Scalar> d_charge(this->m_pdata->getCharges(),
                                  access_location::device,
                                  access_mode::read);
-    ArrayHandle<Scalar4> d_orientation(this->m_pdata->getOrientationArray(),
-                                       access_location::device,
-                                       access_mode::read);
-    ArrayHandle<unsigned int> d_tag(this->m_pdata->getTags(),
-                                    access_location::device,
-                                    access_mode::read);
+    ArrayHandle<Scalar3> d_omega(this->m_omega, access_location::device, access_mode::read);
 
-    BoxDim box = this->m_pdata->getBox();
+    // contact history
+    ArrayHandle<Scalar3> d_xi(this->m_xi, access_location::device, access_mode::readwrite);
+    ArrayHandle<Scalar3> d_psi(this->m_psi, access_location::device, access_mode::readwrite);
+    ArrayHandle<Scalar> d_phi(this->m_phi, access_location::device, access_mode::readwrite);
 
-    // access parameters
+    // access parameters and outputs, overwritten by the kernel
     ArrayHandle<Scalar> d_rcutsq(this->m_rcutsq, access_location::device, access_mode::read);
     ArrayHandle<Scalar4> d_force(this->m_force, access_location::device, access_mode::overwrite);
     ArrayHandle<Scalar4> d_torque(this->m_torque, access_location::device, access_mode::overwrite);
     ArrayHandle<Scalar> d_virial(this->m_virial, access_location::device, access_mode::overwrite);
 
-    // access flags
-    PDataFlags flags = this->m_pdata->getFlags();
+    kernel::granular_args_t<typename evaluator::param_type> args;
+    args.d_force = d_force.data;
+    args.d_torque = d_torque.data;
+    args.d_virial = d_virial.data;
+    args.virial_pitch = this->m_virial.getPitch();
+    args.d_pos = d_pos.data;
+    args.d_packed_pos = nullptr;
+    args.d_vel = d_vel.data;
+    args.d_diameter = d_diameter.data;
+    args.d_charge = d_charge.data;
+    args.d_omega = d_omega.data;
+    args.d_n_neigh = d_n_neigh.data;
+    args.d_nlist = d_nlist.data;
+    args.d_head_list = d_head_list.data;
+    args.d_inner_nlist = use_inner ? d_inner_nlist.data : nullptr;
+    args.d_inner_n_neigh = use_inner ? d_inner_n_neigh.data : nullptr;
+    args.d_body = nullptr;
+    args.d_active = nullptr;
+    args.d_temperature = nullptr;
+    args.d_heat_flow = nullptr;
+    args.d_xi = d_xi.data;
+    args.d_psi = d_psi.data;
+    args.d_phi = d_phi.data;
+    args.d_rcutsq = d_rcutsq.data;
+    args.d_params = this->m_params.data();
+    args.ntypes = this->m_pdata->getNTypes();
+    args.box = this->m_pdata->getGlobalBox();
+    args.coeffs = this->getContactCoeffs();
+    args.gamma = this->m_gamma;
+    args.hi_shear_rate = this->m_hi_shear_rate;
+    args.conductivity = Scalar(0.0);
+    args.compute_virial = this->m_pdata->getFlags()[pdata_flag::pressure_tensor];
 
     this->m_exec_conf->beginMultiGPU();
+    m_tuner->begin();
 
-    this->m_tuner->begin();
-    unsigned int block_size = this->m_tuner->getParam()[0];
-    unsigned int threads_per_particle = this->m_tuner->getParam()[1];
-
-    // On the first iteration, shape parameters are updated. For optimization,
-    // could track this between calls to avoid extra copying.
-    bool first = true;
-
-    kernel::gpu_compute_pair_aniso_forces<evaluator>(
-        kernel::a_pair_args_t(d_force.data,
-                              d_torque.data,
-                              d_virial.data,
-                              this->m_virial.getPitch(),
-                              this->m_pdata->getN(),
-                              this->m_pdata->getMaxN(),
-                              d_pos.data,
-                              d_diameter.data,
-                              d_charge.data,
-                              d_orientation.data,
-                              d_tag.data,
-                              box,
-                              d_n_neigh.data,
-                              d_nlist.data,
-                              d_head_list.data,
-                              d_rcutsq.data,
-                              this->m_pdata->getNTypes(),
-                              block_size,
-                              this->m_shift_mode,
-                              flags[pdata_flag::pressure_tensor],
-                              threads_per_particle,
-                              this->m_pdata->getGPUPartition(),
-                              this->m_exec_conf->dev_prop,
-                              first),
-        this->m_params.data(),
-        this->m_shape_params.data());
-
-    this->m_tuner->end();
+    kernel::granular_launch_t launch_args;
+    launch_args.N = this->m_pdata->getN();
+    launch_args.block_size = m_tuner->getParam()[0];
+    launch_args.threads_per_particle = m_tuner->getParam()[1];
+    launch_args.gpu_partition = &this->m_pdata->getGPUPartition();
+
+    kernel::gpu_compute_granular_forces<evaluator, contact_law, rolling_model>(args, launch_args);
 
     if (this->m_exec_conf->isCUDAErrorCheckingEnabled())
         CHECK_CUDA_ERROR();
 
+    m_tuner->end();
     this->m_exec_conf->endMultiGPU();
     }
 
-template<class evaluator>
-void HPFPotentialPairGPU<evaluator>::setParams(unsigned int typ1,
-                                                 unsigned int typ2,
-                                                 const typename evaluator::param_type& param)
-    {
-    HPFPotentialPair<evaluator>::setParams(typ1, typ2, param);
-    this->m_params[this->m_typpair_idx(typ1, typ2)].set_memory_hint();
-    this->m_params[this->m_typpair_idx(typ2, typ1)].set_memory_hint();
-    }
-
-template<class evaluator>
-void HPFPotentialPairGPU<evaluator>::setShape(unsigned int typ,
-                                                const typename evaluator::shape_type& shape_param)
-    {
-    HPFPotentialPair<evaluator>::setShape(typ, shape_param);
-    this->m_shape_params[typ].set_memory_hint();
-    }
-
 namespace detail
     {
 //! Export this pair potential to python
 /*! \param name Name of the class in the exported python module
-    \tparam T Class type to export. \b Must be an instantiated HPFPotentialPairGPU class template.
-    \tparam Base Base class of \a T. \b Must be PotentialPair<evaluator> with the same evaluator as
-   used in \a T.
+    \tparam T Evaluator type to export.
+    \tparam contact_law Contact law policy (see GranularContactModels.h)
+    \tparam rolling_model Rolling/twisting resistance policy
 */
-template<class T> void export_HPFPotentialPairGPU(pybind11::module& m, const std::string& name)
+template<class T, class contact_law = ContactLawLinear, class rolling_model = RollingSpring>
+void export_GranularPotentialPairGPU(pybind11::module& m, const std::string& name)
     {
-    pybind11::class_<HPFPotentialPairGPU<T>,
-                     HPFPotentialPair<T>,
-                     std::shared_ptr<HPFPotentialPairGPU<T>>>(m, name.c_str())
-        .def(pybind11::init<std::shared_ptr<SystemDefinition>, std::shared_ptr<NeighborList>>());
+    typedef GranularPotentialPair<T, contact_law, rolling_model> base_t;
+    typedef GranularPotentialPairGPU<T, contact_law, rolling_model> pair_t;
+    pybind11::class_<pair_t, base_t, std::shared_ptr<pair_t>>(m, name.c_str())
+        .def(pybind11::init<std::shared_ptr<SystemDefinition>,
+                            std::shared_ptr<NeighborList>,
+                            Scalar,
+                            Scalar,
+                            Scalar,
+                            Scalar>());
     }
 
     } // end namespace detail
@@ -223,4 +297,4 @@ template<class T> void export_HPFPotentialPairGPU(pybind11::module& m, const std
     } // end namespace hoomd
 
 #endif // ENABLE_HIP
-#endif // __HPF_POTENTIAL_PAIR_GPU_H__
+#endif // __GRANULAR_POTENTIAL_PAIR_GPU_H__
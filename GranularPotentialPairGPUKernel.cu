@@ -0,0 +1,73 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+#include "EvaluatorPairHertzian.h"
+#include "EvaluatorPairSpring.h"
+#include "GranularPotentialPairGPU.cuh"
+
+namespace hoomd
+    {
+namespace md
+    {
+namespace kernel
+    {
+//! Kernel computing the angular velocity of one particle per thread
+__global__ void gpu_compute_granular_omega_kernel(Scalar3* d_omega,
+                                                  const Scalar4* d_orientation,
+                                                  const Scalar4* d_angmom,
+                                                  const Scalar3* d_inertia,
+                                                  unsigned int N)
+    {
+    const unsigned int idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if (idx >= N)
+        return;
+
+    d_omega[idx] = angular_velocity(d_orientation[idx], d_angmom[idx], d_inertia[idx]);
+    }
+
+/*! \param d_omega Real space angular velocities (output)
+    \param d_orientation Particle orientations
+    \param d_angmom Particle angular momenta
+    \param d_inertia Principal moments of inertia
+    \param N Number of local and ghost particles
+    \param block_size Block size to execute
+*/
+hipError_t gpu_compute_granular_omega(Scalar3* d_omega,
+                                      const Scalar4* d_orientation,
+                                      const Scalar4* d_angmom,
+                                      const Scalar3* d_inertia,
+                                      unsigned int N,
+                                      unsigned int block_size)
+    {
+    if (N == 0)
+        return hipSuccess;
+
+    dim3 grid(N / block_size + 1, 1, 1);
+    hipLaunchKernelGGL((gpu_compute_granular_omega_kernel),
+                       dim3(grid),
+                       dim3(block_size),
+                       0,
+                       0,
+                       d_omega,
+                       d_orientation,
+                       d_angmom,
+                       d_inertia,
+                       N);
+    return hipSuccess;
+    }
+
+template hipError_t __attribute__((visibility("default")))
+gpu_compute_granular_forces<EvaluatorPairHarmSpring, ContactLawLinear, RollingSpring>(
+    const granular_args_t<EvaluatorPairHarmSpring::param_type>& args,
+    const granular_launch_t& launch_args);
+template hipError_t __attribute__((visibility("default")))
+gpu_compute_granular_forces<EvaluatorPairHarmSpring, ContactLawHookean, RollingSpring>(
+    const granular_args_t<EvaluatorPairHarmSpring::param_type>& args,
+    const granular_launch_t& launch_args);
+template hipError_t __attribute__((visibility("default")))
+gpu_compute_granular_forces<EvaluatorPairHertzian, ContactLawHertzMindlin, RollingTwistingSpring>(
+    const granular_args_t<EvaluatorPairHertzian::param_type>& args,
+    const granular_launch_t& launch_args);
+    } // end namespace kernel
+    } // end namespace md
+    } // end namespace hoomd
@@ -4,11 +4,14 @@
 #ifndef __HPF_POTENTIAL_PAIR_H__
 #define __HPF_POTENTIAL_PAIR_H__
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <stdexcept>
+#include <vector>
 
 #include "hoomd/ForceCompute.h"
 // #include "hoomd/GSDShapeSpecWriter.h"
@@ -41,13 +44,99 @@ namespace hoomd
 namespace md
     {
 
-//! Hash function for std::pair
-struct pair_hash
+//! Open addressing map from a pair of particle tags to a contact slot
+/*! The table is scratch storage of the neighbor list rebuild. Its storage is
+   only ever grown, reset() keeps it, so once the table has seen the largest
+   neighbor list a rebuild does not touch the heap. Every growth is counted in
+   the counter passed to reset().
+*/
+class PairSlotTable
     {
-    template<class T1, class T2> size_t operator()(const std::pair<T1, T2>& pair) const
+    public:
+    //! Empty the table and make room for \a n entries
+    void reset(size_t n, unsigned int& n_allocations)
+        {
+        size_t capacity = 16;
+        while (capacity < 2 * n)
+            capacity *= 2;
+        if (capacity > m_keys.size())
+            {
+            m_keys.resize(capacity);
+            m_values.resize(capacity);
+            n_allocations++;
+            }
+        m_mask = capacity - 1;
+        std::fill(m_keys.begin(), m_keys.begin() + capacity, empty_key);
+        m_size = 0;
+        }
+
+    //! Forget all entries, keeping the storage
+    void clear()
+        {
+        if (m_size > 0)
+            std::fill(m_keys.begin(), m_keys.begin() + m_mask + 1, empty_key);
+        m_size = 0;
+        }
+
+    //! Map (\a tag_i, \a tag_j) to \a value, overwriting an existing entry
+    void insert(unsigned int tag_i, unsigned int tag_j, unsigned int value)
+        {
+        const uint64_t key = makeKey(tag_i, tag_j);
+        size_t slot = hash(key) & m_mask;
+        while (m_keys[slot] != empty_key && m_keys[slot] != key)
+            slot = (slot + 1) & m_mask;
+        if (m_keys[slot] == empty_key)
+            m_size++;
+        m_keys[slot] = key;
+        m_values[slot] = value;
+        }
+
+    //! Look up (\a tag_i, \a tag_j), returns false if there is no entry
+    bool find(unsigned int tag_i, unsigned int tag_j, unsigned int& value) const
+        {
+        if (m_size == 0)
+            return false;
+        const uint64_t key = makeKey(tag_i, tag_j);
+        size_t slot = hash(key) & m_mask;
+        while (m_keys[slot] != empty_key)
+            {
+            if (m_keys[slot] == key)
+                {
+                value = m_values[slot];
+                return true;
+                }
+            slot = (slot + 1) & m_mask;
+            }
+        return false;
+        }
+
+    //! Swap the contents with another table
+    void swap(PairSlotTable& other)
+        {
+        m_keys.swap(other.m_keys);
+        m_values.swap(other.m_values);
+        std::swap(m_mask, other.m_mask);
+        std::swap(m_size, other.m_size);
+        }
+
+    private:
+    static constexpr uint64_t empty_key = ~uint64_t(0);
+
+    static uint64_t makeKey(unsigned int tag_i, unsigned int tag_j)
+        {
+        return (uint64_t(tag_i) << 32) | uint64_t(tag_j);
+        }
+
+    //! Fibonacci hashing, the high bits of the product are the best mixed
+    static size_t hash(uint64_t key)
         {
-        return std::hash<T1>()(pair.first) ^ std::hash<T2>()(pair.second);
+        return size_t((key * 11400714819323198485ull) >> 17);
         }
+
+    std::vector<uint64_t> m_keys;       //!< Keys, empty_key marks a free slot
+    std::vector<unsigned int> m_values; //!< Contact slot of each key
+    size_t m_mask = 0;                  //!< Capacity in use minus one
+    size_t m_size = 0;                  //!< Number of entries
     };
 
 //! Template class for computing pair potentials
@@ -165,6 +254,12 @@ template<class evaluator> class HPFPotentialPair : public ForceCompute
         m_pair_idx.clear();
         }
 
+    /// Number of times the rebuild scratch storage had to grow
+    unsigned int getArenaAllocations() const
+        {
+        return m_arena_allocations;
+        }
+
     virtual void notifyDetach()
         {
         if (m_attached)
@@ -233,12 +328,35 @@ template<class evaluator> class HPFPotentialPair : public ForceCompute
     /// Maps pairs of particles to indices in the surface velocities
     /// This will be necessary to resort the arrays after neighborlist
     /// updates
-    std::unordered_map<std::pair<unsigned int, unsigned int>, unsigned int, pair_hash> m_pair_idx;
-
-    // Might replace the above variable with a list
+    PairSlotTable m_pair_idx;
 
-    std::unordered_map<unsigned int, Scalar3>
-        m_w_cache; //!< Cache for the angular velocity of each particle
+    // Scratch arena of the neighbor list rebuild. The state of the previous
+    // list is swapped in here and is the source of the remap, so storage
+    // ping-pongs between the two sets and only grows. A rebuild of a list no
+    // larger than any before it does not allocate.
+    std::vector<Scalar3, hoomd::detail::managed_allocator<Scalar3>>
+        m_prev_xi; //!< xi of the previous neighbor list
+    std::vector<Scalar3, hoomd::detail::managed_allocator<Scalar3>>
+        m_prev_psi;                       //!< psi of the previous neighbor list
+    PairSlotTable m_prev_pair_idx;        //!< Pair map of the previous neighbor list
+    unsigned int m_arena_allocations = 0; //!< Number of times the arena grew
+
+    /// Cache for the angular velocity of each particle, indexed by tag. An
+    /// entry is valid when its stamp equals the current one, which saves
+    /// clearing the cache every step.
+    std::vector<Scalar3> m_w_cache;
+    std::vector<uint64_t> m_w_cache_stamp;
+    uint64_t m_w_stamp = 0;
+
+    //! Grow \a v to hold \a n elements without reallocating, counting growth
+    template<class Vector> void reserveScratch(Vector& v, size_t n)
+        {
+        if (v.capacity() < n)
+            {
+            v.reserve(n);
+            m_arena_allocations++;
+            }
+        }
 
     /// r_cut (not squared) given to the neighbor list
     std::shared_ptr<GlobalArray<Scalar>> m_r_cut_nlist;
@@ -280,23 +398,6 @@ HPFPotentialPair<evaluator>::HPFPotentialPair(std::shared_ptr<SystemDefinition>
     assert(m_pdata);
     assert(m_nlist);
 
-    // initialize empty containers for xi, psi, pair_idx, and w_cache
-    std::vector<Scalar3, hoomd::detail::managed_allocator<Scalar3>> xi;
-    std::vector<Scalar3, hoomd::detail::managed_allocator<Scalar3>> psi;
-    std::unordered_map<std::pair<unsigned int, unsigned int>, unsigned int, pair_hash> pair_idx;
-    std::unordered_map<unsigned int, Scalar3> w_cache;
-
-    auto num_nlist_elements = 0;
-    xi.reserve(num_nlist_elements);
-    psi.reserve(num_nlist_elements);
-    pair_idx.reserve(m_pair_idx.max_load_factor() * num_nlist_elements);
-    w_cache.reserve(w_cache.max_load_factor() * num_nlist_elements);
-
-    m_xi.swap(xi);
-    m_psi.swap(psi);
-    m_pair_idx.swap(pair_idx);
-    m_w_cache.swap(w_cache);
-
     GlobalArray<Scalar> rcutsq(m_typpair_idx.getNumElements(), m_exec_conf);
     m_rcutsq.swap(rcutsq);
     m_params = std::vector<param_type, hoomd::detail::managed_allocator<param_type>>(
@@ -561,29 +662,27 @@ template<class evaluator> void HPFPotentialPair<evaluator>::computeForces(uint64
 
     // need to start from a zero force, energy and virial
     memset((void*)h_force.data, 0, sizeof(Scalar4) * m_force.getNumElements());
-    memset((void*)h_force.data, 0, sizeof(Scalar4) * m_torque.getNumElements());
+    memset((void*)h_torque.data, 0, sizeof(Scalar4) * m_torque.getNumElements());
     memset((void*)h_virial.data, 0, sizeof(Scalar) * m_virial.getNumElements());
 
     // let's handle the startup and rebuild case
     if (!m_dynamic_state_flag || nlist_updated)
         {
-        std::cout << "Rebuild nlist: " << timestep << std::endl;
         m_dynamic_state_flag = true;
 
-        std::vector<Scalar3, hoomd::detail::managed_allocator<Scalar3>> xi;
-        std::vector<Scalar3, hoomd::detail::managed_allocator<Scalar3>> psi;
-        std::unordered_map<std::pair<unsigned int, unsigned int>, unsigned int, pair_hash> pair_idx;
-
-        // maybe we don't need to reserve?
-        xi.reserve(m_xi.size());
-        psi.reserve(m_psi.size());
-        pair_idx.reserve(m_pair_idx.bucket_count());
-
-        xi.swap(m_xi);
-        psi.swap(m_psi);
-        pair_idx.swap(m_pair_idx);
+        // the current state becomes the source of the remap
+        m_xi.swap(m_prev_xi);
+        m_psi.swap(m_prev_psi);
+        m_pair_idx.swap(m_prev_pair_idx);
+        m_xi.clear();
+        m_psi.clear();
 
-        clearDynamicState();
+        size_t n_pairs = 0;
+        for (unsigned int i = 0; i < m_pdata->getN(); i++)
+            n_pairs += h_n_neigh.data[i];
+        reserveScratch(m_xi, n_pairs);
+        reserveScratch(m_psi, n_pairs);
+        m_pair_idx.reset(n_pairs, m_arena_allocations);
 
         unsigned int idx = 0;
         for (int i = 0; i < (int)m_pdata->getN(); i++)
@@ -597,20 +696,18 @@ template<class evaluator> void HPFPotentialPair<evaluator>::computeForces(uint64
                 // scalar)
                 unsigned int j = h_nlist.data[myHead + k];
                 auto tag_j = h_tag.data[j];
-                auto pair = std::make_pair(tag_i, tag_j);
-                if (pair_idx.empty() || pair_idx.find(pair) == pair_idx.end())
+                unsigned int mapped_idx;
+                if (m_prev_pair_idx.find(tag_i, tag_j, mapped_idx))
                     {
-                    m_xi.push_back(make_scalar3(0, 0, 0));
-                    m_psi.push_back(make_scalar3(0, 0, 0));
+                    m_xi.push_back(m_prev_xi[mapped_idx]);
+                    m_psi.push_back(m_prev_psi[mapped_idx]);
                     }
                 else
                     {
-                    unsigned int mapped_idx = pair_idx[pair];
-
-                    m_xi.push_back(xi[mapped_idx]);
-                    m_psi.push_back(psi[mapped_idx]);
+                    m_xi.push_back(make_scalar3(0, 0, 0));
+                    m_psi.push_back(make_scalar3(0, 0, 0));
                     }
-                m_pair_idx[pair] = idx;
+                m_pair_idx.insert(tag_i, tag_j, idx);
                 idx++;
                 }
             }
@@ -619,7 +716,15 @@ template<class evaluator> void HPFPotentialPair<evaluator>::computeForces(uint64
     auto xi_it = m_xi.begin();
     auto psi_it = m_psi.begin();
 
-    m_w_cache.clear(); // clear angular velocity cache for the upcoming run
+    // invalidate the angular velocity cache for the upcoming run
+    const size_t n_tags = size_t(m_pdata->getMaximumTag()) + 1;
+    if (m_w_cache.size() < n_tags)
+        {
+        m_w_cache.resize(n_tags);
+        m_w_cache_stamp.resize(n_tags, 0);
+        m_arena_allocations++;
+        }
+    m_w_stamp++;
 
     // for each particle
     for (int i = 0; i < (int)m_pdata->getN(); i++)
@@ -633,8 +738,7 @@ template<class evaluator> void HPFPotentialPair<evaluator>::computeForces(uint64
         vec3<Scalar> w_i(0.0, 0.0, 0.0);
         auto tag_i = h_tag.data[i];
 
-        auto search = m_w_cache.find(tag_i);
-        if (search == m_w_cache.end())
+        if (m_w_cache_stamp[tag_i] != m_w_stamp)
             {
             quat<Scalar> q_i(h_orientation.data[i]);
             quat<Scalar> p_i(h_angmom.data[i]);
@@ -649,10 +753,11 @@ template<class evaluator> void HPFPotentialPair<evaluator>::computeForces(uint64
                                I_i.z == 0.0 ? 0.0 : s_i.z / I_i.z);
             w_i = rotate(q_i, w_i); // now rotate into real frame
             m_w_cache[tag_i] = make_scalar3(w_i.x, w_i.y, w_i.z);
+            m_w_cache_stamp[tag_i] = m_w_stamp;
             }
         else
             {
-            Scalar3 _w = search->second;
+            Scalar3 _w = m_w_cache[tag_i];
             w_i = vec3<Scalar>(_w.x, _w.y, _w.z);
             }
 
@@ -745,8 +850,7 @@ template<class evaluator> void HPFPotentialPair<evaluator>::computeForces(uint64
                 //!> NOTE - eventually we probably want to avoid some of
                 //! these computations if mus or mur are zero
 
-                auto search = m_w_cache.find(tag_j);
-                if (search == m_w_cache.end())
+                if (m_w_cache_stamp[tag_j] != m_w_stamp)
                     {
                     quat<Scalar> q_j(h_orientation.data[j]);
                     quat<Scalar> p_j(h_angmom.data[j]);
@@ -758,12 +862,13 @@ template<class evaluator> void HPFPotentialPair<evaluator>::computeForces(uint64
                     w_j = vec3<Scalar>(I_j.x == 0.0 ? 0.0 : s_j.x / I_j.x,
                                        I_j.y == 0.0 ? 0.0 : s_j.y / I_j.y,
                                        I_j.z == 0.0 ? 0.0 : s_j.z / I_j.z);
-                    w_j = rotate(q_j, w_i); // now rotate into real frame
+                    w_j = rotate(q_j, w_j); // now rotate into real frame
                     m_w_cache[tag_j] = make_scalar3(w_j.x, w_j.y, w_j.z);
+                    m_w_cache_stamp[tag_j] = m_w_stamp;
                     }
                 else
                     {
-                    Scalar3 _w = search->second;
+                    Scalar3 _w = m_w_cache[tag_j];
                     w_j = vec3<Scalar>(_w.x, _w.y, _w.z);
                     }
 
@@ -946,7 +1051,8 @@ template<class T> void export_HPFPotentialPair(pybind11::module& m, const std::s
         .def("connectGSDShapeSpec", &HPFPotentialPair<T>::connectGSDShapeSpec)
         .def_readwrite("log_pair_info", &HPFPotentialPair<T>::m_log_pair_info)
         .def_readwrite("gamma", &HPFPotentialPair<T>::m_gamma)
-        .def_property("hi_shear_rate", &HPFPotentialPair<T>::getHIShearRate, &HPFPotentialPair<T>::setHIShearRate);
+        .def_property("hi_shear_rate", &HPFPotentialPair<T>::getHIShearRate, &HPFPotentialPair<T>::setHIShearRate)
+        .def_property_readonly("arena_allocations", &HPFPotentialPair<T>::getArenaAllocations);
     }
 
     } // end namespace detail
@@ -0,0 +1,120 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __HOST_ARRAY_PLACEMENT_H__
+#define __HOST_ARRAY_PLACEMENT_H__
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "WorkerPool.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*! \file HostArrayPlacement.h
+    \brief Page placement of host arrays read by a threaded force loop
+    \details Linux places a page on the NUMA node of the thread that first
+   touches it. GlobalArray zero fills new storage in the allocating thread,
+   so without help every page of a large array ends up on one socket. The
+   functions here give the pages back to the kernel and touch them again
+   from the threads that will read them, each thread copying back its own
+   part of the contents. Optionally the range is marked for transparent huge
+   pages first.
+
+    Only private host memory may be placed this way: never pass memory that
+   is mapped to a GPU. In builds with GPU support (ENABLE_HIP) the host
+   storage of a GlobalArray may be pinned or managed memory even on a CPU
+   device, and releasing it with madvise is not safe, so placement is a
+   no-op there, as it is on platforms other than Linux.
+*/
+
+namespace hoomd
+    {
+namespace md
+    {
+namespace detail
+    {
+//! First item of chunk \a t when \a n items are split into \a n_chunks
+/*! The chunks are contiguous and all but the last have the same length. The
+   threaded force loop and the page placement both use this split, so every
+   thread reads pages it touched first.
+*/
+inline unsigned int chunkBegin(unsigned int t, unsigned int n, unsigned int n_chunks)
+    {
+    const unsigned int chunk = (n + n_chunks - 1) / n_chunks;
+    return std::min(t * chunk, n);
+    }
+
+//! Re-place the pages of a host array
+/*! \param data Host array
+    \param n Number of elements of \a data
+    \param bounds Element ranges, thread t touches [bounds[t], bounds[t+1])
+    \param huge_pages Back the array by transparent huge pages if possible
+    \param pool Workers of the force loop, thread t is worker t. Null when
+   the loop runs on the calling thread, which then touches everything.
+
+    The contents of \a data are preserved. Only whole pages inside the array
+   are released, the partial pages at either end keep their placement.
+*/
+template<class T>
+void placeHostArray(T* data,
+                    size_t n,
+                    const std::vector<size_t>& bounds,
+                    bool huge_pages,
+                    WorkerPool* pool)
+    {
+#if defined(__linux__) && !defined(ENABLE_HIP)
+    const size_t page = size_t(sysconf(_SC_PAGESIZE));
+    char* const begin = reinterpret_cast<char*>(data);
+    char* const end = begin + n * sizeof(T);
+    char* const first_page
+        = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(begin) + page - 1) / page * page);
+    char* const last_page = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(end) / page * page);
+    if (bounds.size() < 2 || last_page <= first_page)
+        return;
+    const size_t length = last_page - first_page;
+
+    // keep the contents, the released pages read back as zero
+    std::vector<char> contents(first_page, last_page);
+
+    if (huge_pages)
+        madvise(first_page, length, MADV_HUGEPAGE);
+    if (madvise(first_page, length, MADV_DONTNEED) != 0)
+        return;
+
+    // the first and last thread also take anything outside of bounds
+    const unsigned int n_threads = (unsigned int)bounds.size() - 1;
+    auto worker = [&](unsigned int t)
+    {
+        if (t >= n_threads)
+            return;
+        char* lo = t == 0 ? first_page : std::max(begin + bounds[t] * sizeof(T), first_page);
+        char* hi = t == n_threads - 1 ? last_page
+                                      : std::min(begin + bounds[t + 1] * sizeof(T), last_page);
+        if (hi > lo)
+            memcpy(lo, contents.data() + (lo - first_page), hi - lo);
+    };
+
+    if (pool)
+        pool->run(worker);
+    else
+        worker(0);
+#endif
+    }
+
+    } // end namespace detail
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __HOST_ARRAY_PLACEMENT_H__
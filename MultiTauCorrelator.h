@@ -0,0 +1,133 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __MULTI_TAU_CORRELATOR_H__
+#define __MULTI_TAU_CORRELATOR_H__
+
+#include <algorithm>
+#include <vector>
+
+/*! \file MultiTauCorrelator.h
+    \brief Declares the MultiTauCorrelator class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! On the fly autocorrelation of a scalar time series
+/*! Multiple tau correlator after Ramirez et al., J. Chem. Phys. 133, 154103
+   (2010). Level 0 keeps the last \a p samples and correlates lags 0 to p - 1.
+   Every \a m samples of a level are averaged into one sample of the next
+   level, which correlates lags p/m to p - 1 in units of m^k samples. After T
+   samples there are about log_m(T / p) levels, so memory and the work per
+   sample grow with log T. Levels are added as the series grows.
+
+    The correlation at lag l is the mean of x(t) x(t + l) over all pairs seen,
+   with block averaged x on the coarse levels.
+*/
+class MultiTauCorrelator
+    {
+    public:
+    //! Construct a correlator
+    /*! \param p Number of lags per level
+        \param m Averaging factor between levels, must divide \a p
+    */
+    MultiTauCorrelator(unsigned int p = 16, unsigned int m = 2) : m_p(p), m_m(m) { }
+
+    //! Add the next sample of the series
+    void add(double x)
+        {
+        add(x, 0);
+        }
+
+    //! Forget all samples
+    void reset()
+        {
+        m_levels.clear();
+        }
+
+    //! Get the lags (in samples) and the correlation at each lag
+    void get(std::vector<double>& lags, std::vector<double>& values) const
+        {
+        lags.clear();
+        values.clear();
+        double scale = 1.0;
+        for (unsigned int k = 0; k < m_levels.size(); k++)
+            {
+            const Level& level = m_levels[k];
+            for (unsigned int j = k == 0 ? 0 : m_p / m_m; j < m_p; j++)
+                {
+                if (level.n_correlation[j] > 0)
+                    {
+                    lags.push_back(j * scale);
+                    values.push_back(level.correlation[j] / double(level.n_correlation[j]));
+                    }
+                }
+            scale *= m_m;
+            }
+        }
+
+    private:
+    //! Samples and running sums of one level
+    struct Level
+        {
+        explicit Level(unsigned int p) : shift(p, 0.0), correlation(p, 0.0), n_correlation(p, 0)
+            {
+            }
+
+        std::vector<double> shift;                //!< Ring buffer of the last p samples
+        std::vector<double> correlation;          //!< Sum of products at each lag
+        std::vector<unsigned long> n_correlation; //!< Number of products at each lag
+        unsigned long n_samples = 0;              //!< Number of samples added to the level
+        unsigned int insert = 0;                  //!< Next position in shift
+        double accumulator = 0.0;                 //!< Sum of samples for the next level
+        unsigned int n_accumulated = 0;           //!< Number of samples in accumulator
+        };
+
+    void add(double x, unsigned int k)
+        {
+        if (k == m_levels.size())
+            m_levels.emplace_back(m_p);
+        Level& level = m_levels[k];
+
+        level.shift[level.insert] = x;
+        level.n_samples++;
+
+        // the first lags of a coarse level are covered by the finer one
+        const unsigned int j_min = k == 0 ? 0 : m_p / m_m;
+        const unsigned long n_lags = std::min<unsigned long>(level.n_samples, m_p);
+        for (unsigned int j = j_min; j < n_lags; j++)
+            {
+            const unsigned int i = (level.insert + m_p - j) % m_p;
+            level.correlation[j] += x * level.shift[i];
+            level.n_correlation[j]++;
+            }
+        level.insert = (level.insert + 1) % m_p;
+
+        level.accumulator += x;
+        if (++level.n_accumulated == m_m)
+            {
+            const double average = level.accumulator / m_m;
+            level.accumulator = 0.0;
+            level.n_accumulated = 0;
+            // level may be invalidated by the recursion
+            add(average, k + 1);
+            }
+        }
+
+    unsigned int m_p;            //!< Number of lags per level
+    unsigned int m_m;            //!< Averaging factor between levels
+    std::vector<Level> m_levels; //!< Levels, finest first
+    };
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __MULTI_TAU_CORRELATOR_H__
@@ -0,0 +1,370 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+/*! \file NeighborListMultiLevel.cc
+    \brief Defines NeighborListMultiLevel
+*/
+
+#include "NeighborListMultiLevel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace hoomd
+    {
+namespace md
+    {
+/*! \param sysdef System definition
+    \param r_buff Buffer distance to add to the per pair cutoff
+*/
+NeighborListMultiLevel::NeighborListMultiLevel(std::shared_ptr<SystemDefinition> sysdef,
+                                               Scalar r_buff)
+    : NeighborList(sysdef, r_buff)
+    {
+    m_exec_conf->msg->notice(5) << "Constructing NeighborListMultiLevel" << endl;
+    }
+
+NeighborListMultiLevel::~NeighborListMultiLevel()
+    {
+    m_exec_conf->msg->notice(5) << "Destroying NeighborListMultiLevel" << endl;
+    }
+
+/*! \param ratio Ratio of the largest to the smallest diameter of a level,
+   must be greater than 1
+*/
+void NeighborListMultiLevel::setLevelRatio(Scalar ratio)
+    {
+    if (!(ratio > Scalar(1.0)))
+        {
+        throw runtime_error("NeighborListMultiLevel: level_ratio must be greater than 1.");
+        }
+    m_level_ratio = ratio;
+    forceUpdate();
+    }
+
+#ifdef ENABLE_MPI
+CommFlags NeighborListMultiLevel::getRequestedCommFlags(uint64_t timestep)
+    {
+    CommFlags flags = NeighborList::getRequestedCommFlags(timestep);
+    flags[comm_flag::diameter] = 1;
+    if (m_active.enabled())
+        flags[comm_flag::tag] = 1;
+    return flags;
+    }
+#endif
+
+/*! \param f Fractional position in the local box
+    \param level Level whose grid to use
+    \returns Cell coordinates, clamped to the grid
+*/
+int3 NeighborListMultiLevel::getCellCoords(const Scalar3& f, unsigned int level) const
+    {
+    const uint3 dim = m_level_dim[level];
+    int3 c = make_int3(int((f.x - m_grid_lo.x) / m_grid_span.x * Scalar(dim.x)),
+                       int((f.y - m_grid_lo.y) / m_grid_span.y * Scalar(dim.y)),
+                       int((f.z - m_grid_lo.z) / m_grid_span.z * Scalar(dim.z)));
+    c.x = std::min(std::max(c.x, 0), int(dim.x) - 1);
+    c.y = std::min(std::max(c.y, 0), int(dim.y) - 1);
+    c.z = std::min(std::max(c.z, 0), int(dim.z) - 1);
+    return c;
+    }
+
+/*! Levels are counted up from the smallest diameter present, local and ghost
+   particles alike. Empty levels are dropped. All level grids cover the same
+   fractional region: the whole box along periodic directions and the extent
+   of the local and ghost particles along the others.
+*/
+void NeighborListMultiLevel::binParticles()
+    {
+    const unsigned int n_total = m_pdata->getN() + m_pdata->getNGhosts();
+    const BoxDim& box = m_pdata->getBox();
+    const Scalar3 L = box.getNearestPlaneDistance();
+    const uchar3 periodic = box.getPeriodic();
+
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(),
+                                   access_location::host,
+                                   access_mode::read);
+
+    // smallest diameter and extent of the particles
+    Scalar dmin = numeric_limits<Scalar>::max();
+    Scalar3 f_lo = make_scalar3(0.0, 0.0, 0.0);
+    Scalar3 f_hi = make_scalar3(1.0, 1.0, 1.0);
+    for (unsigned int i = 0; i < n_total; i++)
+        {
+        if (h_diameter.data[i] > Scalar(0.0))
+            dmin = std::min(dmin, h_diameter.data[i]);
+
+        const Scalar3 f
+            = box.makeFraction(make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z));
+        f_lo.x = std::min(f_lo.x, f.x);
+        f_lo.y = std::min(f_lo.y, f.y);
+        f_lo.z = std::min(f_lo.z, f.z);
+        f_hi.x = std::max(f_hi.x, f.x);
+        f_hi.y = std::max(f_hi.y, f.y);
+        f_hi.z = std::max(f_hi.z, f.z);
+        }
+    if (dmin == numeric_limits<Scalar>::max())
+        dmin = Scalar(1.0);
+
+    m_grid_lo = make_scalar3(periodic.x ? Scalar(0.0) : f_lo.x,
+                             periodic.y ? Scalar(0.0) : f_lo.y,
+                             periodic.z ? Scalar(0.0) : f_lo.z);
+    m_grid_span = make_scalar3(periodic.x ? Scalar(1.0) : f_hi.x - f_lo.x,
+                               periodic.y ? Scalar(1.0) : f_hi.y - f_lo.y,
+                               periodic.z ? Scalar(1.0) : f_hi.z - f_lo.z);
+    // all particles in one plane, e.g. z in a 2D system
+    m_grid_span.x = m_grid_span.x > Scalar(0.0) ? m_grid_span.x : Scalar(1.0);
+    m_grid_span.y = m_grid_span.y > Scalar(0.0) ? m_grid_span.y : Scalar(1.0);
+    m_grid_span.z = m_grid_span.z > Scalar(0.0) ? m_grid_span.z : Scalar(1.0);
+
+    // assign levels, m_particle_cell holds the raw level for now
+    m_particle_cell.resize(n_total);
+    Scalar raw_dmax[max_levels];
+    unsigned int raw_count[max_levels];
+    std::fill(raw_dmax, raw_dmax + max_levels, Scalar(0.0));
+    std::fill(raw_count, raw_count + max_levels, 0);
+    const Scalar inv_log_ratio = Scalar(1.0) / log(m_level_ratio);
+    for (unsigned int i = 0; i < n_total; i++)
+        {
+        const Scalar d = h_diameter.data[i];
+        unsigned int level = 0;
+        if (m_diameter_cutoff && d > dmin)
+            level = std::min(max_levels - 1, (unsigned int)(log(d / dmin) * inv_log_ratio));
+        m_particle_cell[i] = level;
+        raw_dmax[level] = std::max(raw_dmax[level], d);
+        raw_count[level]++;
+        }
+
+    // drop empty levels and size each grid for its largest particle
+    unsigned int compact[max_levels];
+    m_level_dmax.clear();
+    m_level_dim.clear();
+    m_level_offset.clear();
+    unsigned int n_cells = 0;
+    for (unsigned int level = 0; level < max_levels; level++)
+        {
+        if (raw_count[level] == 0)
+            continue;
+        compact[level] = (unsigned int)m_level_dmax.size();
+
+        Scalar width = m_rcut_max_max + m_r_buff;
+        if (m_diameter_cutoff)
+            width = std::min(width, raw_dmax[level] + m_r_buff);
+
+        uint3 dim = make_uint3(1, 1, 1);
+        if (width > Scalar(0.0))
+            {
+            // a larger cell than needed is still correct, so coarsen grids
+            // that would hold far more cells than particles
+            const unsigned int max_cells = std::max(8 * raw_count[level], 27u);
+            do
+                {
+                dim = make_uint3(std::max(1u, (unsigned int)(m_grid_span.x * L.x / width)),
+                                 std::max(1u, (unsigned int)(m_grid_span.y * L.y / width)),
+                                 std::max(1u, (unsigned int)(m_grid_span.z * L.z / width)));
+                if (m_sysdef->getNDimensions() == 2)
+                    dim.z = 1;
+                width *= Scalar(2.0);
+                } while (size_t(dim.x) * dim.y * dim.z > max_cells);
+            }
+
+        m_level_dmax.push_back(raw_dmax[level]);
+        m_level_dim.push_back(dim);
+        m_level_offset.push_back(n_cells);
+        n_cells += dim.x * dim.y * dim.z;
+        }
+
+    // counting sort of the particles by cell
+    m_cell_head.assign(n_cells + 1, 0);
+    for (unsigned int i = 0; i < n_total; i++)
+        {
+        const unsigned int level = compact[m_particle_cell[i]];
+        const Scalar3 f
+            = box.makeFraction(make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z));
+        const int3 c = getCellCoords(f, level);
+        const uint3 dim = m_level_dim[level];
+        const unsigned int cell = m_level_offset[level] + c.x + dim.x * (c.y + dim.y * c.z);
+        m_particle_cell[i] = cell;
+        m_cell_head[cell + 1]++;
+        }
+    for (unsigned int cell = 0; cell < n_cells; cell++)
+        m_cell_head[cell + 1] += m_cell_head[cell];
+
+    m_cell_particles.resize(n_total);
+    std::vector<unsigned int> cursor(m_cell_head.begin(), m_cell_head.end() - 1);
+    for (unsigned int i = 0; i < n_total; i++)
+        m_cell_particles[cursor[m_particle_cell[i]]++] = i;
+    }
+
+/*! \param timestep Current time step of the simulation
+ */
+void NeighborListMultiLevel::buildNlist(uint64_t timestep)
+    {
+    binParticles();
+    m_active.update(*m_pdata);
+    const unsigned char* active = m_active.data();
+
+    const BoxDim& box = m_pdata->getBox();
+    const Scalar3 L = box.getNearestPlaneDistance();
+    const uchar3 periodic = box.getPeriodic();
+
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_diameter(m_pdata->getDiameters(),
+                                   access_location::host,
+                                   access_mode::read);
+    ArrayHandle<unsigned int> h_body(m_pdata->getBodies(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_r_cut(m_r_cut, access_location::host, access_mode::read);
+
+    ArrayHandle<size_t> h_head_list(m_head_list, access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_Nmax(m_Nmax, access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_conditions(m_conditions,
+                                           access_location::host,
+                                           access_mode::readwrite);
+    ArrayHandle<unsigned int> h_nlist(m_nlist, access_location::host, access_mode::overwrite);
+    ArrayHandle<unsigned int> h_n_neigh(m_n_neigh, access_location::host, access_mode::overwrite);
+
+    const unsigned int n_levels = (unsigned int)m_level_dmax.size();
+    const bool full_list = m_storage_mode == NeighborList::full;
+
+    for (unsigned int i = 0; i < m_pdata->getN(); i++)
+        {
+        const Scalar3 pi = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z);
+        const unsigned int type_i = __scalar_as_int(h_pos.data[i].w);
+        const unsigned int body_i = h_body.data[i];
+        const bool frozen_i = active && !active[i];
+        const Scalar d_i = h_diameter.data[i];
+        const Scalar3 f_i = box.makeFraction(pi);
+        const size_t head_idx_i = h_head_list.data[i];
+        unsigned int n_neigh_i = 0;
+
+        for (unsigned int level = 0; level < n_levels; level++)
+            {
+            // widest pair between i and this level
+            Scalar r_search = m_rcut_max_max;
+            if (m_diameter_cutoff)
+                r_search = std::min(r_search, Scalar(0.5) * (d_i + m_level_dmax[level]));
+            r_search += m_r_buff;
+
+            const uint3 dim = m_level_dim[level];
+            const int3 c = getCellCoords(f_i, level);
+            const int3 ext
+                = make_int3(int(ceil(r_search * Scalar(dim.x) / (m_grid_span.x * L.x))),
+                            int(ceil(r_search * Scalar(dim.y) / (m_grid_span.y * L.y))),
+                            int(ceil(r_search * Scalar(dim.z) / (m_grid_span.z * L.z))));
+
+            // visit every cell once when the stencil wraps onto itself
+            const bool all_x = periodic.x && 2 * ext.x + 1 >= int(dim.x);
+            const bool all_y = periodic.y && 2 * ext.y + 1 >= int(dim.y);
+            const bool all_z = periodic.z && 2 * ext.z + 1 >= int(dim.z);
+            const int3 lo = make_int3(all_x ? 0 : c.x - ext.x,
+                                      all_y ? 0 : c.y - ext.y,
+                                      all_z ? 0 : c.z - ext.z);
+            const int3 hi = make_int3(all_x ? int(dim.x) - 1 : c.x + ext.x,
+                                      all_y ? int(dim.y) - 1 : c.y + ext.y,
+                                      all_z ? int(dim.z) - 1 : c.z + ext.z);
+
+            for (int cz = lo.z; cz <= hi.z; cz++)
+                {
+                int wz = cz;
+                if (wz < 0 || wz >= int(dim.z))
+                    {
+                    if (!periodic.z)
+                        continue;
+                    wz = (wz + int(dim.z)) % int(dim.z);
+                    }
+                for (int cy = lo.y; cy <= hi.y; cy++)
+                    {
+                    int wy = cy;
+                    if (wy < 0 || wy >= int(dim.y))
+                        {
+                        if (!periodic.y)
+                            continue;
+                        wy = (wy + int(dim.y)) % int(dim.y);
+                        }
+                    for (int cx = lo.x; cx <= hi.x; cx++)
+                        {
+                        int wx = cx;
+                        if (wx < 0 || wx >= int(dim.x))
+                            {
+                            if (!periodic.x)
+                                continue;
+                            wx = (wx + int(dim.x)) % int(dim.x);
+                            }
+
+                        const unsigned int cell
+                            = m_level_offset[level] + wx + dim.x * (wy + dim.y * wz);
+                        for (unsigned int k = m_cell_head[cell]; k < m_cell_head[cell + 1]; k++)
+                            {
+                            const unsigned int j = m_cell_particles[k];
+                            if (full_list ? i == j : j <= i)
+                                continue;
+
+                            if (m_filter_body && body_i != NO_BODY && body_i == h_body.data[j])
+                                continue;
+
+                            if (frozen_i && !active[j])
+                                continue;
+
+                            const unsigned int type_j = __scalar_as_int(h_pos.data[j].w);
+                            const Scalar r_cut = h_r_cut.data[m_typpair_idx(type_i, type_j)];
+                            if (r_cut <= Scalar(0.0))
+                                continue;
+
+                            Scalar r_list = r_cut;
+                            if (m_diameter_cutoff)
+                                r_list = std::min(r_list,
+                                                  Scalar(0.5) * (d_i + h_diameter.data[j]));
+                            r_list += m_r_buff;
+
+                            const Scalar3 pj
+                                = make_scalar3(h_pos.data[j].x, h_pos.data[j].y, h_pos.data[j].z);
+                            const Scalar3 dx = box.minImage(pj - pi);
+                            if (dot(dx, dx) > r_list * r_list)
+                                continue;
+
+                            if (n_neigh_i < h_Nmax.data[type_i])
+                                h_nlist.data[head_idx_i + n_neigh_i] = j;
+                            else
+                                h_conditions.data[type_i]
+                                    = std::max(h_conditions.data[type_i], n_neigh_i + 1);
+                            ++n_neigh_i;
+                            }
+                        }
+                    }
+                }
+            }
+
+        h_n_neigh.data[i] = n_neigh_i;
+        }
+    }
+
+namespace detail
+    {
+void export_NeighborListMultiLevel(pybind11::module& m)
+    {
+    pybind11::class_<NeighborListMultiLevel,
+                     NeighborList,
+                     std::shared_ptr<NeighborListMultiLevel>>(m, "NeighborListMultiLevel")
+        .def(pybind11::init<std::shared_ptr<SystemDefinition>, Scalar>())
+        .def_property("level_ratio",
+                      &NeighborListMultiLevel::getLevelRatio,
+                      &NeighborListMultiLevel::setLevelRatio)
+        .def_property("diameter_cutoff",
+                      &NeighborListMultiLevel::getDiameterCutoff,
+                      &NeighborListMultiLevel::setDiameterCutoff)
+        .def("setActiveGroup", &NeighborListMultiLevel::setActiveGroup)
+        .def("getActiveGroup", &NeighborListMultiLevel::getActiveGroup)
+        .def_property_readonly("num_levels", &NeighborListMultiLevel::getNumLevels);
+    }
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
@@ -0,0 +1,142 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __NEIGHBORLIST_MULTILEVEL_H__
+#define __NEIGHBORLIST_MULTILEVEL_H__
+
+#include <pybind11/pybind11.h>
+#include <vector>
+
+#include "hoomd/md/NeighborList.h"
+
+#include "ActiveMask.h"
+
+/*! \file NeighborListMultiLevel.h
+    \brief Declares the NeighborListMultiLevel class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+
+//! Diameter aware neighbor list for highly size disperse systems
+/*! With a single cell list the cell width is set by the largest pair, so in a
+   1:10 mixture every small particle scans cells sized for two large ones and
+   collects hundreds of candidates it can never touch.
+
+    NeighborListMultiLevel sorts particles into levels by diameter, each level
+   spanning a factor of \a level_ratio, and bins every level into its own
+   grid whose cell width fits the largest particle in that level. A particle
+   then searches each level with a stencil sized for its own diameter and the
+   largest diameter of that level.
+
+    When \a diameter_cutoff is set, a pair is kept only within
+   min(r_cut(type_i, type_j), (d_i + d_j) / 2) + r_buff, which is the contact
+   distance the granular computes need. The type pair r_cut matrix still
+   bounds the list, so the ghost layer width is unchanged.
+
+    When an active group is set, pairs in which neither particle is active
+   are left out of the list, so no pair force visits contacts between frozen
+   wall or base particles.
+
+    Levels and grids are host only and rebuilt on every neighbor list build.
+*/
+class PYBIND11_EXPORT NeighborListMultiLevel : public NeighborList
+    {
+    public:
+    //! Constructs the neighbor list
+    NeighborListMultiLevel(std::shared_ptr<SystemDefinition> sysdef, Scalar r_buff);
+
+    //! Destructor
+    virtual ~NeighborListMultiLevel();
+
+    //! Set the ratio between the largest and smallest diameter of a level
+    void setLevelRatio(Scalar ratio);
+
+    Scalar getLevelRatio()
+        {
+        return m_level_ratio;
+        }
+
+    //! Set whether pairs are cut off at the sum of the radii
+    void setDiameterCutoff(bool diameter_cutoff)
+        {
+        m_diameter_cutoff = diameter_cutoff;
+        forceUpdate();
+        }
+
+    bool getDiameterCutoff()
+        {
+        return m_diameter_cutoff;
+        }
+
+    //! Set the group of active particles, nullptr makes every particle active
+    void setActiveGroup(std::shared_ptr<ParticleGroup> group)
+        {
+        m_active.setGroup(group);
+        forceUpdate();
+        }
+
+    std::shared_ptr<ParticleGroup> getActiveGroup()
+        {
+        return m_active.getGroup();
+        }
+
+    //! Get the number of levels used by the last build
+    unsigned int getNumLevels()
+        {
+        return (unsigned int)m_level_dmax.size();
+        }
+
+#ifdef ENABLE_MPI
+    //! Ghost diameters are needed to place ghosts on their level, and ghost
+    //! tags to flag the active ghosts
+    virtual CommFlags getRequestedCommFlags(uint64_t timestep);
+#endif
+
+    protected:
+    //! Builds the neighbor list
+    virtual void buildNlist(uint64_t timestep);
+
+    private:
+    //! Assign particles to levels and bin each level into its grid
+    void binParticles();
+
+    //! Cell coordinates of a fractional position in the grid of a level
+    int3 getCellCoords(const Scalar3& f, unsigned int level) const;
+
+    Scalar m_level_ratio = Scalar(2.0); //!< Diameter span of one level
+    bool m_diameter_cutoff = true;      //!< Cut pairs off at the sum of the radii
+    ActiveMask m_active;                //!< Flags of the active particles
+
+    static const unsigned int max_levels = 16; //!< Upper bound on the number of levels
+
+    Scalar3 m_grid_lo;   //!< Fractional origin shared by all level grids
+    Scalar3 m_grid_span; //!< Fractional extent shared by all level grids
+
+    std::vector<Scalar> m_level_dmax;           //!< Largest diameter in each level
+    std::vector<uint3> m_level_dim;             //!< Cell grid dimensions of each level
+    std::vector<unsigned int> m_level_offset;   //!< First cell of each level
+    std::vector<unsigned int> m_cell_head;      //!< First entry of each cell (CSR)
+    std::vector<unsigned int> m_cell_particles; //!< Particle indices ordered by cell
+    std::vector<unsigned int> m_particle_cell;  //!< Cell of each particle in its own level
+    };
+
+namespace detail
+    {
+//! Exports NeighborListMultiLevel to python
+void export_NeighborListMultiLevel(pybind11::module& m);
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __NEIGHBORLIST_MULTILEVEL_H__
@@ -0,0 +1,474 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __NUDGED_ELASTIC_BAND_H__
+#define __NUDGED_ELASTIC_BAND_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HostArrayPlacement.h"
+#include "ReplicaPairForce.h"
+
+/*! \file NudgedElasticBand.h
+    \brief Defines the NudgedElasticBand class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! Climbing image nudged elastic band
+/*! Holds a chain of images between two fixed end points and relaxes the
+   interior images onto the minimum energy path. The force on an image is
+   the part of the potential force normal to the path plus a spring force
+   along it, with the tangent estimated from the energies of the
+   neighboring images (Henkelman and Jonsson 2000). With \a climb, the
+   interior image of highest energy feels no spring and the component of
+   the potential force along the path reversed, so it climbs to the saddle
+   point (Henkelman, Uberuaga and Jonsson 2000). All interior images are
+   relaxed together by FIRE; the chain has converged when no particle of
+   any image feels an NEB force larger than \a force_tol.
+
+    All images share one Verlet list, built around the middle image with
+   the cutoff of every particle extended by how far it strays from the
+   middle image along the chain. Images that are close to each other, as
+   in a localized rearrangement, therefore cost little more than one list.
+   Every iteration evaluates the forces of all images in one pass over
+   \a num_threads threads.
+
+    \tparam evaluator Pair evaluator
+*/
+template<class evaluator> class NudgedElasticBand : public ReplicaPairForce<evaluator>
+    {
+    public:
+    typedef typename ReplicaPairForce<evaluator>::double_array double_array;
+    typedef typename ReplicaPairForce<evaluator>::uint_array uint_array;
+
+    //! Construct the band
+    /*! \param n_types Number of particle types
+        \param mode Energy shift mode of the pair potential
+    */
+    NudgedElasticBand(unsigned int n_types, const std::string& mode)
+        : ReplicaPairForce<evaluator>(n_types, mode)
+        {
+        }
+
+    //! Set the images of the chain, including both end points
+    void setImages(pybind11::list positions,
+                   uint_array typeid_,
+                   double_array box,
+                   unsigned int dimensions);
+
+    //! Relax the chain
+    void run();
+
+    unsigned int getNumImages()
+        {
+        return (unsigned int)m_images.size();
+        }
+
+    //! Get the positions of an image, wrapped into the box
+    pybind11::array_t<double> getPosition(unsigned int image)
+        {
+        const Configuration& c = getImage(image);
+        std::vector<double> position(c.pos.size() * 3);
+        for (size_t i = 0; i < c.pos.size(); i++)
+            {
+            position[3 * i] = c.pos[i].x;
+            position[3 * i + 1] = c.pos[i].y;
+            position[3 * i + 2] = c.pos[i].z;
+            }
+        return pybind11::array_t<double>({c.pos.size(), size_t(3)}, position.data());
+        }
+
+    //! Get the image shifts of an image accumulated while wrapping
+    pybind11::array_t<int> getImageShift(unsigned int image)
+        {
+        const Configuration& c = getImage(image);
+        std::vector<int> shift(c.image.size() * 3);
+        for (size_t i = 0; i < c.image.size(); i++)
+            {
+            shift[3 * i] = c.image[i].x;
+            shift[3 * i + 1] = c.image[i].y;
+            shift[3 * i + 2] = c.image[i].z;
+            }
+        return pybind11::array_t<int>({c.image.size(), size_t(3)}, shift.data());
+        }
+
+    //! Get the potential energy of every image
+    pybind11::array_t<double> getEnergies()
+        {
+        return pybind11::array_t<double>(m_energy.size(), m_energy.data());
+        }
+
+    uint64_t getSteps()
+        {
+        return m_steps;
+        }
+
+    bool getConverged()
+        {
+        return m_converged;
+        }
+
+    //! Get the index of the climbing image, -1 when no image climbs
+    int getClimbingImage()
+        {
+        return m_climbing_image;
+        }
+
+    //! Get the largest NEB force on a particle after the last step
+    Scalar getMaxForce()
+        {
+        return m_max_force;
+        }
+
+    Scalar m_k = Scalar(1.0);            //!< Spring constant between images
+    bool m_climb = true;                 //!< Let the highest image climb
+    Scalar m_dt = Scalar(0.005);         //!< Initial time step
+    Scalar m_force_tol = Scalar(1e-4);   //!< Tolerance of the largest NEB force
+    uint64_t m_max_steps = 100000;       //!< Maximum number of steps
+
+    protected:
+    typedef typename ReplicaPairForce<evaluator>::Configuration Configuration;
+    typedef typename ReplicaPairForce<evaluator>::VerletList VerletList;
+
+    std::vector<Configuration> m_images;         //!< Images, end points included
+    std::vector<double> m_energy;                //!< Potential energy of each image
+    std::vector<std::vector<Scalar3>> m_force;   //!< Potential force on each image
+    VerletList m_list;                           //!< Verlet list shared by the images
+    std::vector<std::vector<Scalar3>> m_ref_pos; //!< Positions of each image at the last build
+    uint64_t m_steps = 0;                        //!< Number of FIRE steps of the last run
+    bool m_converged = false;                    //!< True when the last run converged
+    int m_climbing_image = -1;                   //!< Climbing image of the last step
+    Scalar m_max_force = Scalar(0.0);            //!< Largest NEB force of the last step
+
+    const Configuration& getImage(unsigned int image)
+        {
+        if (image >= m_images.size())
+            {
+            throw std::runtime_error("Invalid image index.");
+            }
+        return m_images[image];
+        }
+
+    //! Build the Verlet list shared by all images
+    void buildSharedList();
+
+    //! Check whether a particle of any image moved more than half the buffer
+    bool sharedListExpired() const;
+
+    //! Compute the potential forces of images [first, last) in parallel
+    void computeImageForces(unsigned int first, unsigned int last);
+
+    //! Convert the potential force on an interior image into its NEB force
+    void projectForce(unsigned int m, bool climbing, std::vector<Scalar3>& neb_force) const;
+    };
+
+/*! \param positions List of (N, 3) positions of the images, end points
+   included
+    \param typeid_ (N,) type ids, shared by all images
+    \param box Box as [Lx, Ly, Lz, xy, xz, yz], shared by all images
+    \param dimensions Number of dimensions, 2 or 3
+*/
+template<class evaluator>
+void NudgedElasticBand<evaluator>::setImages(pybind11::list positions,
+                                             uint_array typeid_,
+                                             double_array box,
+                                             unsigned int dimensions)
+    {
+    if (positions.size() < 3)
+        {
+        throw std::runtime_error("A band needs at least 3 images.");
+        }
+
+    std::vector<Configuration> images(positions.size());
+    for (size_t m = 0; m < images.size(); m++)
+        {
+        this->makeConfiguration(images[m],
+                                positions[m].cast<double_array>(),
+                                typeid_,
+                                box,
+                                dimensions);
+        if (images[m].pos.size() != images[0].pos.size())
+            {
+            throw std::runtime_error("All images must have the same number of particles.");
+            }
+        }
+    m_images.swap(images);
+    m_energy.assign(m_images.size(), 0.0);
+    m_force.assign(m_images.size(), std::vector<Scalar3>());
+    m_steps = 0;
+    m_converged = false;
+    m_climbing_image = -1;
+    }
+
+template<class evaluator> void NudgedElasticBand<evaluator>::buildSharedList()
+    {
+    const Configuration& ref = m_images[m_images.size() / 2];
+    const size_t N = ref.pos.size();
+
+    std::vector<Scalar> reach(N, Scalar(0.0));
+    for (const auto& c : m_images)
+        {
+        for (size_t i = 0; i < N; i++)
+            {
+            const Scalar3 d = ref.box.minImage(c.pos[i] - ref.pos[i]);
+            reach[i] = std::max(reach[i], Scalar(std::sqrt(dot(d, d))));
+            }
+        }
+
+    this->buildVerletList(ref, this->getListRange(), m_list, &reach);
+    m_ref_pos.resize(m_images.size());
+    for (size_t m = 0; m < m_images.size(); m++)
+        m_ref_pos[m] = m_images[m].pos;
+    }
+
+/*! \returns True when the shared list must be rebuilt
+ */
+template<class evaluator> bool NudgedElasticBand<evaluator>::sharedListExpired() const
+    {
+    const Scalar max_dispsq = Scalar(0.25) * this->m_buffer * this->m_buffer;
+    for (size_t m = 0; m < m_images.size(); m++)
+        {
+        const Configuration& c = m_images[m];
+        for (size_t i = 0; i < c.pos.size(); i++)
+            {
+            const Scalar3 d = c.box.minImage(c.pos[i] - m_ref_pos[m][i]);
+            if (dot(d, d) > max_dispsq)
+                return true;
+            }
+        }
+    return false;
+    }
+
+/*! \param first First image to compute
+    \param last One past the last image to compute
+*/
+template<class evaluator>
+void NudgedElasticBand<evaluator>::computeImageForces(unsigned int first, unsigned int last)
+    {
+    auto worker = [this](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int m = begin; m < end; m++)
+            m_energy[m] = this->computeForces(m_images[m], m_images[m].pos, m_list, m_force[m]);
+    };
+
+    const unsigned int n = last - first;
+    const unsigned int n_threads = std::max(std::min(this->m_num_threads, n), 1u);
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (unsigned int t = 1; t < n_threads; t++)
+        {
+        threads.emplace_back(worker,
+                             first + detail::chunkBegin(t, n, n_threads),
+                             first + detail::chunkBegin(t + 1, n, n_threads));
+        }
+    worker(first, first + detail::chunkBegin(1, n, n_threads));
+    for (auto& thread : threads)
+        thread.join();
+    }
+
+/*! \param m Interior image
+    \param climbing True when \a m is the climbing image
+    \param neb_force NEB force on every particle of \a m
+*/
+template<class evaluator>
+void NudgedElasticBand<evaluator>::projectForce(unsigned int m,
+                                                bool climbing,
+                                                std::vector<Scalar3>& neb_force) const
+    {
+    const Configuration& prev = m_images[m - 1];
+    const Configuration& cur = m_images[m];
+    const Configuration& next = m_images[m + 1];
+    const size_t N = cur.pos.size();
+
+    // tangent from the higher of the neighboring images, mixed at extrema
+    const double e_prev = m_energy[m - 1];
+    const double e = m_energy[m];
+    const double e_next = m_energy[m + 1];
+    double w_next, w_prev;
+    if (e_next > e && e > e_prev)
+        {
+        w_next = 1.0;
+        w_prev = 0.0;
+        }
+    else if (e_next < e && e < e_prev)
+        {
+        w_next = 0.0;
+        w_prev = 1.0;
+        }
+    else
+        {
+        const double dv_max = std::max(std::abs(e_next - e), std::abs(e_prev - e));
+        const double dv_min = std::min(std::abs(e_next - e), std::abs(e_prev - e));
+        w_next = e_next > e_prev ? dv_max : dv_min;
+        w_prev = e_next > e_prev ? dv_min : dv_max;
+        }
+
+    std::vector<Scalar3> tangent(N);
+    double tsq = 0.0;
+    double d_next_sq = 0.0;
+    double d_prev_sq = 0.0;
+    for (size_t i = 0; i < N; i++)
+        {
+        const Scalar3 d_next = cur.box.minImage(next.pos[i] - cur.pos[i]);
+        const Scalar3 d_prev = cur.box.minImage(cur.pos[i] - prev.pos[i]);
+        tangent[i] = d_next * Scalar(w_next) + d_prev * Scalar(w_prev);
+        tsq += dot(tangent[i], tangent[i]);
+        d_next_sq += dot(d_next, d_next);
+        d_prev_sq += dot(d_prev, d_prev);
+        }
+
+    const Scalar inv_t = tsq > 0.0 ? Scalar(1.0 / std::sqrt(tsq)) : Scalar(0.0);
+    double f_parallel = 0.0;
+    for (size_t i = 0; i < N; i++)
+        {
+        tangent[i] = tangent[i] * inv_t;
+        f_parallel += dot(m_force[m][i], tangent[i]);
+        }
+
+    // the climbing image inverts the parallel force and feels no spring
+    const Scalar spring = Scalar(m_k * (std::sqrt(d_next_sq) - std::sqrt(d_prev_sq)));
+    const Scalar along = climbing ? Scalar(-2.0 * f_parallel) : Scalar(spring - f_parallel);
+    neb_force.resize(N);
+    for (size_t i = 0; i < N; i++)
+        neb_force[i] = m_force[m][i] + tangent[i] * along;
+    }
+
+/*! The end points are evaluated once. Every step computes the forces of all
+   interior images, projects them and moves the images with FIRE.
+*/
+template<class evaluator> void NudgedElasticBand<evaluator>::run()
+    {
+    if (m_images.empty())
+        {
+        throw std::runtime_error("Set the images before running the band.");
+        }
+
+    pybind11::gil_scoped_release release;
+
+    const unsigned int M = (unsigned int)m_images.size();
+    const size_t N = m_images[0].pos.size();
+
+    buildSharedList();
+    computeImageForces(0, M);
+
+    std::vector<std::vector<Scalar3>> neb_force(M);
+    std::vector<std::vector<Scalar3>> vel(M, std::vector<Scalar3>(N, make_scalar3(0, 0, 0)));
+    FireState fire(m_dt);
+    m_steps = 0;
+    m_converged = false;
+
+    while (true)
+        {
+        m_climbing_image = -1;
+        if (m_climb)
+            {
+            m_climbing_image = 1;
+            for (unsigned int m = 2; m < M - 1; m++)
+                {
+                if (m_energy[m] > m_energy[m_climbing_image])
+                    m_climbing_image = int(m);
+                }
+            }
+
+        double fsq = 0.0;
+        double vsq = 0.0;
+        double power = 0.0;
+        double max_fsq = 0.0;
+        for (unsigned int m = 1; m < M - 1; m++)
+            {
+            projectForce(m, int(m) == m_climbing_image, neb_force[m]);
+            for (size_t i = 0; i < N; i++)
+                {
+                const double f2 = dot(neb_force[m][i], neb_force[m][i]);
+                fsq += f2;
+                max_fsq = std::max(max_fsq, f2);
+                vsq += dot(vel[m][i], vel[m][i]);
+                power += dot(neb_force[m][i], vel[m][i]);
+                }
+            }
+        m_max_force = Scalar(std::sqrt(max_fsq));
+
+        if (m_max_force < m_force_tol)
+            {
+            m_converged = true;
+            break;
+            }
+        if (m_steps >= m_max_steps)
+            break;
+
+        Scalar c_v, c_f;
+        fire.mix(fsq, vsq, power, c_v, c_f);
+
+        for (unsigned int m = 1; m < M - 1; m++)
+            {
+            Configuration& c = m_images[m];
+            for (size_t i = 0; i < N; i++)
+                {
+                vel[m][i] = vel[m][i] * c_v + neb_force[m][i] * c_f;
+                vel[m][i] += neb_force[m][i] * fire.dt;
+                c.pos[i] += vel[m][i] * fire.dt;
+                c.box.wrap(c.pos[i], c.image[i]);
+                }
+            }
+
+        if (sharedListExpired())
+            {
+            buildSharedList();
+            }
+        computeImageForces(1, M - 1);
+        m_steps++;
+        }
+    }
+
+namespace detail
+    {
+//! Export a NudgedElasticBand to python
+/*! \param name Name of the class in the exported python module
+    \tparam T Evaluator type to export.
+*/
+template<class T> void export_NudgedElasticBand(pybind11::module& m, const std::string& name)
+    {
+    typedef NudgedElasticBand<T> neb_t;
+    pybind11::class_<neb_t, std::shared_ptr<neb_t>> cls(m, name.c_str());
+    cls.def(pybind11::init<unsigned int, const std::string&>())
+        .def("setImages", &neb_t::setImages)
+        .def("run", &neb_t::run)
+        .def("getPosition", &neb_t::getPosition)
+        .def("getImage", &neb_t::getImageShift)
+        .def_property_readonly("num_images", &neb_t::getNumImages)
+        .def_property_readonly("energies", &neb_t::getEnergies)
+        .def_property_readonly("steps", &neb_t::getSteps)
+        .def_property_readonly("converged", &neb_t::getConverged)
+        .def_property_readonly("climbing_image", &neb_t::getClimbingImage)
+        .def_property_readonly("max_force", &neb_t::getMaxForce)
+        .def_readwrite("k", &neb_t::m_k)
+        .def_readwrite("climb", &neb_t::m_climb)
+        .def_readwrite("dt", &neb_t::m_dt)
+        .def_readwrite("force_tol", &neb_t::m_force_tol)
+        .def_readwrite("max_steps", &neb_t::m_max_steps);
+    export_ReplicaPairForce(cls);
+    }
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __NUDGED_ELASTIC_BAND_H__
@@ -0,0 +1,337 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __PAIR_PARAMETER_GRADIENT_H__
+#define __PAIR_PARAMETER_GRADIENT_H__
+
+#include <memory>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hoomd/ForceCompute.h"
+#include "hoomd/Index1D.h"
+#include "hoomd/SystemDefinition.h"
+#include "hoomd/md/NeighborList.h"
+
+#ifdef ENABLE_MPI
+#include "hoomd/HOOMDMPI.h"
+#endif
+
+/*! \file PairParameterGradient.h
+    \brief Defines the PairParameterGradient class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! Parameter gradients of a pair potential for force matching
+/*! For the force matching loss
+    \f[ L = \sum_{\mathrm{frames}} \sum_i |\vec{F}_i - \vec{F}_i^{\mathrm{ref}}|^2 \f]
+   accumulate() adds the contribution of the current frame to L, to dL/dp and
+   to dU/dp for every parameter p of every type pair, in a single traversal
+   of the neighbor list. The model forces F_i are read from \a force, which
+   must have computed them for the current configuration. The derivatives
+   of each pair come from evaluator::evalParamDerivatives().
+
+    Parameters and cutoffs are set from python, as they are for the pair
+   potential, so the gradients do not depend on the internals of the pair
+   class. The derivatives are exact, so an approx evaluator is best fitted
+   with the gradients of the exact one.
+
+    Each particle accounts for its own residual only, which makes the sums
+   correct with half and full neighbor lists and with domain decomposition.
+   Results are reduced over the ranks when read.
+
+    \tparam evaluator Pair evaluator providing evalParamDerivatives()
+*/
+template<class evaluator> class PairParameterGradient
+    {
+    public:
+    typedef typename evaluator::param_type param_type;
+
+    //! Construct the gradient accumulator
+    /*! \param sysdef System definition
+        \param nlist Neighbor list of the pair force
+        \param force Pair force that computes the model forces
+        \param mode Energy shift mode of the pair force
+    */
+    PairParameterGradient(std::shared_ptr<SystemDefinition> sysdef,
+                          std::shared_ptr<NeighborList> nlist,
+                          std::shared_ptr<ForceCompute> force,
+                          const std::string& mode)
+        : m_sysdef(sysdef), m_pdata(sysdef->getParticleData()),
+          m_exec_conf(m_pdata->getExecConf()), m_nlist(nlist), m_force(force),
+          m_typpair_idx(m_pdata->getNTypes())
+        {
+        if (mode != "none" && mode != "shift")
+            {
+            throw std::runtime_error("Parameter gradients support the none and shift modes.");
+            }
+        m_energy_shift = mode == "shift";
+
+        const unsigned int n_pairs = m_typpair_idx.getNumElements();
+        m_params.resize(n_pairs);
+        m_rcutsq.assign(n_pairs, Scalar(0.0));
+        reset();
+        }
+
+    //! Set the parameters of a type pair
+    void setParams(unsigned int typ1, unsigned int typ2, pybind11::dict params)
+        {
+        validateTypes(typ1, typ2);
+        m_params[m_typpair_idx(typ1, typ2)] = param_type(params, false);
+        m_params[m_typpair_idx(typ2, typ1)] = m_params[m_typpair_idx(typ1, typ2)];
+        }
+
+    //! Set the cutoff radius of a type pair
+    void setRCut(unsigned int typ1, unsigned int typ2, Scalar r_cut)
+        {
+        validateTypes(typ1, typ2);
+        m_rcutsq[m_typpair_idx(typ1, typ2)] = r_cut * r_cut;
+        m_rcutsq[m_typpair_idx(typ2, typ1)] = r_cut * r_cut;
+        }
+
+    //! Add the current frame
+    void accumulate(pybind11::array_t<double, pybind11::array::c_style | pybind11::array::forcecast>
+                        reference_forces);
+
+    //! Forget all frames
+    void reset()
+        {
+        m_force_gradient.assign(size_t(m_typpair_idx.getNumElements()) * evaluator::num_params,
+                                0.0);
+        m_energy_gradient.assign(m_force_gradient.size(), 0.0);
+        m_loss = 0.0;
+        m_n_frames = 0;
+        }
+
+    //! Get dL/dp as an (n_types, n_types, n_params) array
+    pybind11::array_t<double> getForceGradient()
+        {
+        return getSymmetrized(m_force_gradient);
+        }
+
+    //! Get dU/dp as an (n_types, n_types, n_params) array
+    pybind11::array_t<double> getEnergyGradient()
+        {
+        return getSymmetrized(m_energy_gradient);
+        }
+
+    //! Get the force matching loss
+    double getLoss()
+        {
+        double loss = m_loss;
+#ifdef ENABLE_MPI
+        if (m_sysdef->isDomainDecomposed())
+            {
+            MPI_Allreduce(MPI_IN_PLACE,
+                          &loss,
+                          1,
+                          MPI_DOUBLE,
+                          MPI_SUM,
+                          m_exec_conf->getMPICommunicator());
+            }
+#endif
+        return loss;
+        }
+
+    uint64_t getNumFrames()
+        {
+        return m_n_frames;
+        }
+
+    static std::vector<std::string> getParamNames()
+        {
+        return evaluator::getParamNames();
+        }
+
+    protected:
+    std::shared_ptr<SystemDefinition> m_sysdef;               //!< System definition
+    std::shared_ptr<ParticleData> m_pdata;                    //!< Particle data
+    std::shared_ptr<const ExecutionConfiguration> m_exec_conf; //!< Execution configuration
+    std::shared_ptr<NeighborList> m_nlist;                    //!< Neighbor list of the pair force
+    std::shared_ptr<ForceCompute> m_force;                    //!< Pair force
+    Index2D m_typpair_idx;                                    //!< Indexes type pairs
+    std::vector<param_type> m_params;                         //!< Parameters per type pair
+    std::vector<Scalar> m_rcutsq;                             //!< Squared cutoff per type pair
+    bool m_energy_shift = false;                              //!< Shift the energy at the cutoff
+
+    std::vector<double> m_force_gradient;  //!< dL/dp per ordered type pair
+    std::vector<double> m_energy_gradient; //!< dU/dp per ordered type pair
+    double m_loss = 0.0;                   //!< Force matching loss
+    uint64_t m_n_frames = 0;               //!< Number of frames so far
+
+    void validateTypes(unsigned int typ1, unsigned int typ2)
+        {
+        if (typ1 >= m_pdata->getNTypes() || typ2 >= m_pdata->getNTypes())
+            {
+            throw std::runtime_error("Invalid type index.");
+            }
+        }
+
+    //! Reduce over the ranks and sum (a, b) and (b, a) of a per type pair array
+    pybind11::array_t<double> getSymmetrized(const std::vector<double>& values)
+        {
+        std::vector<double> sum(values);
+#ifdef ENABLE_MPI
+        if (m_sysdef->isDomainDecomposed())
+            {
+            MPI_Allreduce(MPI_IN_PLACE,
+                          sum.data(),
+                          (int)sum.size(),
+                          MPI_DOUBLE,
+                          MPI_SUM,
+                          m_exec_conf->getMPICommunicator());
+            }
+#endif
+        const unsigned int n_types = m_pdata->getNTypes();
+        const unsigned int n_params = evaluator::num_params;
+        std::vector<double> result(sum.size());
+        for (unsigned int a = 0; a < n_types; a++)
+            {
+            for (unsigned int b = 0; b < n_types; b++)
+                {
+                const size_t ab = size_t(m_typpair_idx(a, b)) * n_params;
+                const size_t ba = size_t(m_typpair_idx(b, a)) * n_params;
+                for (unsigned int k = 0; k < n_params; k++)
+                    result[size_t(a * n_types + b) * n_params + k]
+                        = a == b ? sum[ab + k] : sum[ab + k] + sum[ba + k];
+                }
+            }
+        return pybind11::array_t<double>({size_t(n_types), size_t(n_types), size_t(n_params)},
+                                         result.data());
+        }
+    };
+
+/*! \param reference_forces Reference forces of this pair potential, an
+   (N_global, 3) array indexed by tag, given on every rank
+*/
+template<class evaluator>
+void PairParameterGradient<evaluator>::accumulate(
+    pybind11::array_t<double, pybind11::array::c_style | pybind11::array::forcecast>
+        reference_forces)
+    {
+    if (reference_forces.ndim() != 2 || reference_forces.shape(0) != m_pdata->getNGlobal()
+        || reference_forces.shape(1) != 3)
+        {
+        throw std::runtime_error("reference_forces must have the shape (N_particles, 3).");
+        }
+    const double* h_ref = reference_forces.data();
+
+    bool third_law = m_nlist->getStorageMode() == NeighborList::half;
+
+    ArrayHandle<unsigned int> h_n_neigh(m_nlist->getNNeighArray(),
+                                        access_location::host,
+                                        access_mode::read);
+    ArrayHandle<unsigned int> h_nlist(m_nlist->getNListArray(),
+                                      access_location::host,
+                                      access_mode::read);
+    ArrayHandle<size_t> h_head_list(m_nlist->getHeadList(),
+                                    access_location::host,
+                                    access_mode::read);
+    ArrayHandle<Scalar4> h_pos(m_pdata->getPositions(), access_location::host, access_mode::read);
+    ArrayHandle<unsigned int> h_tag(m_pdata->getTags(), access_location::host, access_mode::read);
+    ArrayHandle<Scalar4> h_force(m_force->getForceArray(),
+                                 access_location::host,
+                                 access_mode::read);
+
+    const unsigned int N = m_pdata->getN();
+    const unsigned int n_params = evaluator::num_params;
+
+    // residuals of the local particles
+    std::vector<Scalar3> residual(N);
+    for (unsigned int i = 0; i < N; i++)
+        {
+        const double* ref = h_ref + size_t(h_tag.data[i]) * 3;
+        residual[i] = make_scalar3(h_force.data[i].x - ref[0],
+                                   h_force.data[i].y - ref[1],
+                                   h_force.data[i].z - ref[2]);
+        m_loss += dot(residual[i], residual[i]);
+        }
+
+    const BoxDim box = m_pdata->getGlobalBox();
+    Scalar dforce_divr[n_params];
+    Scalar dpair_eng[n_params];
+
+    for (unsigned int i = 0; i < N; i++)
+        {
+        Scalar3 pi = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z);
+        unsigned int typei = __scalar_as_int(h_pos.data[i].w);
+
+        const size_t myHead = h_head_list.data[i];
+        const unsigned int size = (unsigned int)h_n_neigh.data[i];
+        for (unsigned int k = 0; k < size; k++)
+            {
+            unsigned int j = h_nlist.data[myHead + k];
+            Scalar3 pj = make_scalar3(h_pos.data[j].x, h_pos.data[j].y, h_pos.data[j].z);
+            Scalar3 dx = box.minImage(pi - pj);
+            unsigned int typej = __scalar_as_int(h_pos.data[j].w);
+
+            unsigned int typpair_idx = m_typpair_idx(typei, typej);
+            evaluator eval(dot(dx, dx), m_rcutsq[typpair_idx], m_params[typpair_idx]);
+            if (!eval.evalParamDerivatives(dforce_divr, dpair_eng, m_energy_shift))
+                continue;
+
+            // dF_i/dp = dx d(F/r)/dp and dF_j/dp = -dx d(F/r)/dp
+            const bool update_j = third_law && j < N;
+            Scalar projection = Scalar(2.0) * dot(residual[i], dx);
+            if (update_j)
+                projection -= Scalar(2.0) * dot(residual[j], dx);
+            const Scalar energy_weight = update_j ? Scalar(1.0) : Scalar(0.5);
+
+            double* force_gradient = m_force_gradient.data() + size_t(typpair_idx) * n_params;
+            double* energy_gradient = m_energy_gradient.data() + size_t(typpair_idx) * n_params;
+            for (unsigned int p = 0; p < n_params; p++)
+                {
+                force_gradient[p] += projection * dforce_divr[p];
+                energy_gradient[p] += energy_weight * dpair_eng[p];
+                }
+            }
+        }
+
+    m_n_frames++;
+    }
+
+namespace detail
+    {
+//! Export a PairParameterGradient to python
+/*! \param name Name of the class in the exported python module
+    \tparam T Evaluator type to export.
+*/
+template<class T> void export_PairParameterGradient(pybind11::module& m, const std::string& name)
+    {
+    typedef PairParameterGradient<T> gradient_t;
+    pybind11::class_<gradient_t, std::shared_ptr<gradient_t>>(m, name.c_str())
+        .def(pybind11::init<std::shared_ptr<SystemDefinition>,
+                            std::shared_ptr<NeighborList>,
+                            std::shared_ptr<ForceCompute>,
+                            const std::string&>())
+        .def("setParams", &gradient_t::setParams)
+        .def("setRCut", &gradient_t::setRCut)
+        .def("accumulate", &gradient_t::accumulate)
+        .def("reset", &gradient_t::reset)
+        .def_property_readonly("force_gradient", &gradient_t::getForceGradient)
+        .def_property_readonly("energy_gradient", &gradient_t::getEnergyGradient)
+        .def_property_readonly("loss", &gradient_t::getLoss)
+        .def_property_readonly("num_frames", &gradient_t::getNumFrames)
+        .def_property_readonly("param_names",
+                               [](gradient_t&) { return gradient_t::getParamNames(); });
+    }
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __PAIR_PARAMETER_GRADIENT_H__
@@ -0,0 +1,32 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+#include "EvaluatorPairThermoDPD.h"
+#include "hoomd/md/PotentialPairDPDThermoGPU.cuh"
+
+namespace hoomd
+    {
+namespace md
+    {
+namespace kernel
+    {
+template __attribute__((visibility("default"))) hipError_t
+gpu_compute_dpd_forces<EvaluatorPairMLJDPD>(const dpd_pair_args_t& args,
+                                            const EvaluatorPairMLJDPD::param_type* d_params);
+
+template __attribute__((visibility("default"))) hipError_t
+gpu_compute_dpd_forces<EvaluatorPairWLJDPD>(const dpd_pair_args_t& args,
+                                            const EvaluatorPairWLJDPD::param_type* d_params);
+
+template __attribute__((visibility("default"))) hipError_t
+gpu_compute_dpd_forces<EvaluatorPairMLJApproxDPD>(
+    const dpd_pair_args_t& args,
+    const EvaluatorPairMLJApproxDPD::param_type* d_params);
+
+template __attribute__((visibility("default"))) hipError_t
+gpu_compute_dpd_forces<EvaluatorPairWLJApproxDPD>(
+    const dpd_pair_args_t& args,
+    const EvaluatorPairWLJApproxDPD::param_type* d_params);
+    } // end namespace kernel
+    } // end namespace md
+    } // end namespace hoomd
@@ -36,6 +36,19 @@ gpu_compute_pair_forces<EvaluatorPairHertzian>(const pair_args_t& pair_args,
 template __attribute__((visibility("default"))) hipError_t
 gpu_compute_pair_forces<EvaluatorPairDipoleDipole>(const pair_args_t& pair_args,
                                                const EvaluatorPairDipoleDipole::param_type* d_params);
+
+template __attribute__((visibility("default"))) hipError_t
+gpu_compute_pair_forces<EvaluatorPairMLJApprox>(const pair_args_t& pair_args,
+                                                const EvaluatorPairMLJApprox::param_type* d_params);
+
+template __attribute__((visibility("default"))) hipError_t
+gpu_compute_pair_forces<EvaluatorPairWLJApprox>(const pair_args_t& pair_args,
+                                                const EvaluatorPairWLJApprox::param_type* d_params);
+
+template __attribute__((visibility("default"))) hipError_t
+gpu_compute_pair_forces<EvaluatorPairHertzianApprox>(
+    const pair_args_t& pair_args,
+    const EvaluatorPairHertzianApprox::param_type* d_params);
     } // end namespace kernel
     } // end namespace md
     } // end namespace hoomd
@@ -0,0 +1,439 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __POTENTIAL_PAIR_PROFILE_H__
+#define __POTENTIAL_PAIR_PROFILE_H__
+
+#include <memory>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <string.h>
+#include <vector>
+
+#include "hoomd/md/PotentialPair.h"
+
+#include "CpuDispatch.h"
+#include "StressProfile.h"
+
+/*! \file PotentialPairProfile.h
+    \brief Defines PotentialPair with an Irving-Kirkwood stress profile and a
+   type pair decomposition of the energy and virial
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! PotentialPair that samples a slab binned stress profile
+/*! On the steps where the profile is sampled, computeForces() runs its own
+   neighbor list loop, which computes the forces, energies and virials like
+   PotentialPair and spreads every pair virial over the slabs of the
+   StressProfile in the same pass. All other steps are left to PotentialPair.
+
+    The same loop optionally splits the pair energy and scalar virial by the
+   types of the two particles, every \a m_type_pair_period steps. The matrix
+   is accumulated in loop local sums and replaces the previous one at the end
+   of the pass; ranks are summed when it is read.
+
+    The loop supports the none, shift and xplor modes. It does not add a tail
+   correction, which is zero for the evaluators this class is used with.
+
+    Both loops, this one and the one of PotentialPair, run in the version
+   selected by detail::selectCpuIsa().
+
+    \tparam evaluator Pair evaluator
+*/
+template<class evaluator> class PotentialPairProfile : public PotentialPair<evaluator>
+    {
+    public:
+    //! Construct the pair potential
+    PotentialPairProfile(std::shared_ptr<SystemDefinition> sysdef,
+                         std::shared_ptr<NeighborList> nlist)
+        : PotentialPair<evaluator>(sysdef, nlist)
+        {
+        }
+
+    //! Set the number of slabs of the stress profile, 0 disables it
+    void setProfileBins(unsigned int n_bins)
+        {
+        m_stress_profile.configure(m_stress_profile.getAxis(), n_bins);
+        }
+
+    unsigned int getProfileBins()
+        {
+        return m_stress_profile.getNumBins();
+        }
+
+    //! Set the axis normal to the slabs of the stress profile
+    void setProfileAxis(const std::string& axis)
+        {
+        m_stress_profile.configure(StressProfile::axisFromName(axis),
+                                   m_stress_profile.getNumBins());
+        }
+
+    std::string getProfileAxis()
+        {
+        return StressProfile::axisName(m_stress_profile.getAxis());
+        }
+
+    //! Set the number of time steps between stress profile samples
+    void setProfilePeriod(uint64_t period)
+        {
+        m_stress_profile.setPeriod(period);
+        }
+
+    uint64_t getProfilePeriod()
+        {
+        return m_stress_profile.getPeriod();
+        }
+
+    //! Get the mean stress profile over all samples
+    pybind11::array_t<double> getStressProfile()
+        {
+        return m_stress_profile.get(this->m_exec_conf, this->m_sysdef->isDomainDecomposed());
+        }
+
+    uint64_t getStressProfileSamples()
+        {
+        return m_stress_profile.getNumSamples();
+        }
+
+    void resetStressProfile()
+        {
+        m_stress_profile.reset();
+        }
+
+    //! Set the number of time steps between type pair samples, 0 disables them
+    void setTypePairPeriod(uint64_t period)
+        {
+        m_type_pair_period = period;
+        }
+
+    uint64_t getTypePairPeriod()
+        {
+        return m_type_pair_period;
+        }
+
+    //! Get the pair energy of each type pair at the last sample
+    pybind11::array_t<double> getTypePairEnergies()
+        {
+        return reduceTypePairMatrix(m_type_pair_energy);
+        }
+
+    //! Get the scalar pair virial of each type pair at the last sample
+    pybind11::array_t<double> getTypePairVirials()
+        {
+        return reduceTypePairMatrix(m_type_pair_virial);
+        }
+
+    protected:
+    StressProfile m_stress_profile; //!< Irving-Kirkwood stress profile
+
+    uint64_t m_type_pair_period = 0;         //!< Steps between type pair samples
+    std::vector<double> m_type_pair_energy;  //!< Energy per (type i, type j), row major
+    std::vector<double> m_type_pair_virial;  //!< Virial trace per (type i, type j), row major
+
+    bool isTypePairStep(uint64_t timestep) const
+        {
+        return m_type_pair_period > 0 && timestep % m_type_pair_period == 0;
+        }
+
+    //! Sum a type pair matrix over ranks and shape it (n_types, n_types)
+    pybind11::array_t<double> reduceTypePairMatrix(const std::vector<double>& matrix);
+
+    //! Compute the forces, sampling the stress profile when requested
+    virtual void computeForces(uint64_t timestep);
+
+    //! Body of computeForces() for the instruction set of the build
+    void computeForcesHost(uint64_t timestep);
+
+#ifdef PAIR_PLUGIN_MULTIVERSION
+    //! computeForcesHost() compiled for AVX2
+    PAIR_PLUGIN_TARGET_AVX2 void computeForcesAVX2(uint64_t timestep)
+        {
+        computeForcesHost(timestep);
+        }
+
+    //! computeForcesHost() compiled for AVX-512
+    PAIR_PLUGIN_TARGET_AVX512 void computeForcesAVX512(uint64_t timestep)
+        {
+        computeForcesHost(timestep);
+        }
+#endif
+    };
+
+/*! \param timestep specifies the current time step of the simulation
+ */
+template<class evaluator> void PotentialPairProfile<evaluator>::computeForces(uint64_t timestep)
+    {
+#ifdef PAIR_PLUGIN_MULTIVERSION
+    switch (detail::cpuIsa())
+        {
+    case detail::CpuIsa::avx512:
+        computeForcesAVX512(timestep);
+        return;
+    case detail::CpuIsa::avx2:
+        computeForcesAVX2(timestep);
+        return;
+    default:
+        break;
+        }
+#endif
+    computeForcesHost(timestep);
+    }
+
+/*! \param timestep specifies the current time step of the simulation
+ */
+template<class evaluator> void PotentialPairProfile<evaluator>::computeForcesHost(uint64_t timestep)
+    {
+    const bool sample_profile = m_stress_profile.isSampleStep(timestep);
+    const bool sample_type_pairs = isTypePairStep(timestep);
+    if (!sample_profile && !sample_type_pairs)
+        {
+        PotentialPair<evaluator>::computeForces(timestep);
+        return;
+        }
+
+    // start by updating the neighborlist
+    this->m_nlist->compute(timestep);
+
+    // depending on the neighborlist settings, we can take advantage of
+    // newton's third law to reduce computations
+    bool third_law = this->m_nlist->getStorageMode() == NeighborList::half;
+
+    ArrayHandle<unsigned int> h_n_neigh(this->m_nlist->getNNeighArray(),
+                                        access_location::host,
+                                        access_mode::read);
+    ArrayHandle<unsigned int> h_nlist(this->m_nlist->getNListArray(),
+                                      access_location::host,
+                                      access_mode::read);
+    ArrayHandle<size_t> h_head_list(this->m_nlist->getHeadList(),
+                                    access_location::host,
+                                    access_mode::read);
+
+    ArrayHandle<Scalar4> h_pos(this->m_pdata->getPositions(),
+                               access_location::host,
+                               access_mode::read);
+    ArrayHandle<Scalar> h_charge(this->m_pdata->getCharges(),
+                                 access_location::host,
+                                 access_mode::read);
+
+    ArrayHandle<Scalar4> h_force(this->m_force, access_location::host, access_mode::overwrite);
+    ArrayHandle<Scalar> h_virial(this->m_virial, access_location::host, access_mode::overwrite);
+    const size_t virial_pitch = this->m_virial.getPitch();
+
+    memset((void*)h_force.data, 0, sizeof(Scalar4) * this->m_force.getNumElements());
+    memset((void*)h_virial.data, 0, sizeof(Scalar) * this->m_virial.getNumElements());
+
+    const BoxDim box = this->m_pdata->getGlobalBox();
+    ArrayHandle<Scalar> h_ronsq(this->m_ronsq, access_location::host, access_mode::read);
+    ArrayHandle<Scalar> h_rcutsq(this->m_rcutsq, access_location::host, access_mode::read);
+
+    PDataFlags flags = this->m_pdata->getFlags();
+    bool compute_virial = flags[pdata_flag::pressure_tensor];
+
+    if (sample_profile)
+        m_stress_profile.beginSample(box, this->m_sysdef->getNDimensions() == 2);
+
+    // a pair adds half of its energy and virial to (typei, typej) and half to
+    // (typej, typei), so the matrix is symmetric and sums to the totals
+    const unsigned int n_types = this->m_pdata->getNTypes();
+    std::vector<double> type_pair_energy(sample_type_pairs ? n_types * n_types : 0, 0.0);
+    std::vector<double> type_pair_virial(sample_type_pairs ? n_types * n_types : 0, 0.0);
+
+    const unsigned int N = this->m_pdata->getN();
+    for (unsigned int i = 0; i < N; i++)
+        {
+        Scalar3 pi = make_scalar3(h_pos.data[i].x, h_pos.data[i].y, h_pos.data[i].z);
+        unsigned int typei = __scalar_as_int(h_pos.data[i].w);
+        Scalar qi = Scalar(0.0);
+        if (evaluator::needsCharge())
+            qi = h_charge.data[i];
+
+        Scalar3 fi = make_scalar3(0, 0, 0);
+        Scalar pei = 0.0;
+        Scalar virialxxi = 0.0;
+        Scalar virialxyi = 0.0;
+        Scalar virialxzi = 0.0;
+        Scalar virialyyi = 0.0;
+        Scalar virialyzi = 0.0;
+        Scalar virialzzi = 0.0;
+
+        const size_t myHead = h_head_list.data[i];
+        const unsigned int size = (unsigned int)h_n_neigh.data[i];
+        for (unsigned int k = 0; k < size; k++)
+            {
+            unsigned int j = h_nlist.data[myHead + k];
+            assert(j < N + this->m_pdata->getNGhosts());
+
+            Scalar3 pj = make_scalar3(h_pos.data[j].x, h_pos.data[j].y, h_pos.data[j].z);
+            Scalar3 dx = box.minImage(pi - pj);
+            unsigned int typej = __scalar_as_int(h_pos.data[j].w);
+            Scalar qj = Scalar(0.0);
+            if (evaluator::needsCharge())
+                qj = h_charge.data[j];
+
+            Scalar rsq = dot(dx, dx);
+            unsigned int typpair_idx = this->m_typpair_idx(typei, typej);
+            Scalar rcutsq = h_rcutsq.data[typpair_idx];
+            Scalar ronsq = h_ronsq.data[typpair_idx];
+
+            // xplor without a smoothing range falls back to shifting
+            bool energy_shift = this->m_shift_mode == PotentialPair<evaluator>::shift
+                                || (this->m_shift_mode == PotentialPair<evaluator>::xplor
+                                    && ronsq > rcutsq);
+
+            Scalar force_divr = Scalar(0.0);
+            Scalar pair_eng = Scalar(0.0);
+            evaluator eval(rsq, rcutsq, this->m_params[typpair_idx]);
+            if (evaluator::needsCharge())
+                eval.setCharge(qi, qj);
+            if (!eval.evalForceAndEnergy(force_divr, pair_eng, energy_shift))
+                continue;
+
+            if (this->m_shift_mode == PotentialPair<evaluator>::xplor && rsq >= ronsq
+                && rsq < rcutsq)
+                {
+                Scalar old_pair_eng = pair_eng;
+                Scalar old_force_divr = force_divr;
+                Scalar rsq_minus_r_cut_sq = rsq - rcutsq;
+                Scalar denom = (rcutsq - ronsq) * (rcutsq - ronsq) * (rcutsq - ronsq);
+                Scalar s = rsq_minus_r_cut_sq * rsq_minus_r_cut_sq
+                           * (rcutsq + Scalar(2.0) * rsq - Scalar(3.0) * ronsq) / denom;
+                Scalar ds_dr_divr = Scalar(12.0) * (rsq - ronsq) * rsq_minus_r_cut_sq / denom;
+                pair_eng = old_pair_eng * s;
+                force_divr = s * old_force_divr - ds_dr_divr * old_pair_eng;
+                }
+
+            Scalar force_div2r = force_divr * Scalar(0.5);
+            fi += dx * force_divr;
+            pei += pair_eng * Scalar(0.5);
+            if (compute_virial)
+                {
+                virialxxi += force_div2r * dx.x * dx.x;
+                virialxyi += force_div2r * dx.x * dx.y;
+                virialxzi += force_div2r * dx.x * dx.z;
+                virialyyi += force_div2r * dx.y * dx.y;
+                virialyzi += force_div2r * dx.y * dx.z;
+                virialzzi += force_div2r * dx.z * dx.z;
+                }
+
+            // a pair seen from both sides counts half each time
+            const bool update_j = third_law && j < N;
+            const Scalar weight = update_j ? Scalar(1.0) : Scalar(0.5);
+            if (sample_profile)
+                m_stress_profile.addPair(pi, dx, dx * force_divr, weight);
+
+            if (sample_type_pairs)
+                {
+                const double energy_half = 0.5 * weight * pair_eng;
+                const double virial_half = 0.5 * weight * force_divr * rsq;
+                type_pair_energy[typei * n_types + typej] += energy_half;
+                type_pair_energy[typej * n_types + typei] += energy_half;
+                type_pair_virial[typei * n_types + typej] += virial_half;
+                type_pair_virial[typej * n_types + typei] += virial_half;
+                }
+
+            if (update_j)
+                {
+                h_force.data[j].x -= dx.x * force_divr;
+                h_force.data[j].y -= dx.y * force_divr;
+                h_force.data[j].z -= dx.z * force_divr;
+                h_force.data[j].w += pair_eng * Scalar(0.5);
+                if (compute_virial)
+                    {
+                    h_virial.data[0 * virial_pitch + j] += force_div2r * dx.x * dx.x;
+                    h_virial.data[1 * virial_pitch + j] += force_div2r * dx.x * dx.y;
+                    h_virial.data[2 * virial_pitch + j] += force_div2r * dx.x * dx.z;
+                    h_virial.data[3 * virial_pitch + j] += force_div2r * dx.y * dx.y;
+                    h_virial.data[4 * virial_pitch + j] += force_div2r * dx.y * dx.z;
+                    h_virial.data[5 * virial_pitch + j] += force_div2r * dx.z * dx.z;
+                    }
+                }
+            }
+
+        h_force.data[i].x += fi.x;
+        h_force.data[i].y += fi.y;
+        h_force.data[i].z += fi.z;
+        h_force.data[i].w += pei;
+        if (compute_virial)
+            {
+            h_virial.data[0 * virial_pitch + i] += virialxxi;
+            h_virial.data[1 * virial_pitch + i] += virialxyi;
+            h_virial.data[2 * virial_pitch + i] += virialxzi;
+            h_virial.data[3 * virial_pitch + i] += virialyyi;
+            h_virial.data[4 * virial_pitch + i] += virialyzi;
+            h_virial.data[5 * virial_pitch + i] += virialzzi;
+            }
+        }
+
+    if (sample_profile)
+        m_stress_profile.endSample();
+
+    if (sample_type_pairs)
+        {
+        m_type_pair_energy.swap(type_pair_energy);
+        m_type_pair_virial.swap(type_pair_virial);
+        }
+    }
+
+/*! \param matrix Local type pair matrix, empty before the first sample
+ */
+template<class evaluator>
+pybind11::array_t<double>
+PotentialPairProfile<evaluator>::reduceTypePairMatrix(const std::vector<double>& matrix)
+    {
+    const size_t n_types = this->m_pdata->getNTypes();
+    std::vector<double> result(n_types * n_types, 0.0);
+    if (matrix.size() == result.size())
+        result = matrix;
+
+#ifdef ENABLE_MPI
+    if (this->m_sysdef->isDomainDecomposed())
+        {
+        MPI_Allreduce(MPI_IN_PLACE,
+                      result.data(),
+                      (int)result.size(),
+                      MPI_DOUBLE,
+                      MPI_SUM,
+                      this->m_exec_conf->getMPICommunicator());
+        }
+#endif
+
+    return pybind11::array_t<double>({n_types, n_types}, result.data());
+    }
+
+namespace detail
+    {
+//! Export a PotentialPairProfile to python
+/*! \param name Name of the class in the exported python module
+    \tparam T Evaluator type to export.
+*/
+template<class T> void export_PotentialPairProfile(pybind11::module& m, const std::string& name)
+    {
+    typedef PotentialPairProfile<T> pair_t;
+    pybind11::class_<pair_t, PotentialPair<T>, std::shared_ptr<pair_t>>(m, name.c_str())
+        .def(pybind11::init<std::shared_ptr<SystemDefinition>, std::shared_ptr<NeighborList>>())
+        .def_property("profile_bins", &pair_t::getProfileBins, &pair_t::setProfileBins)
+        .def_property("profile_axis", &pair_t::getProfileAxis, &pair_t::setProfileAxis)
+        .def_property("profile_period", &pair_t::getProfilePeriod, &pair_t::setProfilePeriod)
+        .def("getStressProfile", &pair_t::getStressProfile)
+        .def_property_readonly("stress_profile_samples", &pair_t::getStressProfileSamples)
+        .def("resetStressProfile", &pair_t::resetStressProfile)
+        .def_property("type_pair_period", &pair_t::getTypePairPeriod, &pair_t::setTypePairPeriod)
+        .def("getTypePairEnergies", &pair_t::getTypePairEnergies)
+        .def("getTypePairVirials", &pair_t::getTypePairVirials);
+    }
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __POTENTIAL_PAIR_PROFILE_H__
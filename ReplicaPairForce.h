@@ -0,0 +1,428 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __REPLICA_PAIR_FORCE_H__
+#define __REPLICA_PAIR_FORCE_H__
+
+#include <algorithm>
+#include <cmath>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hoomd/BoxDim.h"
+#include "hoomd/HOOMDMath.h"
+#include "hoomd/Index1D.h"
+
+/*! \file ReplicaPairForce.h
+    \brief Defines the ReplicaPairForce class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! State of a FIRE minimization (Bitzek et al. 2006)
+/*! Uses the constants of hoomd.md.minimize.FIRE. Every step, the caller sums
+   |F|^2, |v|^2 and F.v over all degrees of freedom, calls mix() and sets
+   v = c_v v + c_f F before taking a step of length dt.
+*/
+struct FireState
+    {
+    Scalar dt;                         //!< Current time step
+    Scalar dt_max;                     //!< Largest time step
+    Scalar alpha = Scalar(0.1);        //!< Current mixing factor
+    unsigned int n_since_negative = 0; //!< Steps since the power was last negative
+
+    explicit FireState(Scalar dt_start) : dt(dt_start), dt_max(Scalar(10.0) * dt_start) { }
+
+    //! Update the state and get the velocity mixing coefficients
+    void mix(double fsq, double vsq, double power, Scalar& c_v, Scalar& c_f)
+        {
+        const Scalar alpha_start = Scalar(0.1);
+        if (power > 0.0)
+            {
+            c_v = Scalar(1.0) - alpha;
+            c_f = fsq > 0.0 ? alpha * Scalar(std::sqrt(vsq / fsq)) : Scalar(0.0);
+            if (++n_since_negative > 5)
+                {
+                dt = std::min(dt * Scalar(1.1), dt_max);
+                alpha *= Scalar(0.99);
+                }
+            }
+        else
+            {
+            // going uphill: stop
+            c_v = Scalar(0.0);
+            c_f = Scalar(0.0);
+            dt *= Scalar(0.5);
+            alpha = alpha_start;
+            n_since_negative = 0;
+            }
+        }
+    };
+
+//! Pair forces of configurations held outside of HOOMD's particle data
+/*! Base of the drivers that work on many replicas of a system at once
+   (BatchQuench, NudgedElasticBand, TrajectoryEvaluator). A Configuration holds the positions,
+   images, types and box of one replica; buildVerletList() finds its pairs
+   with a cell list and computeForces() evaluates them with \a evaluator.
+   None of these touch shared state, so replicas may be evaluated from
+   several threads.
+
+    Parameters and cutoffs are set from python, as they are for the pair
+   potential. The none and shift modes are supported.
+
+    \tparam evaluator Pair evaluator
+*/
+template<class evaluator> class ReplicaPairForce
+    {
+    public:
+    typedef typename evaluator::param_type param_type;
+    typedef pybind11::array_t<double, pybind11::array::c_style | pybind11::array::forcecast>
+        double_array;
+    typedef pybind11::array_t<unsigned int, pybind11::array::c_style | pybind11::array::forcecast>
+        uint_array;
+
+    //! Construct the replica force
+    /*! \param n_types Number of particle types
+        \param mode Energy shift mode of the pair potential
+    */
+    ReplicaPairForce(unsigned int n_types, const std::string& mode) : m_typpair_idx(n_types)
+        {
+        if (mode != "none" && mode != "shift")
+            {
+            throw std::runtime_error("Replica forces support the none and shift modes.");
+            }
+        m_energy_shift = mode == "shift";
+
+        const unsigned int n_pairs = m_typpair_idx.getNumElements();
+        m_params.resize(n_pairs);
+        m_rcutsq.assign(n_pairs, Scalar(0.0));
+        }
+
+    //! Set the parameters of a type pair
+    void setParams(unsigned int typ1, unsigned int typ2, pybind11::dict params)
+        {
+        validateTypes(typ1, typ2);
+        m_params[m_typpair_idx(typ1, typ2)] = param_type(params, false);
+        m_params[m_typpair_idx(typ2, typ1)] = m_params[m_typpair_idx(typ1, typ2)];
+        }
+
+    //! Set the cutoff radius of a type pair
+    void setRCut(unsigned int typ1, unsigned int typ2, Scalar r_cut)
+        {
+        validateTypes(typ1, typ2);
+        m_rcutsq[m_typpair_idx(typ1, typ2)] = r_cut * r_cut;
+        m_rcutsq[m_typpair_idx(typ2, typ1)] = r_cut * r_cut;
+        }
+
+    Scalar m_buffer = Scalar(0.3);  //!< Buffer of the Verlet lists
+    unsigned int m_num_threads = 1; //!< Number of threads
+
+    protected:
+    //! One replica of the system
+    struct Configuration
+        {
+        std::vector<Scalar3> pos;       //!< Positions
+        std::vector<int3> image;        //!< Image shifts from wrapping
+        std::vector<unsigned int> type; //!< Type ids
+        BoxDim box;                     //!< Simulation box
+        unsigned int dimensions = 3;    //!< Number of dimensions
+        };
+
+    //! Verlet list of one or more replicas
+    struct VerletList
+        {
+        std::vector<unsigned int> head;  //!< First entry of each particle
+        std::vector<unsigned int> nlist; //!< Neighbors j > i of each particle
+        std::vector<Scalar3> ref_pos;    //!< Positions at the last build
+        };
+
+    Index2D m_typpair_idx;            //!< Indexes type pairs
+    std::vector<param_type> m_params; //!< Parameters per type pair
+    std::vector<Scalar> m_rcutsq;     //!< Squared cutoff per type pair
+    bool m_energy_shift = false;      //!< Shift the energy at the cutoff
+
+    void validateTypes(unsigned int typ1, unsigned int typ2)
+        {
+        if (typ1 >= m_typpair_idx.getW() || typ2 >= m_typpair_idx.getW())
+            {
+            throw std::runtime_error("Invalid type index.");
+            }
+        }
+
+    //! Largest cutoff plus the buffer
+    Scalar getListRange() const
+        {
+        Scalar r_cut_max = Scalar(0.0);
+        for (Scalar rcutsq : m_rcutsq)
+            r_cut_max = std::max(r_cut_max, std::sqrt(rcutsq));
+        return r_cut_max + m_buffer;
+        }
+
+    //! Make a configuration from python arrays
+    void makeConfiguration(Configuration& c,
+                           double_array position,
+                           uint_array typeid_,
+                           double_array box,
+                           unsigned int dimensions) const;
+
+    //! Build the Verlet list of a configuration
+    void buildVerletList(const Configuration& c,
+                         Scalar r_list,
+                         VerletList& list,
+                         const std::vector<Scalar>* reach = nullptr) const;
+
+    //! Compute the forces of a configuration and return its energy
+    double computeForces(const Configuration& c,
+                         const std::vector<Scalar3>& pos,
+                         const VerletList& list,
+                         std::vector<Scalar3>& force,
+                         double* virial = nullptr,
+                         std::vector<Scalar>* particle_energy = nullptr) const;
+    };
+
+/*! \param c Configuration to fill
+    \param position (N, 3) positions
+    \param typeid_ (N,) type ids
+    \param box Box as [Lx, Ly, Lz, xy, xz, yz]
+    \param dimensions Number of dimensions, 2 or 3
+*/
+template<class evaluator>
+void ReplicaPairForce<evaluator>::makeConfiguration(Configuration& c,
+                                                    double_array position,
+                                                    uint_array typeid_,
+                                                    double_array box,
+                                                    unsigned int dimensions) const
+    {
+    if (position.ndim() != 2 || position.shape(1) != 3)
+        {
+        throw std::runtime_error("position must have the shape (N_particles, 3).");
+        }
+    const size_t N = position.shape(0);
+    if (typeid_.ndim() != 1 || size_t(typeid_.shape(0)) != N)
+        {
+        throw std::runtime_error("typeid must have the shape (N_particles,).");
+        }
+    if (box.size() != 6)
+        {
+        throw std::runtime_error("box must be [Lx, Ly, Lz, xy, xz, yz].");
+        }
+    if (dimensions != 2 && dimensions != 3)
+        {
+        throw std::runtime_error("dimensions must be 2 or 3.");
+        }
+
+    // 2D boxes may have Lz = 0, give them a unit thickness to wrap in
+    const double* b = box.data();
+    const bool two_d = dimensions == 2;
+    c.box = BoxDim(b[0], b[1], two_d ? 1.0 : b[2]);
+    c.box.setTiltFactors(b[3], two_d ? 0.0 : b[4], two_d ? 0.0 : b[5]);
+    c.dimensions = dimensions;
+
+    const double* p = position.data();
+    const unsigned int* t = typeid_.data();
+    c.pos.resize(N);
+    c.type.resize(N);
+    c.image.assign(N, make_int3(0, 0, 0));
+    for (size_t i = 0; i < N; i++)
+        {
+        if (t[i] >= m_typpair_idx.getW())
+            {
+            throw std::runtime_error("Invalid type index.");
+            }
+        c.type[i] = t[i];
+        c.pos[i] = make_scalar3(p[3 * i], p[3 * i + 1], two_d ? 0.0 : p[3 * i + 2]);
+        c.box.wrap(c.pos[i], c.image[i]);
+        }
+    }
+
+/*! Cells are laid out in fractional coordinates, at least as wide as the
+   longest pair distance normal to each face. A direction with fewer than
+   three cells is not split, so each pair is found once.
+
+    With \a reach, the list serves several replicas that stay close to \a c:
+   a pair is kept when its distance in \a c is below r_list + reach[i] +
+   reach[j], which covers every replica in which each particle is within
+   reach[i] of its position in \a c.
+
+    \param c Configuration
+    \param r_list Cutoff of the list
+    \param list Verlet list to fill
+    \param reach Optional per particle extension of the cutoff
+*/
+template<class evaluator>
+void ReplicaPairForce<evaluator>::buildVerletList(const Configuration& c,
+                                                  Scalar r_list,
+                                                  VerletList& list,
+                                                  const std::vector<Scalar>* reach) const
+    {
+    const unsigned int N = (unsigned int)c.pos.size();
+    Scalar max_reach = Scalar(0.0);
+    if (reach)
+        {
+        for (Scalar r : *reach)
+            max_reach = std::max(max_reach, r);
+        }
+    const Scalar cell_width = r_list + Scalar(2.0) * max_reach;
+
+    const Scalar3 widths = c.box.getNearestPlaneDistance();
+    unsigned int n_cells[3] = {(unsigned int)(widths.x / cell_width),
+                               (unsigned int)(widths.y / cell_width),
+                               c.dimensions == 2 ? 1u : (unsigned int)(widths.z / cell_width)};
+    for (auto& n : n_cells)
+        {
+        if (n < 3)
+            n = 1;
+        }
+    const Index3D cell_idx(n_cells[0], n_cells[1], n_cells[2]);
+
+    // linked cells
+    std::vector<int> cell_head(cell_idx.getNumElements(), -1);
+    std::vector<int> cell_next(N, -1);
+    std::vector<int3> cell_of(N);
+    for (unsigned int i = 0; i < N; i++)
+        {
+        const Scalar3 frac = c.box.makeFraction(c.pos[i]);
+        const Scalar fr[3] = {frac.x, frac.y, frac.z};
+        int ci[3];
+        for (unsigned int d = 0; d < 3; d++)
+            ci[d] = n_cells[d] > 1
+                        ? std::min(std::max(int(fr[d] * n_cells[d]), 0), int(n_cells[d]) - 1)
+                        : 0;
+        cell_of[i] = make_int3(ci[0], ci[1], ci[2]);
+        const unsigned int cell = cell_idx(ci[0], ci[1], ci[2]);
+        cell_next[i] = cell_head[cell];
+        cell_head[cell] = int(i);
+        }
+
+    const int span[3] = {n_cells[0] > 1 ? 1 : 0, n_cells[1] > 1 ? 1 : 0, n_cells[2] > 1 ? 1 : 0};
+    list.head.resize(N + 1);
+    list.nlist.clear();
+    list.ref_pos = c.pos;
+    for (unsigned int i = 0; i < N; i++)
+        {
+        list.head[i] = (unsigned int)list.nlist.size();
+        const int3 ci = cell_of[i];
+        for (int dz = -span[2]; dz <= span[2]; dz++)
+            for (int dy = -span[1]; dy <= span[1]; dy++)
+                for (int dx = -span[0]; dx <= span[0]; dx++)
+                    {
+                    const unsigned int cell = cell_idx((ci.x + dx + n_cells[0]) % n_cells[0],
+                                                       (ci.y + dy + n_cells[1]) % n_cells[1],
+                                                       (ci.z + dz + n_cells[2]) % n_cells[2]);
+                    for (int j = cell_head[cell]; j >= 0; j = cell_next[j])
+                        {
+                        if ((unsigned int)j <= i)
+                            continue;
+                        const Scalar3 d = c.box.minImage(c.pos[i] - c.pos[j]);
+                        Scalar r_max = r_list;
+                        if (reach)
+                            r_max += (*reach)[i] + (*reach)[j];
+                        if (dot(d, d) < r_max * r_max)
+                            list.nlist.push_back((unsigned int)j);
+                        }
+                    }
+        }
+    list.head[N] = (unsigned int)list.nlist.size();
+    }
+
+/*! \param c Configuration that provides the types and the box
+    \param pos Positions to evaluate, those of \a c or of a replica like it
+    \param list Verlet list that covers \a pos
+    \param force Forces to overwrite
+    \param virial Optional total virial to overwrite, [xx, xy, xz, yy, yz, zz]
+    \param particle_energy Optional energy of each particle to overwrite, half
+   of every pair energy goes to each partner
+    \returns Potential energy
+*/
+template<class evaluator>
+double ReplicaPairForce<evaluator>::computeForces(const Configuration& c,
+                                                  const std::vector<Scalar3>& pos,
+                                                  const VerletList& list,
+                                                  std::vector<Scalar3>& force,
+                                                  double* virial,
+                                                  std::vector<Scalar>* particle_energy) const
+    {
+    const unsigned int N = (unsigned int)pos.size();
+    force.resize(N);
+    std::fill(force.begin(), force.end(), make_scalar3(0.0, 0.0, 0.0));
+    double energy = 0.0;
+    if (virial)
+        std::fill(virial, virial + 6, 0.0);
+    if (particle_energy)
+        particle_energy->assign(N, Scalar(0.0));
+
+    for (unsigned int i = 0; i < N; i++)
+        {
+        Scalar3 fi = make_scalar3(0.0, 0.0, 0.0);
+        for (unsigned int k = list.head[i]; k < list.head[i + 1]; k++)
+            {
+            const unsigned int j = list.nlist[k];
+            const Scalar3 dx = c.box.minImage(pos[i] - pos[j]);
+            const Scalar rsq = dot(dx, dx);
+            const unsigned int typpair = m_typpair_idx(c.type[i], c.type[j]);
+
+            Scalar force_divr = Scalar(0.0);
+            Scalar pair_eng = Scalar(0.0);
+            evaluator eval(rsq, m_rcutsq[typpair], m_params[typpair]);
+            if (!eval.evalForceAndEnergy(force_divr, pair_eng, m_energy_shift))
+                continue;
+
+            fi += dx * force_divr;
+            force[j] -= dx * force_divr;
+            energy += pair_eng;
+            if (virial)
+                {
+                virial[0] += force_divr * dx.x * dx.x;
+                virial[1] += force_divr * dx.x * dx.y;
+                virial[2] += force_divr * dx.x * dx.z;
+                virial[3] += force_divr * dx.y * dx.y;
+                virial[4] += force_divr * dx.y * dx.z;
+                virial[5] += force_divr * dx.z * dx.z;
+                }
+            if (particle_energy)
+                {
+                (*particle_energy)[i] += pair_eng * Scalar(0.5);
+                (*particle_energy)[j] += pair_eng * Scalar(0.5);
+                }
+            }
+        force[i] += fi;
+        }
+
+    if (c.dimensions == 2)
+        {
+        for (auto& fi : force)
+            fi.z = Scalar(0.0);
+        }
+    return energy;
+    }
+
+namespace detail
+    {
+//! Export the methods of ReplicaPairForce shared by its subclasses
+/*! \param cls Class of a ReplicaPairForce subclass
+ */
+template<class T, class... B> void export_ReplicaPairForce(pybind11::class_<T, B...>& cls)
+    {
+    cls.def("setParams", &T::setParams)
+        .def("setRCut", &T::setRCut)
+        .def_readwrite("buffer", &T::m_buffer)
+        .def_readwrite("num_threads", &T::m_num_threads);
+    }
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __REPLICA_PAIR_FORCE_H__
@@ -0,0 +1,172 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+/*! \file StressAutocorrelation.cc
+    \brief Defines StressAutocorrelation
+*/
+
+#include "StressAutocorrelation.h"
+
+#include <stdexcept>
+
+#ifdef ENABLE_MPI
+#include "hoomd/HOOMDMPI.h"
+#endif
+
+using namespace std;
+
+namespace hoomd
+    {
+namespace md
+    {
+/*! \param sysdef System definition
+    \param forces Force computes whose stress is correlated
+    \param p Number of lags per correlator level
+    \param m Averaging factor between levels
+    \param include_kinetic Add the kinetic term to the pressure tensor
+*/
+StressAutocorrelation::StressAutocorrelation(std::shared_ptr<SystemDefinition> sysdef,
+                                             pybind11::list forces,
+                                             unsigned int p,
+                                             unsigned int m,
+                                             bool include_kinetic)
+    : Analyzer(sysdef), m_include_kinetic(include_kinetic)
+    {
+    m_exec_conf->msg->notice(5) << "Constructing StressAutocorrelation" << endl;
+
+    if (m < 2 || p < m || p % m != 0)
+        {
+        throw runtime_error("p must be a multiple of m, and m at least 2.");
+        }
+
+    for (auto force : forces)
+        {
+        m_forces.push_back(force.cast<std::shared_ptr<ForceCompute>>());
+        }
+
+    const unsigned int n_channels = m_sysdef->getNDimensions() == 2 ? 1 : 3;
+    m_correlators.assign(n_channels, MultiTauCorrelator(p, m));
+    }
+
+StressAutocorrelation::~StressAutocorrelation()
+    {
+    m_exec_conf->msg->notice(5) << "Destroying StressAutocorrelation" << endl;
+    }
+
+/*! \param timestep Current time step
+ */
+void StressAutocorrelation::analyze(uint64_t timestep)
+    {
+    // xy, xz, yz in the layout of the virial arrays
+    const unsigned int components[3] = {1, 2, 4};
+    double sum[3] = {0.0, 0.0, 0.0};
+
+    const unsigned int N = m_pdata->getN();
+    for (auto& force : m_forces)
+        {
+        const GlobalArray<Scalar>& virial = force->getVirialArray();
+        const size_t pitch = virial.getPitch();
+        ArrayHandle<Scalar> h_virial(virial, access_location::host, access_mode::read);
+        for (unsigned int c = 0; c < 3; c++)
+            {
+            const Scalar* v = h_virial.data + components[c] * pitch;
+            double s = 0.0;
+            for (unsigned int i = 0; i < N; i++)
+                s += v[i];
+            sum[c] += s;
+            }
+        }
+
+    if (m_include_kinetic)
+        {
+        ArrayHandle<Scalar4> h_vel(m_pdata->getVelocities(), access_location::host, access_mode::read);
+        for (unsigned int i = 0; i < N; i++)
+            {
+            const Scalar4 v = h_vel.data[i];
+            sum[0] += v.w * v.x * v.y;
+            sum[1] += v.w * v.x * v.z;
+            sum[2] += v.w * v.y * v.z;
+            }
+        }
+
+#ifdef ENABLE_MPI
+    if (m_sysdef->isDomainDecomposed())
+        {
+        MPI_Allreduce(MPI_IN_PLACE, sum, 3, MPI_DOUBLE, MPI_SUM, m_exec_conf->getMPICommunicator());
+        }
+#endif
+
+    // the external virial is already a global total
+    for (auto& force : m_forces)
+        {
+        for (unsigned int c = 0; c < 3; c++)
+            sum[c] += force->getExternalVirial(components[c]);
+        }
+
+    const BoxDim box = m_pdata->getGlobalBox();
+    const double volume = m_sysdef->getNDimensions() == 2 ? box.getVolume(true) : box.getVolume();
+
+    if (m_n_samples == 0)
+        m_first_timestep = timestep;
+    else if (m_n_samples == 1)
+        m_period = timestep - m_first_timestep;
+
+    for (unsigned int c = 0; c < m_correlators.size(); c++)
+        m_correlators[c].add(sum[c] / volume);
+    m_n_samples++;
+    }
+
+void StressAutocorrelation::reset()
+    {
+    for (auto& correlator : m_correlators)
+        correlator.reset();
+    m_n_samples = 0;
+    m_period = 0;
+    }
+
+pybind11::array_t<double> StressAutocorrelation::getLagSteps()
+    {
+    vector<double> lags, values;
+    m_correlators[0].get(lags, values);
+    for (auto& lag : lags)
+        lag *= double(m_period);
+    return pybind11::array_t<double>(lags.size(), lags.data());
+    }
+
+pybind11::array_t<double> StressAutocorrelation::getAutocorrelation()
+    {
+    vector<double> lags, values, mean;
+    for (auto& correlator : m_correlators)
+        {
+        correlator.get(lags, values);
+        mean.resize(values.size(), 0.0);
+        for (size_t l = 0; l < values.size(); l++)
+            mean[l] += values[l] / double(m_correlators.size());
+        }
+    return pybind11::array_t<double>(mean.size(), mean.data());
+    }
+
+namespace detail
+    {
+void export_StressAutocorrelation(pybind11::module& m)
+    {
+    pybind11::class_<StressAutocorrelation, Analyzer, std::shared_ptr<StressAutocorrelation>>(
+        m,
+        "StressAutocorrelation")
+        .def(pybind11::init<std::shared_ptr<SystemDefinition>,
+                            pybind11::list,
+                            unsigned int,
+                            unsigned int,
+                            bool>())
+        .def("reset", &StressAutocorrelation::reset)
+        .def_property_readonly("lag_steps", &StressAutocorrelation::getLagSteps)
+        .def_property_readonly("autocorrelation", &StressAutocorrelation::getAutocorrelation)
+        .def_property_readonly("num_samples", &StressAutocorrelation::getNumSamples);
+    }
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
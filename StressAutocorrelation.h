@@ -0,0 +1,101 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __STRESS_AUTOCORRELATION_H__
+#define __STRESS_AUTOCORRELATION_H__
+
+#include <memory>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <vector>
+
+#include "hoomd/Analyzer.h"
+#include "hoomd/ForceCompute.h"
+
+#include "MultiTauCorrelator.h"
+
+/*! \file StressAutocorrelation.h
+    \brief Declares the StressAutocorrelation class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! On the fly autocorrelation of the off-diagonal pressure tensor
+/*! Every time it is triggered, the analyzer sums the off-diagonal virial of
+   the given forces (per particle arrays plus the external virial, so
+   totals_only granular forces count), optionally adds the kinetic term
+   m v_a v_b, divides by the volume and feeds P_xy, P_xz and P_yz into one
+   MultiTauCorrelator each. In 2D only P_xy is used.
+
+    The reported autocorrelation is the mean of the channels,
+    C(t) = < P_ab(0) P_ab(t) >, which is what the Green-Kubo shear viscosity
+   eta = V / kT \int_0^\infty C(t) dt needs. Lags are reported in time steps,
+   assuming a constant trigger period.
+*/
+class PYBIND11_EXPORT StressAutocorrelation : public Analyzer
+    {
+    public:
+    //! Constructs the analyzer
+    StressAutocorrelation(std::shared_ptr<SystemDefinition> sysdef,
+                          pybind11::list forces,
+                          unsigned int p,
+                          unsigned int m,
+                          bool include_kinetic);
+
+    //! Destructor
+    virtual ~StressAutocorrelation();
+
+    //! Add the current pressure tensor to the correlators
+    virtual void analyze(uint64_t timestep);
+
+    //! The forces must compute their virials
+    virtual PDataFlags getRequestedPDataFlags()
+        {
+        PDataFlags flags(0);
+        flags[pdata_flag::pressure_tensor] = 1;
+        return flags;
+        }
+
+    //! Forget all samples
+    void reset();
+
+    //! Get the lags in time steps
+    pybind11::array_t<double> getLagSteps();
+
+    //! Get the autocorrelation at each lag
+    pybind11::array_t<double> getAutocorrelation();
+
+    //! Get the number of samples so far
+    uint64_t getNumSamples()
+        {
+        return m_n_samples;
+        }
+
+    protected:
+    std::vector<std::shared_ptr<ForceCompute>> m_forces; //!< Forces whose stress is correlated
+    bool m_include_kinetic;                              //!< Add the kinetic term
+    std::vector<MultiTauCorrelator> m_correlators;       //!< One per off-diagonal component
+    uint64_t m_n_samples = 0;                            //!< Number of samples so far
+    uint64_t m_first_timestep = 0;                       //!< Time step of the first sample
+    uint64_t m_period = 0;                               //!< Time steps between samples
+    };
+
+namespace detail
+    {
+//! Exports StressAutocorrelation to python
+void export_StressAutocorrelation(pybind11::module& m);
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __STRESS_AUTOCORRELATION_H__
@@ -0,0 +1,233 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __STRESS_PROFILE_H__
+#define __STRESS_PROFILE_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <pybind11/numpy.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hoomd/BoxDim.h"
+#include "hoomd/ExecutionConfiguration.h"
+#include "hoomd/HOOMDMath.h"
+
+#ifdef ENABLE_MPI
+#include "hoomd/HOOMDMPI.h"
+#endif
+
+/*! \file StressProfile.h
+    \brief Declares the StressProfile class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! Slab binned virial part of the pressure tensor
+/*! The box is cut into \a n_bins slabs of equal width normal to one axis.
+   Following Irving and Kirkwood, the virial of a pair is not given to the
+   particles but spread along the line between them: every slab receives the
+   fraction of the line, projected on the axis, that lies inside it. A pair
+   whose line is parallel to the slabs contributes to the slab of particle i
+   only. Summed over the slabs, the profile times the slab volume is the
+   total pair virial, as in the per particle arrays.
+
+    Slabs are defined in fractional coordinates, so they follow the box when
+   it deforms. Each sample is divided by the slab volume at the time it is
+   taken. The profile is the mean over all samples; the kinetic part of the
+   pressure tensor is not included.
+
+    The pair loops call beginSample(), addPair() for every pair and
+   endSample() on the steps where isSampleStep() is true. Sums are local to
+   the rank and reduced in get().
+*/
+class StressProfile
+    {
+    public:
+    //! Set the axis and the number of slabs, 0 slabs disables the profile
+    void configure(unsigned int axis, unsigned int n_bins)
+        {
+        if (axis > 2)
+            {
+            throw std::runtime_error("profile_axis must be x, y or z.");
+            }
+        m_axis = axis;
+        m_n_bins = n_bins;
+        reset();
+        }
+
+    unsigned int getAxis() const
+        {
+        return m_axis;
+        }
+
+    unsigned int getNumBins() const
+        {
+        return m_n_bins;
+        }
+
+    //! Set the number of time steps between samples
+    void setPeriod(uint64_t period)
+        {
+        if (period == 0)
+            {
+            throw std::runtime_error("profile_period must be at least 1.");
+            }
+        m_period = period;
+        }
+
+    uint64_t getPeriod() const
+        {
+        return m_period;
+        }
+
+    //! Check whether the pair loop samples on this step
+    bool isSampleStep(uint64_t timestep) const
+        {
+        return m_n_bins > 0 && timestep % m_period == 0;
+        }
+
+    //! Forget all samples
+    void reset()
+        {
+        m_sum.assign(size_t(m_n_bins) * 6, 0.0);
+        m_n_samples = 0;
+        }
+
+    uint64_t getNumSamples() const
+        {
+        return m_n_samples;
+        }
+
+    //! Start a sample in the current box
+    /*! \param box Global simulation box
+        \param two_d Use the area of the box as its volume
+    */
+    void beginSample(const BoxDim& box, bool two_d)
+        {
+        m_box = box;
+        m_inv_slab_volume = double(m_n_bins) / (two_d ? box.getVolume(true) : box.getVolume());
+        }
+
+    //! Spread the virial of one pair over the slabs
+    /*! \param pi Position of particle i
+        \param dx Minimum image separation r_i - r_j
+        \param f Force on particle i
+        \param weight Share of the pair counted by this call
+    */
+    void addPair(const Scalar3& pi, const Scalar3& dx, const Scalar3& f, Scalar weight)
+        {
+        const double w[6] = {dx.x * f.x, dx.y * f.x, dx.z * f.x, dx.y * f.y, dx.z * f.y, dx.z * f.z};
+
+        // slab coordinates of both ends, j taken as the image next to i
+        const double bi = component(m_box.makeFraction(pi)) * m_n_bins;
+        const double bj = component(m_box.makeFraction(pi - dx)) * m_n_bins;
+        const double lo = std::min(bi, bj);
+        const double hi = std::max(bi, bj);
+        const double scale = weight * m_inv_slab_volume;
+
+        if (hi - lo < 1e-12)
+            {
+            accumulate(std::floor(bi), w, scale);
+            return;
+            }
+
+        const double inv_length = 1.0 / (hi - lo);
+        for (double b = std::floor(lo); b < hi; b += 1.0)
+            {
+            const double overlap = std::min(hi, b + 1.0) - std::max(lo, b);
+            accumulate(b, w, scale * overlap * inv_length);
+            }
+        }
+
+    //! Finish the current sample
+    void endSample()
+        {
+        m_n_samples++;
+        }
+
+    //! Get the mean profile as an (n_bins, 6) array, reduced over all ranks
+    pybind11::array_t<double> get(std::shared_ptr<const ExecutionConfiguration> exec_conf,
+                                  bool domain_decomposed) const
+        {
+        std::vector<double> profile(m_sum);
+#ifdef ENABLE_MPI
+        if (domain_decomposed)
+            {
+            MPI_Allreduce(MPI_IN_PLACE,
+                          profile.data(),
+                          (int)profile.size(),
+                          MPI_DOUBLE,
+                          MPI_SUM,
+                          exec_conf->getMPICommunicator());
+            }
+#endif
+        if (m_n_samples > 0)
+            {
+            for (auto& value : profile)
+                value /= double(m_n_samples);
+            }
+        return pybind11::array_t<double>({size_t(m_n_bins), size_t(6)}, profile.data());
+        }
+
+    //! Convert an axis name to its index
+    static unsigned int axisFromName(const std::string& name)
+        {
+        if (name == "x")
+            return 0;
+        if (name == "y")
+            return 1;
+        if (name == "z")
+            return 2;
+        throw std::runtime_error("profile_axis must be x, y or z.");
+        }
+
+    //! Convert an axis index to its name
+    static std::string axisName(unsigned int axis)
+        {
+        const char* names[3] = {"x", "y", "z"};
+        return names[axis];
+        }
+
+    private:
+    double component(const Scalar3& v) const
+        {
+        return m_axis == 0 ? v.x : (m_axis == 1 ? v.y : v.z);
+        }
+
+    //! Add a weighted virial to slab \a b, wrapped into the box
+    void accumulate(double b, const double* w, double scale)
+        {
+        long bin = long(b) % long(m_n_bins);
+        if (bin < 0)
+            bin += m_n_bins;
+        double* sum = m_sum.data() + size_t(bin) * 6;
+        for (unsigned int k = 0; k < 6; k++)
+            sum[k] += w[k] * scale;
+        }
+
+    unsigned int m_axis = 2;          //!< Axis normal to the slabs
+    unsigned int m_n_bins = 0;        //!< Number of slabs, 0 when disabled
+    uint64_t m_period = 1;            //!< Time steps between samples
+    std::vector<double> m_sum;        //!< Sum of the samples, 6 components per slab
+    uint64_t m_n_samples = 0;         //!< Number of samples so far
+    BoxDim m_box;                     //!< Box of the current sample
+    double m_inv_slab_volume = 0.0;   //!< Inverse slab volume of the current sample
+    };
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __STRESS_PROFILE_H__
@@ -0,0 +1,236 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __TRAJECTORY_EVALUATOR_H__
+#define __TRAJECTORY_EVALUATOR_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ReplicaPairForce.h"
+
+/*! \file TrajectoryEvaluator.h
+    \brief Defines the TrajectoryEvaluator class
+*/
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+namespace hoomd
+    {
+namespace md
+    {
+//! Pair energies, virials and forces of stored frames
+/*! Evaluates each frame added with addFrame() once, without a Simulation.
+   Frames are independent of each other and of HOOMD's particle data, so
+   run() hands whole frames to \a num_threads threads with the GIL released,
+   and python can read the next frames from disk meanwhile.
+
+    The total energy and virial of every frame are always kept. The forces
+   and per particle energies are only kept when \a m_per_particle is set.
+
+    \tparam evaluator Pair evaluator
+*/
+template<class evaluator> class TrajectoryEvaluator : public ReplicaPairForce<evaluator>
+    {
+    public:
+    typedef typename ReplicaPairForce<evaluator>::double_array double_array;
+    typedef typename ReplicaPairForce<evaluator>::uint_array uint_array;
+
+    //! Construct the evaluator
+    /*! \param n_types Number of particle types
+        \param mode Energy shift mode of the pair potential
+    */
+    TrajectoryEvaluator(unsigned int n_types, const std::string& mode)
+        : ReplicaPairForce<evaluator>(n_types, mode)
+        {
+        }
+
+    //! Add a frame to evaluate
+    void addFrame(double_array position,
+                  uint_array typeid_,
+                  double_array box,
+                  unsigned int dimensions)
+        {
+        Frame f;
+        this->makeConfiguration(f, position, typeid_, box, dimensions);
+        m_frames.push_back(std::move(f));
+        }
+
+    //! Evaluate all frames that were added
+    void run();
+
+    //! Forget all frames
+    void clear()
+        {
+        m_frames.clear();
+        }
+
+    unsigned int getNumFrames()
+        {
+        return (unsigned int)m_frames.size();
+        }
+
+    //! Get the potential energy of every frame
+    pybind11::array_t<double> getEnergies()
+        {
+        std::vector<double> energy(m_frames.size());
+        for (size_t k = 0; k < m_frames.size(); k++)
+            energy[k] = m_frames[k].energy;
+        return pybind11::array_t<double>(energy.size(), energy.data());
+        }
+
+    //! Get the virial of every frame, [xx, xy, xz, yy, yz, zz]
+    pybind11::array_t<double> getVirials()
+        {
+        std::vector<double> virial(m_frames.size() * 6);
+        for (size_t k = 0; k < m_frames.size(); k++)
+            std::copy(m_frames[k].virial, m_frames[k].virial + 6, virial.begin() + 6 * k);
+        return pybind11::array_t<double>({m_frames.size(), size_t(6)}, virial.data());
+        }
+
+    //! Get the forces of a frame
+    pybind11::array_t<double> getForces(unsigned int frame)
+        {
+        const Frame& f = getEvaluatedFrame(frame);
+        std::vector<double> force(f.force.size() * 3);
+        for (size_t i = 0; i < f.force.size(); i++)
+            {
+            force[3 * i] = f.force[i].x;
+            force[3 * i + 1] = f.force[i].y;
+            force[3 * i + 2] = f.force[i].z;
+            }
+        return pybind11::array_t<double>({f.force.size(), size_t(3)}, force.data());
+        }
+
+    //! Get the energy of each particle of a frame
+    pybind11::array_t<double> getParticleEnergies(unsigned int frame)
+        {
+        const Frame& f = getEvaluatedFrame(frame);
+        std::vector<double> energy(f.particle_energy.begin(), f.particle_energy.end());
+        return pybind11::array_t<double>(energy.size(), energy.data());
+        }
+
+    bool m_per_particle = false; //!< Keep the forces and per particle energies
+
+    protected:
+    typedef typename ReplicaPairForce<evaluator>::VerletList VerletList;
+
+    //! One configuration and its results
+    struct Frame : public ReplicaPairForce<evaluator>::Configuration
+        {
+        double energy = 0.0;                 //!< Potential energy
+        double virial[6] = {0.0};            //!< Total virial
+        std::vector<Scalar3> force;          //!< Forces, with m_per_particle
+        std::vector<Scalar> particle_energy; //!< Energy of each particle, with m_per_particle
+        };
+
+    std::vector<Frame> m_frames; //!< Frames to evaluate
+
+    const Frame& getEvaluatedFrame(unsigned int frame)
+        {
+        if (frame >= m_frames.size())
+            {
+            throw std::runtime_error("Invalid frame index.");
+            }
+        if (!m_per_particle)
+            {
+            throw std::runtime_error("Per particle results require per_particle.");
+            }
+        return m_frames[frame];
+        }
+
+    //! Evaluate one frame
+    void evaluate(Frame& f) const;
+    };
+
+/*! Frames are handed out one at a time, so threads that get small frames take
+   more of them.
+*/
+template<class evaluator> void TrajectoryEvaluator<evaluator>::run()
+    {
+    pybind11::gil_scoped_release release;
+
+    std::atomic<size_t> next(0);
+    auto worker = [this, &next]()
+    {
+        for (size_t k = next++; k < m_frames.size(); k = next++)
+            evaluate(m_frames[k]);
+    };
+
+    const size_t n_threads
+        = std::max<size_t>(std::min<size_t>(this->m_num_threads, m_frames.size()), 1);
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (size_t t = 1; t < n_threads; t++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+    }
+
+/*! The Verlet list is used once, so it is built with the cutoff plus
+   \a m_buffer, which python sets to 0.
+
+    \param f Frame to evaluate in place
+*/
+template<class evaluator> void TrajectoryEvaluator<evaluator>::evaluate(Frame& f) const
+    {
+    VerletList list;
+    this->buildVerletList(f, this->getListRange(), list);
+
+    std::vector<Scalar3> force;
+    f.energy = this->computeForces(f,
+                                   f.pos,
+                                   list,
+                                   force,
+                                   f.virial,
+                                   m_per_particle ? &f.particle_energy : nullptr);
+    if (m_per_particle)
+        f.force.swap(force);
+
+    // the results are all that is needed from here on
+    std::vector<Scalar3>().swap(f.pos);
+    std::vector<int3>().swap(f.image);
+    std::vector<unsigned int>().swap(f.type);
+    }
+
+namespace detail
+    {
+//! Export a TrajectoryEvaluator to python
+/*! \param name Name of the class in the exported python module
+    \tparam T Evaluator type to export.
+*/
+template<class T> void export_TrajectoryEvaluator(pybind11::module& m, const std::string& name)
+    {
+    typedef TrajectoryEvaluator<T> evaluator_t;
+    pybind11::class_<evaluator_t, std::shared_ptr<evaluator_t>> cls(m, name.c_str());
+    cls.def(pybind11::init<unsigned int, const std::string&>())
+        .def("addFrame", &evaluator_t::addFrame)
+        .def("run", &evaluator_t::run)
+        .def("clear", &evaluator_t::clear)
+        .def("getForces", &evaluator_t::getForces)
+        .def("getParticleEnergies", &evaluator_t::getParticleEnergies)
+        .def_property_readonly("num_frames", &evaluator_t::getNumFrames)
+        .def_property_readonly("energies", &evaluator_t::getEnergies)
+        .def_property_readonly("virials", &evaluator_t::getVirials)
+        .def_readwrite("per_particle", &evaluator_t::m_per_particle);
+    export_ReplicaPairForce(cls);
+    }
+
+    } // end namespace detail
+
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __TRAJECTORY_EVALUATOR_H__
@@ -0,0 +1,171 @@
+// Copyright (c) 2009-2022 The Regents of the University of Michigan.
+// Part of HOOMD-blue, released under the BSD 3-Clause License.
+
+// Maintainer: ianrgraham
+
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#ifdef __HIPCC__
+#error This header cannot be compiled by nvcc
+#endif
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*! \file WorkerPool.h
+    \brief Defines the WorkerPool class
+*/
+
+namespace hoomd
+    {
+namespace md
+    {
+namespace detail
+    {
+//! Persistent host threads for loops that run every time step
+/*! Starting and joining threads costs several microseconds, which is on the
+   order of a whole time step of a small system. The pool starts its workers
+   once and run() hands every worker the same task, worker t calling
+   task(t), and returns when all of them are done. The calling thread only
+   waits, so chunk t is always handled by the same worker thread.
+
+    On Linux every worker is pinned to its own share of the CPUs the process
+   may run on: the allowed CPUs are taken in order and split into \a
+   n_threads contiguous groups, so a worker stays on one socket and the
+   pages it touched first stay local to it. Under MPI the launcher's binding
+   of each rank limits the allowed CPUs. With fewer CPUs than workers, the
+   workers share them round robin.
+
+    Tasks must not throw.
+*/
+class WorkerPool
+    {
+    public:
+    //! Start \a n_threads workers
+    explicit WorkerPool(unsigned int n_threads)
+        {
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+            {
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                {
+                if (CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+                }
+            const size_t n_cpus = cpus.size();
+            m_cpu_sets.resize(n_cpus > 0 ? n_threads : 0);
+            for (unsigned int t = 0; t < m_cpu_sets.size(); t++)
+                {
+                CPU_ZERO(&m_cpu_sets[t]);
+                size_t first = size_t(t) * n_cpus / n_threads;
+                size_t last = size_t(t + 1) * n_cpus / n_threads;
+                if (last == first)
+                    {
+                    first = t % n_cpus;
+                    last = first + 1;
+                    }
+                for (size_t k = first; k < last; k++)
+                    CPU_SET(cpus[k], &m_cpu_sets[t]);
+                }
+            }
+#endif
+        m_threads.reserve(n_threads);
+        for (unsigned int t = 0; t < n_threads; t++)
+            m_threads.emplace_back(&WorkerPool::work, this, t);
+        }
+
+    //! Stop and join the workers
+    ~WorkerPool()
+        {
+            {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_generation++;
+            }
+        m_wake.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+        }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    //! Number of workers
+    unsigned int size() const
+        {
+        return (unsigned int)m_threads.size();
+        }
+
+    //! Call task(t) on every worker t and wait for all of them
+    void run(const std::function<void(unsigned int)>& task)
+        {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_pending = size();
+        m_generation++;
+        m_wake.notify_all();
+        m_done.wait(lock, [this] { return m_pending == 0; });
+        m_task = nullptr;
+        }
+
+    private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake; //!< Signals a new task or the stop
+    std::condition_variable m_done; //!< Signals the last finished worker
+    const std::function<void(unsigned int)>* m_task = nullptr; //!< Current task
+    uint64_t m_generation = 0;  //!< Incremented for every task
+    unsigned int m_pending = 0; //!< Workers still running the current task
+    bool m_stop = false;        //!< True when the workers must exit
+#ifdef __linux__
+    std::vector<cpu_set_t> m_cpu_sets; //!< CPUs of each worker, empty when unknown
+#endif
+
+    //! Main loop of worker \a t
+    void work(unsigned int t)
+        {
+#ifdef __linux__
+        // a failed pin only costs locality
+        if (t < m_cpu_sets.size())
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &m_cpu_sets[t]);
+#endif
+        uint64_t seen = 0;
+        while (true)
+            {
+            const std::function<void(unsigned int)>* task;
+                {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this, seen] { return m_generation != seen; });
+                seen = m_generation;
+                if (m_stop)
+                    return;
+                task = m_task;
+                }
+
+            (*task)(t);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+                m_done.notify_one();
+            }
+        }
+    };
+
+    } // end namespace detail
+    } // end namespace md
+    } // end namespace hoomd
+
+#endif // __WORKER_POOL_H__
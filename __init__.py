@@ -3,4 +3,8 @@
 # License.
 """Modified LJ potential module."""
 
+from hoomd.pair_plugin import analyze
+from hoomd.pair_plugin import minimize
+from hoomd.pair_plugin import nlist
 from hoomd.pair_plugin import pair
+from hoomd.pair_plugin import trajectory
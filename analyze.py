@@ -0,0 +1,119 @@
+# Copyright (c) 2009-2022 The Regents of the University of Michigan.
+# Part of HOOMD-blue, released under the BSD 3-Clause License.
+"""Analysis writers for the plugin pair forces."""
+
+import numpy
+
+import hoomd
+from hoomd.logging import log
+from hoomd.operation import Writer
+from hoomd.pair_plugin import _pair_plugin
+
+
+class StressAutocorrelation(Writer):
+    r"""On the fly autocorrelation of the off-diagonal pressure tensor.
+
+    Args:
+        trigger (hoomd.trigger.trigger_like): Select the time steps to sample
+            on. Must be periodic.
+        forces (`list` [`hoomd.md.force.Force`]): Forces whose virial enters
+            the pressure tensor.
+        p (int): Number of lags per correlator level.
+        m (int): Averaging factor between correlator levels, must divide
+            ``p``.
+        include_kinetic (bool): Add the kinetic term
+            :math:`\sum_i m_i v_{i,a} v_{i,b}`.
+        kT (float): Temperature used by `viscosity`
+            :math:`[\mathrm{energy}]`.
+
+    ``p``, ``m`` and ``include_kinetic`` take effect when the analyzer is
+    attached, ``kT`` can be changed at any time.
+
+    `StressAutocorrelation` feeds :math:`P_{xy}`, :math:`P_{xz}` and
+    :math:`P_{yz}` (only :math:`P_{xy}` in 2D) into multiple tau correlators
+    every time it is triggered. The first level correlates the last ``p``
+    samples, every further level averages ``m`` samples of the previous one,
+    so memory grows with the logarithm of the run length instead of with the
+    run length. The running autocorrelation
+
+    .. math::
+
+        C(t) = \langle P_{ab}(0) P_{ab}(t) \rangle
+
+    averaged over the components, is available at any time, together with
+    the Green-Kubo shear viscosity
+
+    .. math::
+
+        \eta = \frac{V}{kT} \int_0^{t_\mathrm{max}} C(t) \, dt
+
+    integrated with the trapezoid rule over the available lags. Virials of
+    granular forces with ``totals_only`` are included.
+
+    Example::
+
+        acf = pair_plugin.analyze.StressAutocorrelation(
+            trigger=hoomd.trigger.Periodic(1), forces=[lj], kT=1.0)
+        sim.operations.writers.append(acf)
+        sim.run(1_000_000)
+        print(acf.viscosity)
+    """
+
+    def __init__(self,
+                 trigger,
+                 forces,
+                 p=16,
+                 m=2,
+                 include_kinetic=True,
+                 kT=1.0):
+        super().__init__(trigger)
+        self._forces = list(forces)
+        self.p = int(p)
+        self.m = int(m)
+        self.include_kinetic = bool(include_kinetic)
+        self.kT = float(kT)
+
+    def _attach_hook(self):
+        for force in self._forces:
+            if not force._attached:
+                raise hoomd.error.SimulationDefinitionError(
+                    f"{force} must be attached before {self}.")
+        self._cpp_obj = _pair_plugin.StressAutocorrelation(
+            self._simulation.state._cpp_sys_def,
+            [force._cpp_obj for force in self._forces], self.p, self.m,
+            self.include_kinetic)
+
+    def reset(self):
+        """Forget all samples."""
+        if self._attached:
+            self._cpp_obj.reset()
+
+    @log(requires_run=True)
+    def num_samples(self):
+        """int: Number of samples so far."""
+        return self._cpp_obj.num_samples
+
+    @log(category="sequence", requires_run=True)
+    def lag_times(self):
+        """(*L*, ) `numpy.ndarray` of ``float``: Lags of `autocorrelation` \
+        :math:`[\\mathrm{time}]`."""
+        dt = self._simulation.operations.integrator.dt
+        return numpy.asarray(self._cpp_obj.lag_steps) * dt
+
+    @log(category="sequence", requires_run=True)
+    def autocorrelation(self):
+        """(*L*, ) `numpy.ndarray` of ``float``: Autocorrelation of the \
+        off-diagonal pressure tensor at `lag_times` \
+        :math:`[\\mathrm{pressure}^2]`."""
+        return numpy.asarray(self._cpp_obj.autocorrelation)
+
+    @log(requires_run=True)
+    def viscosity(self):
+        """float: Green-Kubo shear viscosity from the lags so far \
+        :math:`[\\mathrm{pressure} \\cdot \\mathrm{time}]`."""
+        t = self.lag_times
+        c = self.autocorrelation
+        if len(t) < 2:
+            return 0.0
+        volume = self._simulation.state.box.volume
+        return volume / self.kT * numpy.sum(0.5 * (c[1:] + c[:-1]) * numpy.diff(t))
@@ -0,0 +1,308 @@
+# Copyright (c) 2009-2022 The Regents of the University of Michigan.
+# Part of HOOMD-blue, released under the BSD 3-Clause License.
+"""Energy minimization of stored configurations with the plugin pairs."""
+
+import copy
+import itertools
+
+import numpy
+
+from hoomd.pair_plugin import _pair_plugin
+
+
+def _make_replica_force(pair, class_attr, types, buffer, num_threads):
+    """Create the C++ replica driver named by ``class_attr`` of ``pair``."""
+    if not hasattr(pair, class_attr):
+        raise TypeError(f"{type(pair).__name__} is not supported.")
+    cls = getattr(_pair_plugin, getattr(pair, class_attr))
+    cpp_obj = cls(len(types), pair.mode)
+    for i, j in itertools.combinations_with_replacement(range(len(types)), 2):
+        cpp_obj.setParams(i, j, pair.params[(types[i], types[j])])
+        cpp_obj.setRCut(i, j, pair.r_cut[(types[i], types[j])])
+    cpp_obj.buffer = buffer
+    cpp_obj.num_threads = num_threads
+    return cpp_obj
+
+
+def _typeid(frame):
+    typeid = frame.particles.typeid
+    if typeid is None:
+        typeid = numpy.zeros(len(frame.particles.position), dtype=numpy.uint32)
+    return numpy.asarray(typeid)
+
+
+def _updated_frame(frame, position, image_shift):
+    """Copy ``frame`` with new positions and images shifted by ``image_shift``.
+    """
+    out = copy.deepcopy(frame)
+    out.particles.position = position
+    image = frame.particles.image
+    if image is None:
+        image = numpy.zeros((len(position), 3), dtype=numpy.int32)
+    out.particles.image = numpy.asarray(image) + image_shift
+    return out
+
+
+class BatchFIRE:
+    r"""Quench many configurations to their inherent structures in parallel.
+
+    Args:
+        pair (`hoomd.md.pair.Pair`): Plugin pair potential that defines the
+            energy, one of `ModLJ <hoomd.pair_plugin.pair.ModLJ>`,
+            `WLJ <hoomd.pair_plugin.pair.WLJ>` or
+            `Hertzian <hoomd.pair_plugin.pair.Hertzian>`.
+        dt (float): Initial FIRE time step :math:`[\mathrm{time}]`.
+        force_tol (float): Tolerance of the rms force per degree of freedom
+            :math:`[\mathrm{force}]`.
+        energy_tol (float): Tolerance of the change of the energy per
+            particle in one step :math:`[\mathrm{energy}]`.
+        max_steps (int): Maximum number of FIRE steps per frame.
+        buffer (float): Buffer of the Verlet lists :math:`[\mathrm{length}]`.
+        num_threads (int): Number of frames quenched at the same time.
+
+    `BatchFIRE` minimizes every frame independently of any
+    `hoomd.Simulation`: each thread takes one frame at a time and runs FIRE
+    on it with unit masses, the same constants as `hoomd.md.minimize.FIRE`,
+    the potential of ``pair`` and a private cell and Verlet list. Parameters,
+    cutoffs and the energy shift mode (``'none'`` or ``'shift'``) are read
+    from ``pair`` when `quench` is called; ``pair`` does not need to be
+    attached.
+
+    Example::
+
+        fire = hoomd.pair_plugin.minimize.BatchFIRE(mlj, num_threads=32)
+        with gsd.hoomd.open('traj.gsd') as traj:
+            result = fire.quench(traj, output='inherent.gsd')
+    """
+
+    def __init__(self,
+                 pair,
+                 dt=0.005,
+                 force_tol=1e-6,
+                 energy_tol=1e-10,
+                 max_steps=100000,
+                 buffer=0.3,
+                 num_threads=1):
+        self.pair = pair
+        self.dt = dt
+        self.force_tol = force_tol
+        self.energy_tol = energy_tol
+        self.max_steps = max_steps
+        self.buffer = buffer
+        self.num_threads = num_threads
+
+    def quench(self, frames, output=None, batch_size=1024):
+        """Quench a sequence of frames.
+
+        Args:
+            frames: Iterable of `gsd.hoomd.Frame` objects sharing one list
+                of particle types, such as an open GSD trajectory.
+            output (str): Name of a GSD file to write the minimized frames
+                to, `None` to only return them.
+            batch_size (int): Number of frames held in memory at a time.
+
+        Returns:
+            dict: ``frames``, the minimized frames (only when ``output`` is
+            `None`); ``energy``, the potential energy of every frame;
+            ``steps``, the number of FIRE steps of every frame; and
+            ``converged``, whether every frame met both tolerances.
+
+        Minimized frames are copies of the input with new positions and
+        images. When written, the energy is also logged under
+        ``pair_plugin/BatchFIRE/energy``.
+        """
+        quench = None
+        minimized = []
+        energy, steps, converged = [], [], []
+
+        writer = None
+        if output is not None:
+            import gsd.hoomd
+            writer = gsd.hoomd.open(output, mode='w')
+
+        try:
+            batch = []
+            for frame in itertools.chain(frames, [None]):
+                if frame is not None:
+                    if quench is None:
+                        quench = self._make_quench(frame.particles.types)
+                    batch.append(frame)
+                if batch and (frame is None or len(batch) == batch_size):
+                    for f in self._quench_batch(quench, batch):
+                        energy.append(f.log["pair_plugin/BatchFIRE/energy"][0])
+                        if writer is not None:
+                            writer.append(f)
+                        else:
+                            minimized.append(f)
+                    steps.extend(quench.steps)
+                    converged.extend(quench.converged)
+                    batch = []
+        finally:
+            if writer is not None:
+                writer.close()
+
+        result = dict(energy=numpy.array(energy),
+                      steps=numpy.array(steps, dtype=numpy.uint64),
+                      converged=numpy.array(converged, dtype=bool))
+        if output is None:
+            result["frames"] = minimized
+        return result
+
+    def _make_quench(self, types):
+        quench = _make_replica_force(self.pair, "_quench_cpp_class_name",
+                                     types, self.buffer, self.num_threads)
+        quench.dt = self.dt
+        quench.force_tol = self.force_tol
+        quench.energy_tol = self.energy_tol
+        quench.max_steps = self.max_steps
+        return quench
+
+    @staticmethod
+    def _quench_batch(quench, batch):
+        quench.clear()
+        for frame in batch:
+            quench.addFrame(numpy.asarray(frame.particles.position),
+                            _typeid(frame),
+                            numpy.asarray(frame.configuration.box),
+                            frame.configuration.dimensions)
+        quench.run()
+
+        energies = quench.energies
+        for k, frame in enumerate(batch):
+            out = _updated_frame(frame, quench.getPosition(k),
+                                 quench.getImage(k))
+            out.log["pair_plugin/BatchFIRE/energy"] = [energies[k]]
+            yield out
+
+
+class NudgedElasticBand:
+    r"""Climbing image nudged elastic band between two configurations.
+
+    Args:
+        pair (`hoomd.md.pair.Pair`): Plugin pair potential that defines the
+            energy, one of `ModLJ <hoomd.pair_plugin.pair.ModLJ>`,
+            `WLJ <hoomd.pair_plugin.pair.WLJ>` or
+            `Hertzian <hoomd.pair_plugin.pair.Hertzian>`.
+        k (float): Spring constant between neighboring images
+            :math:`[\mathrm{energy} \cdot \mathrm{length}^{-2}]`.
+        climb (bool): Let the interior image of highest energy climb to the
+            saddle point.
+        dt (float): Initial FIRE time step :math:`[\mathrm{time}]`.
+        force_tol (float): Tolerance of the largest NEB force on a particle
+            :math:`[\mathrm{force}]`.
+        max_steps (int): Maximum number of FIRE steps.
+        buffer (float): Buffer of the Verlet list :math:`[\mathrm{length}]`.
+        num_threads (int): Number of threads that evaluate the images.
+
+    `NudgedElasticBand` holds all images of the chain in C++ and relaxes the
+    interior ones together with FIRE. The force on an image is the potential
+    force normal to the path plus a spring force along it; the tangent
+    follows the uphill neighbor (improved tangent estimate). With ``climb``,
+    the highest image feels the potential force along the path reversed and
+    no spring, so its energy converges to the barrier. Every iteration
+    evaluates the forces of all images in one threaded pass, and the images
+    share one Verlet list, which stays small when they are close.
+
+    Parameters, cutoffs and the energy shift mode (``'none'`` or
+    ``'shift'``) are read from ``pair`` when `run` is called; ``pair`` does
+    not need to be attached.
+
+    Example::
+
+        neb = hoomd.pair_plugin.minimize.NudgedElasticBand(wlj, climb=True)
+        images = neb.interpolate(initial, final, n_images=24)
+        result = neb.run(images)
+        barrier = result['energy'].max() - result['energy'][0]
+    """
+
+    def __init__(self,
+                 pair,
+                 k=1.0,
+                 climb=True,
+                 dt=0.005,
+                 force_tol=1e-4,
+                 max_steps=100000,
+                 buffer=0.3,
+                 num_threads=1):
+        self.pair = pair
+        self.k = k
+        self.climb = climb
+        self.dt = dt
+        self.force_tol = force_tol
+        self.max_steps = max_steps
+        self.buffer = buffer
+        self.num_threads = num_threads
+
+    @staticmethod
+    def interpolate(initial, final, n_images):
+        """Linearly interpolate between two frames.
+
+        Args:
+            initial (`gsd.hoomd.Frame`): First end point.
+            final (`gsd.hoomd.Frame`): Last end point, with the same
+                particles and box as ``initial``.
+            n_images (int): Number of images, end points included.
+
+        Returns:
+            list[`gsd.hoomd.Frame`]: The images. Each particle moves along
+            the minimum image of its displacement between the end points.
+        """
+        box = numpy.asarray(initial.configuration.box, dtype=numpy.float64)
+        Lx, Ly, Lz, xy, xz, yz = box
+        if initial.configuration.dimensions == 2:
+            Lz, xz, yz = 1.0, 0.0, 0.0
+        matrix = numpy.array([[Lx, xy * Ly, xz * Lz], [0, Ly, yz * Lz],
+                              [0, 0, Lz]])
+        start = numpy.asarray(initial.particles.position, dtype=numpy.float64)
+        delta = numpy.asarray(final.particles.position,
+                              dtype=numpy.float64) - start
+        fraction = numpy.linalg.solve(matrix, delta.T)
+        delta = (matrix @ (fraction - numpy.round(fraction))).T
+
+        images = []
+        for m in range(n_images):
+            image = copy.deepcopy(initial)
+            image.particles.position = start + delta * m / (n_images - 1)
+            images.append(image)
+        return images
+
+    def run(self, images):
+        """Relax a chain of images onto the minimum energy path.
+
+        Args:
+            images (list[`gsd.hoomd.Frame`]): At least 3 images sharing the
+                particles, types and box, end points included. The end
+                points stay fixed.
+
+        Returns:
+            dict: ``frames``, the relaxed images; ``energy``, the potential
+            energy of every image; ``climbing_image``, the index of the
+            climbing image (-1 without ``climb``); ``converged``, whether
+            the largest NEB force fell below ``force_tol``; ``max_force``,
+            that force; and ``steps``, the number of FIRE steps.
+        """
+        first = images[0]
+        neb = _make_replica_force(self.pair, "_neb_cpp_class_name",
+                                  first.particles.types, self.buffer,
+                                  self.num_threads)
+        neb.k = self.k
+        neb.climb = self.climb
+        neb.dt = self.dt
+        neb.force_tol = self.force_tol
+        neb.max_steps = self.max_steps
+        neb.setImages(
+            [numpy.asarray(image.particles.position) for image in images],
+            _typeid(first), numpy.asarray(first.configuration.box),
+            first.configuration.dimensions)
+        neb.run()
+
+        frames = [
+            _updated_frame(image, neb.getPosition(m), neb.getImage(m))
+            for m, image in enumerate(images)
+        ]
+        return dict(frames=frames,
+                    energy=numpy.asarray(neb.energies),
+                    climbing_image=neb.climbing_image,
+                    converged=neb.converged,
+                    max_force=neb.max_force,
+                    steps=neb.steps)
@@ -4,16 +4,29 @@
 
 // Include the defined classes that are to be exported to python
 #include <pybind11/pybind11.h>
+#include "BatchQuench.h"
+#include "CpuDispatch.h"
 #include "EvaluatorPairHertzian.h"
 #include "EvaluatorPairMLJ.h"
 #include "EvaluatorPairLJLow.h"
 #include "EvaluatorPairWLJ.h"
 #include "EvaluatorPairDipoleDipole.h"
-// #include "EvaluatorPairSpring.h"
-// #include "HPFPotentialPair.h"
+#include "EvaluatorPairSpring.h"
+#include "EvaluatorPairThermoDPD.h"
+#include "GranularPotentialPair.h"
+#include "NeighborListMultiLevel.h"
+#include "NudgedElasticBand.h"
+#include "PairParameterGradient.h"
+#include "PotentialPairProfile.h"
+#include "StressAutocorrelation.h"
+#include "TrajectoryEvaluator.h"
+#include "HPFPotentialPair.h"
 #include "hoomd/md/PotentialPair.h"
+#include "hoomd/md/PotentialPairDPDThermo.h"
 
 #ifdef ENABLE_HIP
+#include "GranularPotentialPairGPU.h"
+#include "hoomd/md/PotentialPairDPDThermoGPU.h"
 #include "hoomd/md/PotentialPairGPU.h"
 #endif
 
@@ -27,22 +40,77 @@ namespace md
 // front)
 PYBIND11_MODULE(_pair_plugin, m)
     {
+    // pick the host loop versions once, before any force compute exists
+    detail::selectCpuIsa();
+    m.def("cpu_isa", []() { return detail::cpuIsaName(detail::cpuIsa()); });
+
     detail::export_PotentialPair<EvaluatorPairMLJ>(m, "PotentialPairMLJ");
     detail::export_PotentialPair<EvaluatorPairWLJ>(m, "PotentialPairWLJ");
     detail::export_PotentialPair<EvaluatorPairHertzian>(m, "PotentialPairHertzian");
     detail::export_PotentialPair<EvaluatorPairDipoleDipole>(m, "PotentialPairDipoleDipole");
     detail::export_PotentialPair<EvaluatorPairLJLow>(m, "PotentialPairLJLow");
-    // detail::export_HPFPotentialPair<EvaluatorPairHarmSpring>(m, "PotentialPairHPF");
-    // detail::export_GranularPotentialPair<EvaluatorPairHarmSpring>(m, "PotentialPairGranular");
+    detail::export_PotentialPair<EvaluatorPairMLJApprox>(m, "PotentialPairMLJApprox");
+    detail::export_PotentialPair<EvaluatorPairWLJApprox>(m, "PotentialPairWLJApprox");
+    detail::export_PotentialPair<EvaluatorPairHertzianApprox>(m, "PotentialPairHertzianApprox");
+    detail::export_PotentialPairDPDThermo<EvaluatorPairMLJDPD>(m, "PotentialPairMLJDPD");
+    detail::export_PotentialPairDPDThermo<EvaluatorPairWLJDPD>(m, "PotentialPairWLJDPD");
+    detail::export_PotentialPairDPDThermo<EvaluatorPairMLJApproxDPD>(m, "PotentialPairMLJApproxDPD");
+    detail::export_PotentialPairDPDThermo<EvaluatorPairWLJApproxDPD>(m, "PotentialPairWLJApproxDPD");
+    detail::export_PotentialPairProfile<EvaluatorPairMLJ>(m, "PotentialPairMLJProfile");
+    detail::export_PotentialPairProfile<EvaluatorPairWLJ>(m, "PotentialPairWLJProfile");
+    detail::export_PotentialPairProfile<EvaluatorPairMLJApprox>(m, "PotentialPairMLJApproxProfile");
+    detail::export_PotentialPairProfile<EvaluatorPairWLJApprox>(m, "PotentialPairWLJApproxProfile");
+    detail::export_PairParameterGradient<EvaluatorPairMLJ>(m, "ParameterGradientMLJ");
+    detail::export_PairParameterGradient<EvaluatorPairWLJ>(m, "ParameterGradientWLJ");
+    detail::export_PairParameterGradient<EvaluatorPairHertzian>(m, "ParameterGradientHertzian");
+    detail::export_BatchQuench<EvaluatorPairMLJ>(m, "BatchQuenchMLJ");
+    detail::export_BatchQuench<EvaluatorPairWLJ>(m, "BatchQuenchWLJ");
+    detail::export_BatchQuench<EvaluatorPairHertzian>(m, "BatchQuenchHertzian");
+    detail::export_NudgedElasticBand<EvaluatorPairMLJ>(m, "NudgedElasticBandMLJ");
+    detail::export_NudgedElasticBand<EvaluatorPairWLJ>(m, "NudgedElasticBandWLJ");
+    detail::export_NudgedElasticBand<EvaluatorPairHertzian>(m, "NudgedElasticBandHertzian");
+    detail::export_TrajectoryEvaluator<EvaluatorPairMLJ>(m, "TrajectoryEvaluatorMLJ");
+    detail::export_TrajectoryEvaluator<EvaluatorPairWLJ>(m, "TrajectoryEvaluatorWLJ");
+    detail::export_TrajectoryEvaluator<EvaluatorPairHertzian>(m, "TrajectoryEvaluatorHertzian");
+    detail::export_HPFPotentialPair<EvaluatorPairHarmSpring>(m, "PotentialPairHPF");
+    detail::export_GranularPotentialPair<EvaluatorPairHarmSpring>(m, "PotentialPairGranular");
+    detail::export_GranularPotentialPair<EvaluatorPairHarmSpring, ContactLawHookean, RollingSpring>(
+        m,
+        "PotentialPairGranularHookean");
+    detail::export_GranularPotentialPair<EvaluatorPairHertzian,
+                                         ContactLawHertzMindlin,
+                                         RollingTwistingSpring>(m,
+                                                                "PotentialPairGranularHertzMindlin");
+    detail::export_NeighborListMultiLevel(m);
+    detail::export_StressAutocorrelation(m);
 #ifdef ENABLE_HIP
     detail::export_PotentialPairGPU<EvaluatorPairMLJ>(m, "PotentialPairMLJGPU");
     detail::export_PotentialPairGPU<EvaluatorPairWLJ>(m, "PotentialPairWLJGPU");
     detail::export_PotentialPairGPU<EvaluatorPairHertzian>(m, "PotentialPairHertzianGPU");
     detail::export_PotentialPairGPU<EvaluatorPairDipoleDipole>(m, "PotentialPairDipoleDipoleGPU");
     detail::export_PotentialPairGPU<EvaluatorPairLJLow>(m, "PotentialPairLJLowGPU");
-    // TODO, write GPU implementation
-    // detail::export_FrictionPotentialPairGPU<EvaluatorPairFrictionLJ>(m,
-    // "PotentialPairFrictionLJGPU");
+    detail::export_PotentialPairGPU<EvaluatorPairMLJApprox>(m, "PotentialPairMLJApproxGPU");
+    detail::export_PotentialPairGPU<EvaluatorPairWLJApprox>(m, "PotentialPairWLJApproxGPU");
+    detail::export_PotentialPairGPU<EvaluatorPairHertzianApprox>(m,
+                                                                 "PotentialPairHertzianApproxGPU");
+    detail::export_PotentialPairDPDThermoGPU<EvaluatorPairMLJDPD>(m, "PotentialPairMLJDPDGPU");
+    detail::export_PotentialPairDPDThermoGPU<EvaluatorPairWLJDPD>(m, "PotentialPairWLJDPDGPU");
+    detail::export_PotentialPairDPDThermoGPU<EvaluatorPairMLJApproxDPD>(
+        m,
+        "PotentialPairMLJApproxDPDGPU");
+    detail::export_PotentialPairDPDThermoGPU<EvaluatorPairWLJApproxDPD>(
+        m,
+        "PotentialPairWLJApproxDPDGPU");
+    detail::export_GranularPotentialPairGPU<EvaluatorPairHarmSpring>(m,
+                                                                     "PotentialPairGranularGPU");
+    detail::export_GranularPotentialPairGPU<EvaluatorPairHarmSpring,
+                                            ContactLawHookean,
+                                            RollingSpring>(m, "PotentialPairGranularHookeanGPU");
+    detail::export_GranularPotentialPairGPU<EvaluatorPairHertzian,
+                                            ContactLawHertzMindlin,
+                                            RollingTwistingSpring>(
+        m,
+        "PotentialPairGranularHertzMindlinGPU");
 #endif
     }
 
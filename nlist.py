@@ -0,0 +1,92 @@
+# Copyright (c) 2009-2022 The Regents of the University of Michigan.
+# Part of HOOMD-blue, released under the BSD 3-Clause License.
+"""Neighbor lists for the plugin pair forces."""
+
+import hoomd
+from hoomd.pair_plugin import _pair_plugin
+from hoomd.md.nlist import NeighborList
+from hoomd.data.parameterdicts import ParameterDict
+
+
+class MultiLevel(NeighborList):
+    r"""Diameter aware neighbor list for size disperse systems.
+
+    Args:
+        buffer (float): Buffer width :math:`[\mathrm{length}]`.
+        exclusions (`tuple` [`str`]): Defines which particles to exclude from
+            the neighbor list, see more details in
+            `hoomd.md.nlist.NeighborList`.
+        rebuild_check_delay (int): How often to attempt to rebuild the
+            neighbor list.
+        check_dist (bool): Flag to enable / disable distance checking.
+        level_ratio (float): Ratio of the largest to the smallest diameter in
+            one level.
+        diameter_cutoff (bool): Cut pairs off at the sum of the radii.
+        active (hoomd.filter.filter_like): Particles that move, `None`
+            when all do.
+        mesh (hoomd.mesh.Mesh): mesh data structure (optional)
+
+    `MultiLevel` sorts particles into levels by diameter and bins each level
+    into its own cell grid, sized for the largest particle in that level. With
+    ``diameter_cutoff`` set, particles :math:`i` and :math:`j` are neighbors
+    when
+
+    .. math::
+
+        r_{ij} < \min\left(r_\mathrm{cut}(i,j), \frac{d_i + d_j}{2}\right)
+        + r_\mathrm{buff}
+
+    so that small-small pairs in a mixture with a large size ratio no longer
+    see candidates sized for large-large pairs. Set ``r_cut`` of the pair
+    force to the largest contact distance of each type pair.
+
+    With ``active`` set, pairs in which neither particle is selected are left
+    out of the list, so pair forces skip contacts between the particles of a
+    frozen wall or base, and their energy and virial, entirely. Integrate
+    only the ``active`` particles to keep the others in place.
+
+    Note:
+        `MultiLevel` is only implemented on the CPU.
+
+    Attributes:
+        level_ratio (float): Ratio of the largest to the smallest diameter in
+            one level.
+        diameter_cutoff (bool): Cut pairs off at the sum of the radii.
+        active (hoomd.filter.filter_like): Particles that move, set on
+            construction only.
+    """
+
+    def __init__(self,
+                 buffer,
+                 exclusions=('bond',),
+                 rebuild_check_delay=1,
+                 check_dist=True,
+                 level_ratio=2.0,
+                 diameter_cutoff=True,
+                 active=None,
+                 mesh=None):
+        super().__init__(buffer, exclusions, rebuild_check_delay, check_dist,
+                         mesh)
+        self._param_dict.update(
+            ParameterDict(level_ratio=float(level_ratio),
+                          diameter_cutoff=bool(diameter_cutoff)))
+        self._active = active
+
+    def _attach_hook(self):
+        if isinstance(self._simulation.device, hoomd.device.GPU):
+            raise RuntimeError("MultiLevel is not implemented on the GPU.")
+        self._cpp_obj = _pair_plugin.NeighborListMultiLevel(
+            self._simulation.state._cpp_sys_def, self.buffer)
+        if self._active is not None:
+            self._cpp_obj.setActiveGroup(
+                self._simulation.state._get_group(self._active))
+        super()._attach_hook()
+
+    @property
+    def active(self):
+        return self._active
+
+    @hoomd.logging.log(requires_run=True)
+    def num_levels(self):
+        """int: Number of diameter levels used by the last build."""
+        return self._cpp_obj.num_levels
@@ -4,10 +4,12 @@
 """HOOMD plugin for a variety of pair interactions."""
 
 import copy
+import itertools
 import warnings
+import numpy
 
 from hoomd import _hoomd
-from hoomd.logging import log
+from hoomd.logging import log, Loggable
 from hoomd.md import _md, force
 from hoomd.pair_plugin import _pair_plugin
 import hoomd
@@ -20,7 +22,208 @@ import hoomd.md.pair as _pair
 validate_nlist = OnlyTypes(NeighborList)
 
 
-class ModLJ(_pair.Pair):
+def _add_dpd_thermostat(pair, keys, kT):
+    """Switch ``pair`` to its fused DPD thermostat variant when ``kT`` is set.
+
+    Adds the drag coefficient ``gamma`` to the parameter ``keys`` and the
+    ``kT`` parameter to ``pair``.
+    """
+    if kT is None:
+        return
+    pair._cpp_class_name = pair._cpp_class_name + "DPD"
+    keys["gamma"] = float
+    pair._param_dict.update(ParameterDict(kT=hoomd.variant.Variant))
+    pair.kT = kT
+
+
+class _StressProfile(metaclass=Loggable):
+    r"""Irving-Kirkwood stress profile of a pair force.
+
+    With ``profile_bins`` > 0 the box is cut into ``profile_bins`` slabs of
+    equal width normal to ``profile_axis``. Every ``profile_period`` time
+    steps, the force loop spreads the virial of each pair along the line
+    between the two particles: every slab receives the fraction of the line,
+    projected on the axis, that lies inside it. Unlike binning per-particle
+    virials, this resolves the pair stress across interfaces and shear bands
+    at the resolution of the slabs, and needs no second pass over the pairs.
+
+    `stress_profile` is the mean over all samples of the virial in each slab
+    divided by the slab volume, i.e. the configurational part of the
+    pressure tensor. Add the kinetic part to compare with
+    `hoomd.md.compute.ThermodynamicQuantities.pressure_tensor`. Slabs are
+    fixed in fractional coordinates and follow the box when it deforms.
+    The profile is computed on the CPU only.
+    """
+
+    def _add_stress_profile(self, profile_bins, profile_axis,
+                            profile_period):
+        self._param_dict.update(
+            ParameterDict(profile_bins=int(profile_bins),
+                          profile_axis=OnlyFrom(['x', 'y', 'z']),
+                          profile_period=int(profile_period)))
+        self.profile_axis = profile_axis
+
+    @property
+    def _profile_enabled(self):
+        return "profile_bins" in self._param_dict and self.profile_bins > 0
+
+    @property
+    def _type_pairs_enabled(self):
+        return ("type_pair_period" in self._param_dict
+                and self.type_pair_period > 0)
+
+    def _attach_hook(self):
+        if ((self._profile_enabled or self._type_pairs_enabled)
+                and not isinstance(self._simulation.device, hoomd.device.CPU)):
+            raise RuntimeError(
+                f"{self} computes stress profiles and type pair energies on "
+                f"the CPU only.")
+        super()._attach_hook()
+
+    @log(category="sequence", requires_run=True)
+    def stress_profile(self):
+        """(*profile_bins*, 6) `numpy.ndarray` of ``float``: Mean virial \
+        part of the pressure tensor in each slab :math:`[\\mathrm{pressure}]`.
+
+        The components are ordered like `hoomd.md.force.Force.virials`.
+        """
+        if not self._profile_enabled:
+            return numpy.zeros((0, 6))
+        return self._cpp_obj.getStressProfile()
+
+    @log(category="sequence", requires_run=True)
+    def stress_profile_centers(self):
+        """(*profile_bins*,) `numpy.ndarray` of ``float``: Slab centers \
+        along ``profile_axis`` in the current box :math:`[\\mathrm{length}]`.
+        """
+        if not self._profile_enabled:
+            return numpy.zeros(0)
+        axis = 'xyz'.index(self.profile_axis)
+        length = self._simulation.state.box.L[axis]
+        fractions = (numpy.arange(self.profile_bins) + 0.5) / self.profile_bins
+        return (fractions - 0.5) * length
+
+    @log(requires_run=True)
+    def stress_profile_samples(self):
+        """int: Number of samples of the stress profile so far."""
+        if not self._profile_enabled:
+            return 0
+        return self._cpp_obj.stress_profile_samples
+
+    def reset_stress_profile(self):
+        """Forget all samples of the stress profile."""
+        if self._attached and self._profile_enabled:
+            self._cpp_obj.resetStressProfile()
+
+    @log(category="sequence", requires_run=True)
+    def type_pair_energies(self):
+        """(*N_types*, *N_types*) `numpy.ndarray` of ``float``: Pair energy \
+        split by the types of the two particles :math:`[\\mathrm{energy}]`.
+
+        Sampled every ``type_pair_period`` time steps in the force loop; the
+        value is that of the last sample. Each pair adds half of its energy
+        to ``[a, b]`` and half to ``[b, a]``, so the matrix is symmetric,
+        ``[a, b] + [b, a]`` is the energy of all a-b pairs and the elements
+        sum to the total pair energy.
+        """
+        if not self._type_pairs_enabled:
+            n_types = len(self._simulation.state.particle_types)
+            return numpy.zeros((n_types, n_types))
+        return self._cpp_obj.getTypePairEnergies()
+
+    @log(category="sequence", requires_run=True)
+    def type_pair_virials(self):
+        """(*N_types*, *N_types*) `numpy.ndarray` of ``float``: Trace of the \
+        pair virial split by the types of the two particles \
+        :math:`[\\mathrm{energy}]`.
+
+        Sampled and split like `type_pair_energies`.
+        """
+        if not self._type_pairs_enabled:
+            n_types = len(self._simulation.state.particle_types)
+            return numpy.zeros((n_types, n_types))
+        return self._cpp_obj.getTypePairVirials()
+
+
+class _ParameterGradient:
+    """Analytic parameter gradients of a pair potential for force matching.
+
+    Subclasses name the C++ accumulator in ``_gradient_cpp_class_name``.
+    """
+
+    def parameter_gradients(self, frames):
+        r"""Accumulate force matching gradients over a set of frames.
+
+        Args:
+            frames: Iterable of ``(snapshot, reference_forces)`` tuples.
+                ``reference_forces`` is an (*N_particles*, 3) array of the
+                forces this pair potential should produce, in tag order. With
+                MPI it must be given on every rank.
+
+        Returns:
+            dict: ``loss``, the force matching loss
+            :math:`L = \sum_{\mathrm{frames}} \sum_i |\vec{F}_i -
+            \vec{F}_i^{\mathrm{ref}}|^2`; ``force_gradient`` and
+            ``energy_gradient``, (*N_types*, *N_types*, *N_params*) arrays of
+            :math:`\partial L / \partial p` and of the derivative of the total
+            energy summed over the frames, per type pair; and ``names``, the
+            parameter names in the order of the last axis.
+
+        Each frame is loaded with `hoomd.State.set_snapshot` and the forces
+        are computed with ``run(0)``. The gradients are then accumulated from
+        the analytic parameter derivatives of the potential in one pass over
+        the neighbor list, so an optimizer step costs one force evaluation
+        per frame. Afterwards the state the simulation had before the call
+        is restored and its forces recomputed, the time step is unchanged.
+        Parameters of approximate variants are fitted with the exact
+        derivatives.
+        """
+        if not self._attached:
+            raise hoomd.error.DataAccessError("parameter_gradients")
+        sim = self._simulation
+        cls = getattr(self._ext_module, self._gradient_cpp_class_name)
+        gradient = cls(sim.state._cpp_sys_def, self.nlist._cpp_obj,
+                       self._cpp_obj, self.mode)
+        types = sim.state.particle_types
+        for i, j in itertools.combinations_with_replacement(
+                range(len(types)), 2):
+            gradient.setParams(i, j, self.params[(types[i], types[j])])
+            gradient.setRCut(i, j, self.r_cut[(types[i], types[j])])
+
+        original = sim.state.get_snapshot()
+        try:
+            for snapshot, reference_forces in frames:
+                sim.state.set_snapshot(snapshot)
+                sim.run(0)
+                gradient.accumulate(numpy.asarray(reference_forces))
+        finally:
+            sim.state.set_snapshot(original)
+            sim.run(0)
+
+        return dict(loss=gradient.loss,
+                    force_gradient=gradient.force_gradient,
+                    energy_gradient=gradient.energy_gradient,
+                    names=tuple(gradient.param_names))
+
+
+def _add_profile_variant(pair, kT, profile_bins, profile_axis, profile_period,
+                         type_pair_period):
+    """Switch ``pair`` to its stress profile variant when ``profile_bins`` > 0
+    or ``type_pair_period`` > 0.
+    """
+    if profile_bins <= 0 and type_pair_period <= 0:
+        return
+    if kT is not None:
+        raise ValueError(
+            "The stress profile and type pair energies are not available "
+            "with kT.")
+    pair._cpp_class_name = pair._cpp_class_name + "Profile"
+    pair._add_stress_profile(profile_bins, profile_axis, profile_period)
+    pair._param_dict.update(
+        ParameterDict(type_pair_period=int(type_pair_period)))
+
+
+class ModLJ(_StressProfile, _ParameterGradient, _pair.Pair):
     r"""Modified Lennard-Jones pair potential to showcase an example of a pair plugin.
 
     Args:
@@ -28,6 +231,17 @@ class ModLJ(_pair.Pair):
         default_r_cut (float): Default cutoff radius :math:`[\mathrm{length}]`.
         default_r_on (float): Default turn-on radius :math:`[\mathrm{length}]`.
         mode (str): Energy shifting/smoothing mode.
+        approx (bool): Evaluate with approximate reciprocal and reciprocal
+            square root (see below).
+        kT (`hoomd.variant.Variant` or `float`): Temperature of the DPD
+            thermostat :math:`[\mathrm{energy}]`, `None` disables it.
+        profile_bins (int): Number of slabs of the stress profile, 0
+            disables it.
+        profile_axis (str): Axis normal to the slabs, ``'x'``, ``'y'`` or
+            ``'z'``.
+        profile_period (int): Time steps between stress profile samples.
+        type_pair_period (int): Time steps between samples of the type pair
+            energies, 0 disables them.
 
     `ExampleLJ` specifies that a modified Lennard-Jones pair potential should be
     applied between every non-excluded particle pair in the simulation.
@@ -43,7 +257,37 @@ class ModLJ(_pair.Pair):
         \end{eqnarray*}
 
     See `Pair` for details on how forces are calculated and the available
-    energy shifting and smoothing modes.
+    energy shifting and smoothing modes. `parameter_gradients` computes
+    analytic force matching gradients with respect to `params`.
+
+    With ``approx=True`` the square root and divisions are replaced by single
+    precision reciprocal and reciprocal square root estimates refined with
+    two Newton steps. The relative error of the repulsive and attractive terms
+    is below :math:`10^{-12} r / (r - \Delta)`.
+
+    With ``kT`` set, a DPD thermostat acts on every pair in the same
+    neighbor list loop as the potential, with
+    :math:`w(r) = 1 - r/r_{\mathrm{cut}}`:
+
+    .. math::
+
+        \vec{F}_{ij} = \left[ F_{\mathrm{C}}(r) - \gamma w(r)^2
+        (\hat{r}_{ij} \cdot \vec{v}_{ij}) + \sqrt{\frac{6 \gamma kT}
+        {\delta t}} w(r) \alpha_{ij} \right] \hat{r}_{ij}
+
+    :math:`\alpha_{ij}`, uniform in [-1, 1], is drawn from a counter based
+    random number generator keyed on the tags of the pair, the time step and
+    the simulation seed. The thermostat conserves momentum and is Galilean
+    invariant; use it with `hoomd.md.methods.ConstantVolume` without a
+    thermostat, like `hoomd.md.pair.DPD`. The drag coefficient is the
+    additional ``gamma`` key of `params`.
+
+    With ``profile_bins`` > 0 the force also samples an Irving-Kirkwood
+    stress profile, see `stress_profile`, and with ``type_pair_period`` > 0
+    the energy and virial per pair of particle types, see
+    `type_pair_energies`. Sampling steps run a neighbor list loop of this
+    plugin, all other steps the standard one. Neither is available together
+    with ``kT``.
 
     .. py:attribute:: params
 
@@ -55,6 +299,9 @@ class ModLJ(_pair.Pair):
           particle size :math:`\sigma` :math:`[\mathrm{length}]`
         * ``delta`` (`float`, **required**) -
           particle size :math:`\sigma` :math:`[\mathrm{length}]`
+        * ``gamma`` (`float`, **required** with ``kT``) -
+          drag coefficient :math:`\gamma`
+          :math:`[\mathrm{mass} \cdot \mathrm{time}^{-1}]`
 
         Type: `TypeParameter` [`tuple` [``particle_type``, ``particle_type``],
         `dict`]
@@ -69,20 +316,32 @@ class ModLJ(_pair.Pair):
 
     # Name of the potential we want to reference on the C++ side
     _cpp_class_name = "PotentialPairMLJ"
+    _gradient_cpp_class_name = "ParameterGradientMLJ"
+    _quench_cpp_class_name = "BatchQuenchMLJ"
+    _neb_cpp_class_name = "NudgedElasticBandMLJ"
+    _trajectory_cpp_class_name = "TrajectoryEvaluatorMLJ"
     _ext_module = _pair_plugin
 
     def __init__(self,
                  nlist,
                  default_r_cut=None,
                  default_r_on=0.,
-                 mode='none'):
+                 mode='none',
+                 approx=False,
+                 kT=None,
+                 profile_bins=0,
+                 profile_axis='z',
+                 profile_period=1,
+                 type_pair_period=0):
         super().__init__(nlist, default_r_cut, default_r_on, mode)
-        params = TypeParameter(
-            'params', 'particle_types',
-            TypeParameterDict(epsilon=float,
-                              sigma=float,
-                              delta=0.0,
-                              len_keys=2))
+        if approx:
+            self._cpp_class_name = type(self)._cpp_class_name + "Approx"
+        _add_profile_variant(self, kT, profile_bins, profile_axis,
+                             profile_period, type_pair_period)
+        keys = dict(epsilon=float, sigma=float, delta=0.0)
+        _add_dpd_thermostat(self, keys, kT)
+        params = TypeParameter('params', 'particle_types',
+                               TypeParameterDict(len_keys=2, **keys))
         self._add_typeparam(params)
 
 
@@ -113,7 +372,7 @@ class MLJ(ModLJ):
     pass
 
 
-class WLJ(_pair.Pair):
+class WLJ(_StressProfile, _ParameterGradient, _pair.Pair):
     r"""Modified Lennard-Jones pair potential to showcase an example of a pair plugin.
 
     Args:
@@ -121,6 +380,17 @@ class WLJ(_pair.Pair):
         default_r_cut (float): Default cutoff radius :math:`[\mathrm{length}]`.
         default_r_on (float): Default turn-on radius :math:`[\mathrm{length}]`.
         mode (str): Energy shifting/smoothing mode.
+        approx (bool): Evaluate with approximate reciprocal and reciprocal
+            square root (see below).
+        kT (`hoomd.variant.Variant` or `float`): Temperature of the DPD
+            thermostat :math:`[\mathrm{energy}]`, `None` disables it.
+        profile_bins (int): Number of slabs of the stress profile, 0
+            disables it.
+        profile_axis (str): Axis normal to the slabs, ``'x'``, ``'y'`` or
+            ``'z'``.
+        profile_period (int): Time steps between stress profile samples.
+        type_pair_period (int): Time steps between samples of the type pair
+            energies, 0 disables them.
 
     `WLJ` specifies that a modified Lennard-Jones pair potential should be
     applied between every non-excluded particle pair in the simulation.
@@ -136,7 +406,37 @@ class WLJ(_pair.Pair):
         \end{eqnarray*}
 
     See `Pair` for details on how forces are calculated and the available
-    energy shifting and smoothing modes.
+    energy shifting and smoothing modes. `parameter_gradients` computes
+    analytic force matching gradients with respect to `params`.
+
+    With ``approx=True`` the square root and divisions are replaced by single
+    precision reciprocal and reciprocal square root estimates refined with
+    two Newton steps. The relative error of the repulsive and attractive terms
+    is below :math:`10^{-12} r / (r - \Delta)`.
+
+    With ``kT`` set, a DPD thermostat acts on every pair in the same
+    neighbor list loop as the potential, with
+    :math:`w(r) = 1 - r/r_{\mathrm{cut}}`:
+
+    .. math::
+
+        \vec{F}_{ij} = \left[ F_{\mathrm{C}}(r) - \gamma w(r)^2
+        (\hat{r}_{ij} \cdot \vec{v}_{ij}) + \sqrt{\frac{6 \gamma kT}
+        {\delta t}} w(r) \alpha_{ij} \right] \hat{r}_{ij}
+
+    :math:`\alpha_{ij}`, uniform in [-1, 1], is drawn from a counter based
+    random number generator keyed on the tags of the pair, the time step and
+    the simulation seed. The thermostat conserves momentum and is Galilean
+    invariant; use it with `hoomd.md.methods.ConstantVolume` without a
+    thermostat, like `hoomd.md.pair.DPD`. The drag coefficient is the
+    additional ``gamma`` key of `params`.
+
+    With ``profile_bins`` > 0 the force also samples an Irving-Kirkwood
+    stress profile, see `stress_profile`, and with ``type_pair_period`` > 0
+    the energy and virial per pair of particle types, see
+    `type_pair_energies`. Sampling steps run a neighbor list loop of this
+    plugin, all other steps the standard one. Neither is available together
+    with ``kT``.
 
     .. py:attribute:: params
 
@@ -148,6 +448,9 @@ class WLJ(_pair.Pair):
           particle size :math:`\sigma` :math:`[\mathrm{length}]`
         * ``delta`` (`float`, **required**) -
           particle size :math:`\sigma` :math:`[\mathrm{length}]`
+        * ``gamma`` (`float`, **required** with ``kT``) -
+          drag coefficient :math:`\gamma`
+          :math:`[\mathrm{mass} \cdot \mathrm{time}^{-1}]`
 
         Type: `TypeParameter` [`tuple` [``particle_type``, ``particle_type``],
         `dict`]
@@ -162,26 +465,40 @@ class WLJ(_pair.Pair):
 
     # Name of the potential we want to reference on the C++ side
     _cpp_class_name = "PotentialPairWLJ"
+    _gradient_cpp_class_name = "ParameterGradientWLJ"
+    _quench_cpp_class_name = "BatchQuenchWLJ"
+    _neb_cpp_class_name = "NudgedElasticBandWLJ"
+    _trajectory_cpp_class_name = "TrajectoryEvaluatorWLJ"
     _ext_module = _pair_plugin
 
     def __init__(self,
                  nlist,
                  default_r_cut=None,
                  default_r_on=0.,
-                 mode='none'):
+                 mode='none',
+                 approx=False,
+                 kT=None,
+                 profile_bins=0,
+                 profile_axis='z',
+                 profile_period=1,
+                 type_pair_period=0):
         super().__init__(nlist, default_r_cut, default_r_on, mode)
-        params = TypeParameter(
-            'params', 'particle_types',
-            TypeParameterDict(epsilon=float,
-                              sigma=float,
-                              delta=0.0,
-                              epsilon_a=float,
-                              delta_a=0.0,
-                              len_keys=2))
+        if approx:
+            self._cpp_class_name = type(self)._cpp_class_name + "Approx"
+        _add_profile_variant(self, kT, profile_bins, profile_axis,
+                             profile_period, type_pair_period)
+        keys = dict(epsilon=float,
+                    sigma=float,
+                    delta=0.0,
+                    epsilon_a=float,
+                    delta_a=0.0)
+        _add_dpd_thermostat(self, keys, kT)
+        params = TypeParameter('params', 'particle_types',
+                               TypeParameterDict(len_keys=2, **keys))
         self._add_typeparam(params)
 
 
-class Hertzian(_pair.Pair):
+class Hertzian(_ParameterGradient, _pair.Pair):
     r"""Hertzian pair potential.
 
     Args:
@@ -189,9 +506,18 @@ class Hertzian(_pair.Pair):
         default_r_cut (float): Default cutoff radius :math:`[\mathrm{length}]`.
         default_r_on (float): Default turn-on radius :math:`[\mathrm{length}]`.
         mode (str): Energy shifting/smoothing mode.
+        approx (bool): Evaluate with approximate reciprocal and reciprocal
+            square root (see below).
 
     See `Pair` for details on how forces are calculated and the available
-    energy shifting and smoothing modes.
+    energy shifting and smoothing modes. `parameter_gradients` computes
+    analytic force matching gradients with respect to `params`.
+
+    With ``approx=True`` the square roots and division are replaced by a
+    single precision reciprocal square root estimate refined with one Newton
+    step. The absolute errors are below :math:`10^{-6} \varepsilon` for the
+    energy and :math:`10^{-6} \varepsilon / (\sigma r)` for the force
+    divided by :math:`r`.
 
     .. py:attribute:: params
 
@@ -217,14 +543,21 @@ class Hertzian(_pair.Pair):
 
     # Name of the potential we want to reference on the C++ side
     _cpp_class_name = "PotentialPairHertzian"
+    _gradient_cpp_class_name = "ParameterGradientHertzian"
+    _quench_cpp_class_name = "BatchQuenchHertzian"
+    _neb_cpp_class_name = "NudgedElasticBandHertzian"
+    _trajectory_cpp_class_name = "TrajectoryEvaluatorHertzian"
     _ext_module = _pair_plugin
 
     def __init__(self,
                  nlist,
                  default_r_cut=None,
                  default_r_on=0.,
-                 mode='none'):
+                 mode='none',
+                 approx=False):
         super().__init__(nlist, default_r_cut, default_r_on, mode)
+        if approx:
+            self._cpp_class_name = type(self)._cpp_class_name + "Approx"
         params = TypeParameter(
             'params', 'particle_types',
             TypeParameterDict(epsilon=float, sigma=float, len_keys=2))
@@ -328,6 +661,23 @@ class HPFPair(force.Force):
         self.ks = ks
         self.kr = kr
 
+    def _attach_hook(self):
+        self.nlist._attach(self._simulation)
+        if isinstance(self._simulation.device, hoomd.device.CPU):
+            cls = getattr(self._ext_module, self._cpp_class_name)
+        else:
+            cls = getattr(self._ext_module, self._cpp_class_name + "GPU")
+        self.nlist._cpp_obj.setStorageMode(self._nlist_storage_mode())
+        self._cpp_obj = cls(self._simulation.state._cpp_sys_def,
+                            self.nlist._cpp_obj, self.mus, self.mur, self.ks,
+                            self.kr)
+
+    def _nlist_storage_mode(self):
+        return _md.NeighborList.storageMode.half
+
+    def _detach_hook(self):
+        self.nlist._detach()
+
     def _add(self, simulation):
         super()._add(simulation)
         self._add_nlist()
@@ -394,3 +744,434 @@ class HarmHPF(HPFPair):
             'params', 'particle_types',
             TypeParameterDict(k=float, rcut=float, len_keys=2))
         self._add_typeparam(params)
+
+    @log(requires_run=True)
+    def arena_allocations(self):
+        """int: Number of times the storage of the contact history remap \
+        grew.
+
+        Stops growing once the largest neighbor list has been seen.
+        """
+        return self._cpp_obj.arena_allocations
+
+
+class Granular(_StressProfile, HPFPair):
+    r"""Granular contact force with history dependent sliding and rolling friction.
+
+    Args:
+        nlist (`hoomd.md.nlist.NeighborList`): Neighbor list.
+        default_r_cut (float): Default cutoff radius :math:`[\mathrm{length}]`.
+        mode (str): Energy shifting mode.
+        mus (float): Sliding friction coefficient.
+        mur (float): Rolling friction coefficient.
+        ks (float): Sliding friction spring constant.
+        kr (float): Rolling friction spring constant.
+        gamma_n (float): Normal damping constant.
+        mut (float): Twisting friction coefficient.
+        kt (float): Twisting friction spring constant.
+        totals_only (bool): Reduce energy and virial to totals only.
+        clumps (bool): Treat particles of one rigid body as the sub-spheres
+            of a clump.
+        active (hoomd.filter.filter_like): Particles that move, `None`
+            when all do.
+        conductivity (float): Thermal conductivity of the grains, 0
+            disables heat conduction.
+        specific_heat (float): Heat capacity per unit mass of the grains.
+        inner_skin (float): Skin of the inner contact list
+            :math:`[\mathrm{length}]`, 0 disables it.
+        force_cache_tol (float): Tolerance of the normal force cache,
+            relative to the overlap, 0 disables it.
+        packed_positions (bool): Read quantized neighbor positions in the
+            force loops.
+        num_threads (int): Number of CPU threads of the force loop, more
+            than one needs a neighbor list of its own.
+        huge_pages (bool): Back the large host arrays by transparent huge
+            pages.
+        profile_bins (int): Number of slabs of the stress profile, 0
+            disables it.
+        profile_axis (str): Axis normal to the slabs, ``'x'``, ``'y'`` or
+            ``'z'``.
+        profile_period (int): Time steps between stress profile samples.
+
+    The conservative normal force is a harmonic spring. The tangential
+    spring has a constant stiffness ``ks`` and there is no normal damping.
+    Subclasses select other contact laws, which are compiled as separate
+    C++ classes so that switching laws has no runtime cost.
+
+    .. py:attribute:: params
+
+        * ``k`` (`float`, **required**) - normal spring constant
+        * ``rcut`` (`float`, **required**) - contact distance
+
+    .. py:attribute:: gamma_n
+
+        Normal damping constant, used by the damped contact laws.
+
+    .. py:attribute:: mut
+
+        Twisting friction coefficient (`GranularHertzMindlin` only).
+
+    .. py:attribute:: kt
+
+        Twisting friction spring constant (`GranularHertzMindlin` only).
+
+    .. py:attribute:: totals_only
+
+        When `True`, the energy and virial are only accumulated into totals,
+        which are reported through `additional_energy` and
+        `additional_virial`, and the per-particle energy and virial writes
+        are skipped. Total energy and pressure are unchanged. When a
+        writer's logger includes `energies` or `virials` of this force as
+        the simulation starts, ``totals_only`` is set to `False` before the
+        first step, so every logged frame is valid. Otherwise, reading
+        `energies` or `virials` switches back to per-particle output, which
+        is valid from the next time step on. The totals are computed by the
+        single threaded loop, whatever ``num_threads`` is. Single rank CPU
+        simulations only; setting it under domain decomposition or on the
+        GPU raises an error.
+
+    .. py:attribute:: clumps
+
+        When `True`, particles that belong to the same rigid body (see
+        `hoomd.md.constrain.Rigid`) are sub-spheres of one clump: pairs
+        within a clump are skipped, and every sub-sphere moves with the
+        velocity :math:`\vec{v}_c + \vec{\omega}_c \times (\vec{r}_i -
+        \vec{r}_c)` and angular velocity :math:`\vec{\omega}_c` of its
+        central particle, which the damping and friction forces use. Forces
+        and torques on the sub-spheres are moved onto the central particle
+        as they are computed; energies and virials stay on the sub-spheres.
+        The contact history is kept per pair of sub-spheres. Add ``'body'``
+        to the neighbor list exclusions so that pairs within a clump are not
+        stored in the first place. CPU only.
+
+    .. py:attribute:: active
+
+        Particles that move, or `None` when all do. Pairs in which neither
+        particle is active, such as two grains of a frozen wall or base, are
+        skipped: they are dropped from the inner contact list when it is
+        built, skipped by the force loops otherwise, and keep no contact
+        history. Their forces, energies and virials are left out. In wall
+        heavy setups the force loops shrink by the fraction of frozen pairs;
+        `hoomd.pair_plugin.nlist.MultiLevel` with the same ``active`` filter
+        leaves them out of the neighbor list too. Set on construction only.
+        CPU only.
+
+        Type: `hoomd.filter.filter_like`
+
+    .. py:attribute:: conductivity
+
+        When positive, every particle carries a temperature :math:`T_i` (see
+        `temperatures`) and heat flows through each contact at the rate
+
+        .. math::
+
+            Q_{ij} = 2 k a_{ij} (T_j - T_i), \quad
+            a_{ij} = \sqrt{\frac{r_i r_j}{r_i + r_j} \delta_{ij}},
+
+        with the Hertzian contact radius :math:`a_{ij}` of the overlap
+        :math:`\delta_{ij}` = ``rcut`` :math:`- r`. The flow is accumulated in
+        the contact loop and the temperatures take an explicit Euler step
+        :math:`T_i \leftarrow T_i + \Delta t \sum_j Q_{ij} / (m_i c)` with
+        :math:`c` = ``specific_heat`` after it; massless particles keep their
+        temperature. Temperatures do not affect the forces. The temperature
+        of a particle is stored as its charge, so it moves with the particle
+        between ranks and is written to GSD files with the charges. The
+        charges must not be used by any other force. CPU only.
+
+    .. py:attribute:: specific_heat
+
+        Heat capacity per unit mass :math:`c` of the grains.
+
+    .. py:attribute:: inner_skin
+
+        When positive, the force loop only visits pairs within ``rcut`` plus
+        ``inner_skin``, taken from the neighbor list. This inner list is
+        rebuilt with the neighbor list and whenever a particle has moved more
+        than half of ``inner_skin`` since the last build. Choose it smaller
+        than the neighbor list buffer; in dense, slowly evolving packings
+        the per-step pair count drops by roughly the ratio of buffered to
+        contacting pairs. Forces are identical to ``inner_skin=0``. The
+        inner list stores 32 bits per pair, with neighbor indices relative
+        to the particle, so sorted systems mostly skip the neighbor list
+        reads; it supports at most 65536 neighbors per particle.
+
+    .. py:attribute:: force_cache_tol
+
+        When positive, the conservative normal force of each contact is
+        cached together with its separation :math:`r_c` and overlap
+        :math:`\delta_c = r_\mathrm{cut} - r_c`, and reused while
+        :math:`|r - r_c| \le \mathrm{tol} \, \delta_c`. The force
+        direction, the damping and the friction history are always computed
+        from the current configuration. Meant for quasi-static protocols,
+        where most contacts barely move between steps; the normal force
+        error is bounded by the change of the force over a separation change
+        of ``force_cache_tol`` times the overlap, which for a linear spring
+        is ``force_cache_tol`` times the force, also for nearly touching
+        pairs.
+
+    .. py:attribute:: packed_positions
+
+        When `True`, the positions of the local and ghost particles are
+        quantized once per step into 32 bit fixed point fractional
+        coordinates of the box, stored with the type in 16 bytes, and the
+        force loops read these instead of the 32 byte double precision
+        positions for every neighbor. Separations follow from the wrapped
+        difference of the fixed point coordinates, which is already the
+        minimum image, and are accurate to :math:`L / 2^{32}` per box length
+        :math:`L`. Meant for large, bandwidth bound systems; forces agree
+        with ``packed_positions=False`` to that accuracy. CPU only.
+
+    .. py:attribute:: num_threads
+
+        Number of CPU threads of the force loop. With more than one, every
+        particle computes its own contacts with the same code as the GPU
+        kernel, so threads never write to the same particle. This needs a
+        neighbor list in full storage mode: give the pair a neighbor list
+        that no other force uses, which is switched to full storage when the
+        pair attaches. Attaching with a shared list raises an error, as does
+        going from one thread to more after attaching with one. The threads
+        are started when ``num_threads`` is set and reused every step. The
+        force cache is a feature of the single threaded loop; setting
+        ``force_cache_tol`` or ``totals_only`` keeps that loop.
+
+        Every thread is pinned to its own share of the CPUs the process may
+        run on, and the pages of the contact history, the angular velocities
+        and the contact lists are first touched by the thread that reads them
+        in the force loop, so on multi-socket machines every thread works on
+        memory of its own NUMA node. Placement is redone whenever these arrays
+        grow. It is skipped in HOOMD builds with GPU support, where the host
+        arrays may be pinned or managed memory.
+
+    .. py:attribute:: huge_pages
+
+        When `True`, the large host arrays are marked for transparent huge
+        pages with ``madvise``, which reduces TLB misses for large systems.
+        The kernel may ignore the hint, depending on
+        ``/sys/kernel/mm/transparent_hugepage/enabled``. Linux only, ignored
+        in HOOMD builds with GPU support.
+
+    .. py:attribute:: profile_bins
+
+        When positive, the force loop samples an Irving-Kirkwood stress
+        profile of the contact forces every ``profile_period`` time steps,
+        see `stress_profile`. The pair virial includes the tangential
+        friction forces. Sampling steps use the single threaded loop.
+    """
+
+    _cpp_class_name = "PotentialPairGranular"
+    _ext_module = _pair_plugin
+
+    def __init__(self,
+                 nlist,
+                 default_r_cut=None,
+                 mode='none',
+                 mus=0.0,
+                 mur=0.0,
+                 ks=0.0,
+                 kr=0.0,
+                 gamma_n=0.0,
+                 mut=0.0,
+                 kt=0.0,
+                 totals_only=False,
+                 clumps=False,
+                 active=None,
+                 conductivity=0.0,
+                 specific_heat=1.0,
+                 inner_skin=0.0,
+                 force_cache_tol=0.0,
+                 packed_positions=False,
+                 num_threads=1,
+                 huge_pages=False,
+                 profile_bins=0,
+                 profile_axis='z',
+                 profile_period=1):
+        super().__init__(nlist, default_r_cut, mode, mus, mur, ks, kr)
+        self._add_normal_params()
+        self._param_dict.update(
+            ParameterDict(gamma_n=float(gamma_n),
+                          mut=float(mut),
+                          kt=float(kt),
+                          totals_only=bool(totals_only),
+                          clumps=bool(clumps),
+                          conductivity=float(conductivity),
+                          specific_heat=float(specific_heat),
+                          inner_skin=float(inner_skin),
+                          force_cache_tol=float(force_cache_tol),
+                          packed_positions=bool(packed_positions),
+                          num_threads=int(num_threads),
+                          huge_pages=bool(huge_pages)))
+        self._add_stress_profile(profile_bins, profile_axis, profile_period)
+        self._active = active
+
+    def _add_normal_params(self):
+        params = TypeParameter(
+            'params', 'particle_types',
+            TypeParameterDict(k=float, rcut=float, len_keys=2))
+        self._add_typeparam(params)
+
+    def _nlist_storage_mode(self):
+        if (self.num_threads == 1
+                or not isinstance(self._simulation.device, hoomd.device.CPU)):
+            return super()._nlist_storage_mode()
+        # full storage would also change the loops of the other forces
+        shared = [op for op in self.nlist._dependents if op is not self]
+        if shared:
+            raise RuntimeError(
+                f"{self} with num_threads > 1 needs a neighbor list of its "
+                f"own, its list is also used by {shared}.")
+        return _md.NeighborList.storageMode.full
+
+    def _attach_hook(self):
+        super()._attach_hook()
+        if self._active is not None:
+            self._cpp_obj.setActiveGroup(
+                self._simulation.state._get_group(self._active))
+        # the first logged frame would hold zeros, switch before the run
+        if self.totals_only and self._per_particle_logged():
+            self.totals_only = False
+
+    def _per_particle_logged(self):
+        for writer in self._simulation.operations.writers:
+            logger = getattr(writer, "logger", None)
+            if logger is None:
+                continue
+            for namespace in logger:
+                entry = logger[namespace]
+                if (getattr(entry, "obj", None) is self
+                        and getattr(entry, "attr", None)
+                        in ("energies", "virials")):
+                    return True
+        return False
+
+    @property
+    def active(self):
+        return self._active
+
+    def _fall_back_to_per_particle(self):
+        if self._attached and self.totals_only:
+            warnings.warn(
+                f"{self} per-particle energy or virial requested with "
+                f"totals_only=True; switching to per-particle output, valid "
+                f"from the next time step.", RuntimeWarning)
+            self.totals_only = False
+
+    @log(category="particle", requires_run=True)
+    def energies(self):
+        """(*N_particles*, ) `numpy.ndarray` of ``float``: Energy \
+        contribution :math:`U_i` from each particle :math:`[\\mathrm{energy}]`.
+        """
+        self._fall_back_to_per_particle()
+        return super().energies
+
+    @log(category="particle", requires_run=True)
+    def virials(self):
+        """(*N_particles*, 6) `numpy.ndarray` of ``float``: Virial tensor \
+        contribution :math:`W_i` from each particle :math:`[\\mathrm{energy}]`.
+        """
+        self._fall_back_to_per_particle()
+        return super().virials
+
+    @log(requires_run=True)
+    def inner_list_builds(self):
+        """int: Number of inner contact list builds so far."""
+        return self._cpp_obj.inner_list_builds
+
+    @log(category="particle", requires_run=True)
+    def temperatures(self):
+        """(*N_particles*, ) `numpy.ndarray` of ``float``: Temperature of \
+        each particle, indexed by tag.
+
+        Gathered from the particle charges of all ranks when read.
+        """
+        return self._cpp_obj.getTemperatures()
+
+    def set_temperatures(self, temperatures):
+        """Set the temperature of every particle.
+
+        Args:
+            temperatures ((*N_particles*, ) `numpy.ndarray` of `float`):
+                Temperatures, indexed by tag.
+
+        Overwrites the particle charges. Particles inserted later start at
+        temperature 0.
+        """
+        if not self._attached:
+            raise hoomd.error.DataAccessError("set_temperatures")
+        self._cpp_obj.setTemperatures(
+            numpy.asarray(temperatures, dtype=numpy.float64))
+
+    def insert(self, position, type, diameter=1.0, velocity=(0.0, 0.0, 0.0)):
+        """Insert particles into the running simulation.
+
+        Args:
+            position ((*N*, 3) `numpy.ndarray` of `float`): Positions.
+            type (str): Particle type of the new particles.
+            diameter (float or (*N*,) `numpy.ndarray`): Diameters.
+            velocity ((3,) or (*N*, 3) `numpy.ndarray`): Velocities.
+
+        Returns:
+            (*N*,) `numpy.ndarray` of `int`: Tags of the new particles.
+
+        New particles start with no contact history, even when HOOMD reuses
+        the tag of a previously removed particle. Contacts between existing
+        particles keep their history across the insertion.
+        """
+        if not self._attached:
+            raise hoomd.error.DataAccessError("insert")
+        position = numpy.array(position, dtype=numpy.float64, ndmin=2)
+        n = position.shape[0]
+        type_id = self._simulation.state.particle_types.index(type)
+        type_id = numpy.full(n, type_id, dtype=numpy.uint32)
+        diameter = numpy.broadcast_to(
+            numpy.asarray(diameter, dtype=numpy.float64), (n,))
+        velocity = numpy.broadcast_to(
+            numpy.asarray(velocity, dtype=numpy.float64), (n, 3))
+        return self._cpp_obj.insertParticles(position, type_id, diameter,
+                                             velocity)
+
+    def remove(self, tags):
+        """Remove particles from the running simulation.
+
+        Args:
+            tags ((*N*,) `numpy.ndarray` of `int`): Tags of the particles to
+                remove.
+
+        Contact history of all remaining pairs is preserved.
+        """
+        if not self._attached:
+            raise hoomd.error.DataAccessError("remove")
+        self._cpp_obj.removeParticles(
+            numpy.array(tags, dtype=numpy.uint32, ndmin=1))
+
+
+class GranularHookean(Granular):
+    r"""Granular contact force with a Hookean spring-dashpot contact law.
+
+    Same as `Granular`, with a viscous normal dashpot
+    :math:`\vec{F}_n^d = -\gamma_n (\vec{v}_{ij} \cdot \hat{n}) \hat{n}`.
+    """
+
+    _cpp_class_name = "PotentialPairGranularHookean"
+
+
+class GranularHertzMindlin(Granular):
+    r"""Granular contact force with a Hertz-Mindlin contact law.
+
+    The normal force is Hertzian, the tangential stiffness is
+    :math:`k_s \sqrt{a_{ij} \delta}` and the normal dashpot scales as
+    :math:`\gamma_n (a_{ij} \delta)^{1/4}`, where :math:`\delta` is the
+    overlap. Rolling and twisting resistance are both active.
+
+    .. py:attribute:: params
+
+        * ``epsilon`` (`float`, **required**) - energy parameter
+        * ``sigma`` (`float`, **required**) - contact distance
+    """
+
+    _cpp_class_name = "PotentialPairGranularHertzMindlin"
+
+    def _add_normal_params(self):
+        params = TypeParameter(
+            'params', 'particle_types',
+            TypeParameterDict(epsilon=float, sigma=float, len_keys=2))
+        self._add_typeparam(params)
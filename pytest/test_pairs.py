@@ -153,3 +153,1115 @@ def test_force_and_energy_eval(simulation_factory,
     energies = example_pair.energies
     if snap.communicator.rank == 0:
         np.testing.assert_array_almost_equal(energies, [e, e], decimal=4)
+
+
+# The approximate evaluators must stay within their documented error bounds
+# (see ApproxMath.h): 1e-6 in the natural scale of the Hertzian force and
+# energy, and round-off level for MLJ/WLJ which use two Newton steps.
+approx_distances = np.linspace(0.55, 1.45, 7)
+approx_params = [
+    (Hertzian, {"epsilon": 1.5, "sigma": 1.5}, 1.5, 1e-6, 0.0),
+    (MLJ, {"epsilon": 1.0, "sigma": 0.5, "delta": 0.4}, 1.25, 1e-9, 1e-10),
+    (WLJ, {"epsilon": 1.0, "sigma": 0.5, "delta": 0.4, "epsilon_a": 0.5,
+           "delta_a": 0.2}, 1.25, 1e-9, 1e-10),
+]
+
+
+@pytest.mark.parametrize("distance, params",
+                         itertools.product(approx_distances, approx_params))
+def test_approx_error_bound(simulation_factory, two_particle_snapshot_factory,
+                            distance, params):
+    pair, pair_params, r_cut, atol, rtol = params
+    sim = simulation_factory(two_particle_snapshot_factory(d=distance))
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    exact_pair = pair(cell, default_r_cut=r_cut)
+    approx_pair = pair(cell, default_r_cut=r_cut, approx=True)
+    exact_pair.params[("A", "A")] = pair_params
+    approx_pair.params[("A", "A")] = pair_params
+    integrator.forces = [exact_pair, approx_pair]
+    integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+    sim.operations.integrator = integrator
+
+    sim.run(0)
+
+    # scale of the force and energy, the Hertzian bounds are absolute in it
+    energy_scale = pair_params["epsilon"]
+    force_scale = energy_scale / pair_params["sigma"]
+
+    forces = exact_pair.forces
+    approx_forces = approx_pair.forces
+    energies = exact_pair.energies
+    approx_energies = approx_pair.energies
+    if sim.device.communicator.rank == 0:
+        np.testing.assert_allclose(approx_forces,
+                                   forces,
+                                   rtol=rtol,
+                                   atol=atol * force_scale)
+        np.testing.assert_allclose(approx_energies,
+                                   energies,
+                                   rtol=rtol,
+                                   atol=atol * energy_scale)
+
+
+# Two grains of diameter 1 at d = 0.9 approach along x at relative speed 2u
+# and slide past each other along y at 2w: the contact diameter is
+# a = 2 r_i r_j / (r_i + r_j) = 0.5 and the overlap 0.1. Without integration
+# methods they stay in place, so the sliding history is zero in the first
+# evaluation and dt (0, -2w, 0) in the second.
+contact_a, contact_overlap = 0.5, 0.1
+contact_laws = [
+    (GranularHookean, dict(k=10.0, rcut=1.0), 10.0 * contact_overlap, 0.5,
+     5.0),
+    (GranularHertzMindlin, dict(epsilon=10.0, sigma=1.0),
+     10.0 * contact_overlap**1.5, 0.5 * (contact_a * contact_overlap)**0.25,
+     5.0 * (contact_a * contact_overlap)**0.5),
+]
+
+
+@pytest.mark.parametrize("pair, pair_params, normal, damping, stiffness",
+                         contact_laws)
+def test_granular_contact_laws(simulation_factory,
+                               two_particle_snapshot_factory, pair,
+                               pair_params, normal, damping, stiffness):
+    u, w, dt = 0.01, 0.02, 0.001
+    snapshot = two_particle_snapshot_factory(d=0.9)
+    if snapshot.communicator.rank == 0:
+        snapshot.particles.velocity[:] = [[u, w, 0.0], [-u, -w, 0.0]]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=dt)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    contact_pair = pair(cell, default_r_cut=1.0, mus=100.0, ks=5.0,
+                        gamma_n=0.5)
+    contact_pair.params[("A", "A")] = pair_params
+    integrator.forces = [contact_pair]
+    sim.operations.integrator = integrator
+
+    # particle 0 is on the left: the spring and the dashpot push it to -x
+    f_normal = -(normal + 2 * u * damping)
+
+    sim.run(0)
+    forces = contact_pair.forces
+    if sim.device.communicator.rank == 0:
+        np.testing.assert_allclose(forces,
+                                   [[f_normal, 0.0, 0.0],
+                                    [-f_normal, 0.0, 0.0]],
+                                   rtol=1e-10,
+                                   atol=1e-14)
+
+    # the sliding spring opposes the relative motion of each grain
+    f_slide = -2 * w * dt * stiffness
+
+    sim.run(1)
+    forces = contact_pair.forces
+    if sim.device.communicator.rank == 0:
+        np.testing.assert_allclose(forces,
+                                   [[f_normal, f_slide, 0.0],
+                                    [-f_normal, -f_slide, 0.0]],
+                                   rtol=1e-10,
+                                   atol=1e-14)
+
+
+# Totals published as the external energy and virial must give the same
+# energy and pressure as the per-particle sums, in either loop.
+@pytest.mark.parametrize("num_threads", [1, 2])
+def test_granular_totals_only(simulation_factory,
+                              two_particle_snapshot_factory, num_threads):
+    results = []
+    for totals_only in (False, True):
+        sim = simulation_factory(two_particle_snapshot_factory(d=0.9))
+
+        integrator = hoomd.md.Integrator(dt=0.001)
+        cell = hoomd.md.nlist.Cell(buffer=0.4)
+        pair = Granular(cell,
+                        default_r_cut=1.0,
+                        totals_only=totals_only,
+                        num_threads=num_threads)
+        pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+        integrator.forces = [pair]
+        integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+        sim.operations.integrator = integrator
+        thermo = hoomd.md.compute.ThermodynamicQuantities(hoomd.filter.All())
+        sim.operations.computes.append(thermo)
+
+        if totals_only and sim.device.communicator.num_ranks > 1:
+            with pytest.raises(RuntimeError):
+                sim.run(0)
+            return
+
+        sim.run(0)
+        results.append((pair.energy, thermo.potential_energy, thermo.pressure,
+                        thermo.pressure_tensor))
+
+    (energy, potential_energy, pressure, pressure_tensor), totals = results
+    assert energy > 0.0
+    assert totals[0] == pytest.approx(energy, rel=1e-12)
+    assert totals[1] == pytest.approx(potential_energy, rel=1e-12)
+    assert totals[2] == pytest.approx(pressure, rel=1e-12)
+    np.testing.assert_allclose(totals[3], pressure_tensor, atol=1e-12)
+
+
+# Per-particle energies logged by a writer with totals_only=True must match
+# the per-particle run from the first frame on.
+def test_granular_totals_only_logged_energies(simulation_factory,
+                                              two_particle_snapshot_factory,
+                                              device, tmp_path):
+    gsd_hoomd = pytest.importorskip("gsd.hoomd")
+    if isinstance(device, hoomd.device.GPU):
+        pytest.skip("totals_only is CPU only")
+    if device.communicator.num_ranks > 1:
+        pytest.skip("totals_only is single rank only")
+
+    logged = []
+    for totals_only in (False, True):
+        snapshot = two_particle_snapshot_factory(d=0.9)
+        if snapshot.communicator.rank == 0:
+            snapshot.particles.velocity[:] = [[0.05, 0.0, 0.0],
+                                              [-0.05, 0.0, 0.0]]
+        sim = simulation_factory(snapshot)
+
+        integrator = hoomd.md.Integrator(dt=0.001)
+        cell = hoomd.md.nlist.Cell(buffer=0.4)
+        pair = Granular(cell, default_r_cut=1.0, totals_only=totals_only)
+        pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+        integrator.forces = [pair]
+        integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+        sim.operations.integrator = integrator
+
+        logger = hoomd.logging.Logger(categories=["particle"])
+        logger.add(pair, quantities=["energies"])
+        filename = str(tmp_path / f"totals_only_{totals_only}.gsd")
+        writer = hoomd.write.GSD(filename=filename,
+                                 trigger=hoomd.trigger.Periodic(1),
+                                 mode="wb",
+                                 filter=hoomd.filter.Null(),
+                                 logger=logger)
+        sim.operations.writers.append(writer)
+
+        sim.run(3)
+        assert not pair.totals_only
+        writer.flush()
+        with gsd_hoomd.open(filename, mode="r") as traj:
+            logged.append([
+                frame.log[key]
+                for frame in traj
+                for key in frame.log
+                if key.endswith("/energies")
+            ])
+
+    per_particle, totals_only = logged
+    assert len(per_particle) == 3
+    assert np.all(per_particle[0] > 0.0)
+    np.testing.assert_allclose(totals_only, per_particle, rtol=1e-12)
+
+
+# The cached normal force may lag the exact one by at most the force change
+# over a separation change of force_cache_tol times the overlap, which for the
+# spring is force_cache_tol times the normal force, and the Coulomb limit of
+# the sliding force follows it (factor (1 + mus) / (1 - tol) < 2). The nearly
+# touching pair checks that the bound holds relative to a small force.
+@pytest.mark.parametrize("force_cache_tol", [1e-4, 1e-2])
+@pytest.mark.parametrize("d", [0.9, 0.999])
+def test_granular_force_cache(simulation_factory, two_particle_snapshot_factory,
+                              force_cache_tol, d):
+    snapshot = two_particle_snapshot_factory(d=d)
+    if snapshot.communicator.rank == 0:
+        snapshot.particles.velocity[:] = [[0.05, 0.02, 0.0],
+                                          [-0.05, -0.02, 0.0]]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    k, rcut = 10.0, 1.0
+    exact_pair = Granular(cell, default_r_cut=rcut, mus=0.5, ks=5.0)
+    cached_pair = Granular(cell,
+                           default_r_cut=rcut,
+                           mus=0.5,
+                           ks=5.0,
+                           force_cache_tol=force_cache_tol)
+    exact_pair.params[("A", "A")] = dict(k=k, rcut=rcut)
+    cached_pair.params[("A", "A")] = dict(k=k, rcut=rcut)
+    integrator.forces = [exact_pair, cached_pair]
+    integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+    sim.operations.integrator = integrator
+
+    for _ in range(10):
+        sim.run(10)
+        forces = exact_pair.forces
+        cached_forces = cached_pair.forces
+        snapshot = sim.state.get_snapshot()
+        if sim.device.communicator.rank == 0:
+            position = snapshot.particles.position
+            overlap = rcut - np.linalg.norm(position[1] - position[0])
+            assert overlap > 0
+            np.testing.assert_allclose(cached_forces,
+                                       forces,
+                                       rtol=0,
+                                       atol=2 * force_cache_tol * k * overlap
+                                       + 1e-12)
+
+
+# The inner contact list only skips pairs that cannot touch before it is
+# rebuilt, so forces match the full neighbor list through the rebuilds of
+# both lists.
+def test_granular_inner_skin(simulation_factory, lattice_snapshot_factory):
+    snapshot = lattice_snapshot_factory(n=5, a=0.95)
+    if snapshot.communicator.rank == 0:
+        rng = np.random.default_rng(3)
+        snapshot.particles.velocity[:] = rng.normal(
+            scale=0.5, size=(snapshot.particles.N, 3))
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    kwargs = dict(default_r_cut=1.0, mus=0.5, ks=5.0, gamma_n=0.5)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    full_pair = GranularHookean(cell, **kwargs)
+    inner_pair = GranularHookean(hoomd.md.nlist.Cell(buffer=0.4),
+                                 inner_skin=0.1,
+                                 **kwargs)
+    full_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    inner_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [full_pair, inner_pair]
+    integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+    sim.operations.integrator = integrator
+
+    for _ in range(10):
+        sim.run(50)
+        forces = full_pair.forces
+        inner_forces = inner_pair.forces
+        if sim.device.communicator.rank == 0:
+            np.testing.assert_allclose(inner_forces,
+                                       forces,
+                                       rtol=1e-10,
+                                       atol=1e-12)
+    assert cell.num_builds > 1
+
+
+# Neighbors more than 32767 particles away from i in the particle order are
+# escaped in the 16-bit inner list and read from the neighbor list. Without
+# sorting, the last particle of the lattice touches the first.
+@pytest.mark.parametrize("num_threads", [1, 2])
+def test_granular_inner_skin_far_neighbor(simulation_factory,
+                                          lattice_snapshot_factory,
+                                          num_threads):
+    snapshot = lattice_snapshot_factory(n=33, a=1.2)
+    if snapshot.communicator.rank == 0:
+        N = snapshot.particles.N
+        assert N > 32768
+        rng = np.random.default_rng(5)
+        snapshot.particles.velocity[:] = rng.normal(scale=0.1, size=(N, 3))
+        snapshot.particles.position[N - 1] = (
+            snapshot.particles.position[0] + [0.6, 0.6, 0.0])
+    sim = simulation_factory(snapshot)
+    sim.operations.tuners.clear()
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    kwargs = dict(default_r_cut=1.0,
+                  mus=0.5,
+                  ks=5.0,
+                  gamma_n=0.5,
+                  num_threads=num_threads)
+    full_pair = GranularHookean(hoomd.md.nlist.Cell(buffer=0.4), **kwargs)
+    inner_pair = GranularHookean(hoomd.md.nlist.Cell(buffer=0.4),
+                                 inner_skin=0.1,
+                                 **kwargs)
+    full_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    inner_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [full_pair, inner_pair]
+    sim.operations.integrator = integrator
+
+    sim.run(5)
+    forces = full_pair.forces
+    inner_forces = inner_pair.forces
+    if sim.device.communicator.rank == 0:
+        assert np.linalg.norm(forces[-1]) > 0
+        np.testing.assert_allclose(inner_forces,
+                                   forces,
+                                   rtol=1e-10,
+                                   atol=1e-12)
+
+
+# The threaded engine runs the single source body shared with the GPU kernel
+# on a full list of its own, it must agree with the serial loop on a half
+# list to round-off. Page placement of its arrays must not change their
+# contents.
+@pytest.mark.parametrize("pair", [Granular, GranularHookean])
+def test_granular_threaded_engine(simulation_factory,
+                                  two_particle_snapshot_factory, pair):
+    snapshot = two_particle_snapshot_factory(d=0.9)
+    if snapshot.communicator.rank == 0:
+        snapshot.particles.velocity[:] = [[0.05, 0.02, 0.0],
+                                          [-0.05, -0.02, 0.01]]
+        snapshot.particles.moment_inertia[:] = [[0.1, 0.1, 0.1]] * 2
+        snapshot.particles.angmom[:] = [[0.0, 0.0, 0.0, 0.01],
+                                        [0.0, 0.01, 0.0, 0.0]]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001, integrate_rotational_dof=True)
+    kwargs = dict(default_r_cut=1.0, mus=0.5, mur=0.1, ks=5.0, kr=1.0,
+                  gamma_n=0.5)
+    serial_pair = pair(hoomd.md.nlist.Cell(buffer=0.4), **kwargs)
+    threaded_pair = pair(hoomd.md.nlist.Cell(buffer=0.4),
+                         num_threads=2,
+                         huge_pages=True,
+                         **kwargs)
+    serial_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    threaded_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [serial_pair, threaded_pair]
+    integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+    sim.operations.integrator = integrator
+
+    for _ in range(5):
+        sim.run(10)
+        forces = serial_pair.forces
+        torques = serial_pair.torques
+        threaded_forces = threaded_pair.forces
+        threaded_torques = threaded_pair.torques
+        if sim.device.communicator.rank == 0:
+            np.testing.assert_allclose(threaded_forces, forces, atol=1e-12)
+            np.testing.assert_allclose(threaded_torques, torques, atol=1e-12)
+
+
+# The threaded engine needs full storage, which it must not force on a list
+# that another force uses.
+def test_granular_threads_shared_nlist(simulation_factory,
+                                       two_particle_snapshot_factory):
+    sim = simulation_factory(two_particle_snapshot_factory(d=0.9))
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    serial_pair = Granular(cell, default_r_cut=1.0)
+    threaded_pair = Granular(cell, default_r_cut=1.0, num_threads=2)
+    serial_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    threaded_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [serial_pair, threaded_pair]
+    sim.operations.integrator = integrator
+
+    if isinstance(sim.device, hoomd.device.CPU):
+        with pytest.raises(RuntimeError):
+            sim.run(0)
+
+
+# Quantized positions resolve separations to L / 2^32, so both loops must
+# agree with the full precision path far below the force scale.
+@pytest.mark.parametrize("num_threads", [1, 2])
+def test_granular_packed_positions(simulation_factory,
+                                   two_particle_snapshot_factory, num_threads):
+    snapshot = two_particle_snapshot_factory(d=0.9)
+    if snapshot.communicator.rank == 0:
+        snapshot.particles.velocity[:] = [[0.05, 0.02, 0.0],
+                                          [-0.05, -0.02, 0.01]]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    kwargs = dict(default_r_cut=1.0, mus=0.5, ks=5.0, num_threads=num_threads)
+    exact_pair = Granular(hoomd.md.nlist.Cell(buffer=0.4), **kwargs)
+    packed_pair = Granular(hoomd.md.nlist.Cell(buffer=0.4),
+                           packed_positions=True,
+                           **kwargs)
+    exact_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    packed_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [exact_pair, packed_pair]
+    integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+    sim.operations.integrator = integrator
+
+    for _ in range(5):
+        sim.run(10)
+        forces = exact_pair.forces
+        packed_forces = packed_pair.forces
+        if sim.device.communicator.rank == 0:
+            np.testing.assert_allclose(packed_forces, forces, atol=1e-6)
+
+
+# Sub-spheres of one clump do not interact, and the contact force on a
+# sub-sphere ends up on the central particle together with its torque.
+def test_granular_clumps(simulation_factory, device):
+    snapshot = hoomd.Snapshot(device.communicator)
+    if snapshot.communicator.rank == 0:
+        snapshot.configuration.box = [10, 10, 10, 0, 0, 0]
+        snapshot.particles.N = 3
+        snapshot.particles.types = ["A"]
+        snapshot.particles.position[:] = [[0.0, 0.0, 0.0], [0.8, 0.0, 0.0],
+                                          [1.6, 0.3, 0.0]]
+        snapshot.particles.body[:] = [0, 0, -1]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    sphere_pair = Granular(cell, default_r_cut=1.0)
+    clump_pair = Granular(cell, default_r_cut=1.0, clumps=True)
+    sphere_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    clump_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [sphere_pair, clump_pair]
+    sim.operations.integrator = integrator
+
+    sim.run(0)
+
+    sphere_forces = sphere_pair.forces
+    forces = clump_pair.forces
+    torques = clump_pair.torques
+    if sim.device.communicator.rank == 0:
+        # the free particle only touches the sub-sphere in both computes
+        f_free = sphere_forces[2]
+        np.testing.assert_allclose(forces[2], f_free, atol=1e-12)
+        np.testing.assert_allclose(forces[1], [0.0, 0.0, 0.0], atol=1e-12)
+        np.testing.assert_allclose(forces[0], -f_free, atol=1e-12)
+        np.testing.assert_allclose(torques[0],
+                                   np.cross([0.8, 0.0, 0.0], -f_free),
+                                   atol=1e-12)
+
+
+def test_granular_active(simulation_factory, device):
+    snapshot = hoomd.Snapshot(device.communicator)
+    if snapshot.communicator.rank == 0:
+        snapshot.configuration.box = [10, 10, 10, 0, 0, 0]
+        snapshot.particles.N = 3
+        snapshot.particles.types = ["A"]
+        snapshot.particles.position[:] = [[0.0, 0.0, 0.0], [0.8, 0.0, 0.0],
+                                          [1.6, 0.3, 0.0]]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    all_pair = Granular(cell, default_r_cut=1.0)
+    active_pair = Granular(cell,
+                           default_r_cut=1.0,
+                           active=hoomd.filter.Tags([2]))
+    all_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    active_pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [all_pair, active_pair]
+    sim.operations.integrator = integrator
+
+    sim.run(0)
+
+    all_forces = all_pair.forces
+    forces = active_pair.forces
+    if sim.device.communicator.rank == 0:
+        # the wall pair (0, 1) is skipped, the mobile contact (1, 2) is not
+        f_free = all_forces[2]
+        np.testing.assert_allclose(forces[2], f_free, atol=1e-12)
+        np.testing.assert_allclose(forces[1], -f_free, atol=1e-12)
+        np.testing.assert_allclose(forces[0], [0.0, 0.0, 0.0], atol=1e-12)
+
+
+# MultiLevel bins every diameter level into its own grid, it must find the
+# same pairs and forces as the cell list in a size disperse system and skip
+# the bonded pairs. The Hertzian pairs are cut off at contact, where
+# diameter_cutoff cuts as well.
+@pytest.mark.parametrize("diameter_cutoff", [False, True])
+def test_multilevel_matches_cell(simulation_factory, device, diameter_cutoff):
+    if isinstance(device, hoomd.device.GPU):
+        pytest.skip("MultiLevel is CPU only")
+
+    diameters = {"S": 0.5, "M": 1.0, "L": 3.0}
+    n_bonds = 50
+    snapshot = hoomd.Snapshot(device.communicator)
+    if snapshot.communicator.rank == 0:
+        rng = np.random.default_rng(7)
+        N = 400
+        snapshot.configuration.box = [12, 12, 12, 0, 0, 0]
+        snapshot.particles.N = N
+        snapshot.particles.types = list(diameters)
+        typeid = rng.integers(0, len(diameters), size=N)
+        snapshot.particles.typeid[:] = typeid
+        snapshot.particles.diameter[:] = np.array(list(
+            diameters.values()))[typeid]
+        position = rng.uniform(-5.5, 5.5, size=(N, 3))
+        # bonded partners overlap, so only the exclusion keeps them apart
+        position[1:2 * n_bonds:2] = position[0:2 * n_bonds:2] + [0.2, 0, 0]
+        snapshot.particles.position[:] = position
+        snapshot.bonds.N = n_bonds
+        snapshot.bonds.types = ["b"]
+        snapshot.bonds.group[:] = np.arange(2 * n_bonds).reshape(n_bonds, 2)
+    sim = simulation_factory(snapshot)
+
+    cell = hoomd.md.nlist.Cell(buffer=0.3)
+    multilevel = hoomd.pair_plugin.nlist.MultiLevel(
+        buffer=0.3, diameter_cutoff=diameter_cutoff)
+    pairs = []
+    for nlist in (cell, multilevel):
+        hertz = Hertzian(nlist, default_r_cut=1.0)
+        for a, b in itertools.combinations_with_replacement(diameters, 2):
+            contact = (diameters[a] + diameters[b]) / 2
+            hertz.params[(a, b)] = dict(epsilon=1.0, sigma=contact)
+            hertz.r_cut[(a, b)] = contact
+        pairs.append(hertz)
+    integrator = hoomd.md.Integrator(dt=0.001)
+    integrator.forces = pairs
+    sim.operations.integrator = integrator
+
+    sim.run(0)
+
+    cell_pairs = cell.pair_list
+    multilevel_pairs = multilevel.pair_list
+    cell_forces, multilevel_forces = (hertz.forces for hertz in pairs)
+    cell_energies, multilevel_energies = (hertz.energies for hertz in pairs)
+    if sim.device.communicator.rank == 0:
+        cell_set = {tuple(sorted(p)) for p in cell_pairs.tolist()}
+        multilevel_set = {tuple(sorted(p)) for p in multilevel_pairs.tolist()}
+        bonded = {(2 * k, 2 * k + 1) for k in range(n_bonds)}
+        assert len(cell_set) > 0
+        assert multilevel_set == cell_set
+        assert not (cell_set & bonded)
+        np.testing.assert_allclose(multilevel_forces,
+                                   cell_forces,
+                                   rtol=1e-10,
+                                   atol=1e-12)
+        np.testing.assert_allclose(multilevel_energies,
+                                   cell_energies,
+                                   rtol=1e-10,
+                                   atol=1e-12)
+
+
+# Inserting and removing a particle far from a sliding contact must carry
+# its tangential history over, so the contact evolves as if nothing
+# happened.
+def test_granular_insert_remove_history(simulation_factory,
+                                        two_particle_snapshot_factory):
+    sims, pairs = [], []
+    for _ in range(2):
+        snapshot = two_particle_snapshot_factory(d=0.9)
+        if snapshot.communicator.rank == 0:
+            snapshot.particles.velocity[:] = [[0.0, 0.02, 0.0],
+                                              [0.0, -0.02, 0.0]]
+        sim = simulation_factory(snapshot)
+        integrator = hoomd.md.Integrator(dt=0.001)
+        cell = hoomd.md.nlist.Cell(buffer=0.4)
+        granular = GranularHookean(cell, default_r_cut=1.0, mus=100.0, ks=5.0)
+        granular.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+        integrator.forces = [granular]
+        sim.operations.integrator = integrator
+        sim.run(3)
+        sims.append(sim)
+        pairs.append(granular)
+    sim, reference_sim = sims
+    granular, reference = pairs
+
+    def check():
+        forces = granular.forces
+        reference_forces = reference.forces
+        if sim.device.communicator.rank == 0:
+            # the sliding spring has built up along y
+            assert abs(reference_forces[0, 1]) > 0
+            np.testing.assert_allclose(forces[:2],
+                                       reference_forces,
+                                       rtol=1e-10,
+                                       atol=1e-14)
+
+    tags = granular.insert([[5.0, 5.0, 5.0]], "A")
+    sim.run(2)
+    reference_sim.run(2)
+    check()
+
+    granular.remove(tags)
+    sim.run(2)
+    reference_sim.run(2)
+    check()
+
+
+# Contact conduction conserves heat and relaxes two touching grains to their
+# mean temperature.
+def test_granular_heat_conduction(simulation_factory,
+                                  two_particle_snapshot_factory):
+    sim = simulation_factory(two_particle_snapshot_factory(d=0.9))
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    pair = Granular(cell, default_r_cut=1.0, conductivity=50.0)
+    pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [pair]
+    sim.operations.integrator = integrator
+
+    sim.run(0)
+    pair.set_temperatures([1.0, 0.0])
+    sim.run(1)
+    temperatures = pair.temperatures
+    assert temperatures.sum() == pytest.approx(1.0, abs=1e-12)
+    assert 0.0 < temperatures[1] < temperatures[0]
+
+    sim.run(200)
+    temperatures = pair.temperatures
+    np.testing.assert_allclose(temperatures, [0.5, 0.5], atol=1e-2)
+
+    # the temperatures travel with the particles as their charges
+    snapshot = sim.state.get_snapshot()
+    if snapshot.communicator.rank == 0:
+        np.testing.assert_allclose(snapshot.particles.charge, temperatures)
+
+
+# A massless particle has no heat capacity: it keeps its temperature while
+# its partner still exchanges heat with it.
+def test_granular_heat_conduction_massless(simulation_factory,
+                                           two_particle_snapshot_factory):
+    snapshot = two_particle_snapshot_factory(d=0.9)
+    if snapshot.communicator.rank == 0:
+        snapshot.particles.mass[:] = [1.0, 0.0]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    pair = Granular(cell, default_r_cut=1.0, conductivity=50.0)
+    pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [pair]
+    sim.operations.integrator = integrator
+
+    sim.run(0)
+    pair.set_temperatures([1.0, 0.0])
+    sim.run(10)
+    temperatures = pair.temperatures
+    assert np.all(np.isfinite(temperatures))
+    assert temperatures[1] == 0.0
+    assert temperatures[0] < 1.0
+
+
+# In a lattice the pair count does not change, so once both history buffers
+# have been filled the rebuilds forced by particle sorting reuse them.
+def test_hpf_arena_allocations(simulation_factory, lattice_snapshot_factory,
+                               device):
+    if isinstance(device, hoomd.device.GPU):
+        pytest.skip("HarmHPF is CPU only")
+
+    snapshot = lattice_snapshot_factory(n=4, a=0.95)
+    if snapshot.communicator.rank == 0:
+        rng = np.random.default_rng(1)
+        snapshot.particles.velocity[:] = rng.normal(
+            scale=0.01, size=(snapshot.particles.N, 3))
+    sim = simulation_factory(snapshot)
+    sim.operations.tuners[0].trigger = hoomd.trigger.Periodic(10)
+
+    integrator = hoomd.md.Integrator(dt=0.005)
+    # the second neighbor shell, at 0.95 * sqrt(2), stays out of the list
+    cell = hoomd.md.nlist.Cell(buffer=0.2)
+    pair = HarmHPF(cell, default_r_cut=1.0, mus=0.5, ks=5.0)
+    pair.params[("A", "A")] = dict(k=10.0, rcut=1.0)
+    integrator.forces = [pair]
+    integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+    sim.operations.integrator = integrator
+
+    sim.run(50)
+    allocations = pair.arena_allocations
+    builds = cell.num_builds
+    sim.run(200)
+    assert cell.num_builds > builds
+    assert pair.arena_allocations == allocations
+
+
+# With gamma = 0 the fused thermostat adds nothing, with gamma > 0 the
+# dissipative and random forces are pairwise antisymmetric.
+@pytest.mark.parametrize("pair, pair_params", [
+    (MLJ, {"epsilon": 1.0, "sigma": 0.5, "delta": 0.4}),
+    (WLJ, {"epsilon": 1.0, "sigma": 0.5, "delta": 0.4, "epsilon_a": 0.5,
+           "delta_a": 0.2}),
+])
+def test_dpd_thermostat(simulation_factory, two_particle_snapshot_factory, pair,
+                        pair_params):
+    snapshot = two_particle_snapshot_factory(d=1.0)
+    if snapshot.communicator.rank == 0:
+        snapshot.particles.velocity[:] = [[0.5, 0.2, 0.0], [-0.5, 0.0, 0.1]]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    plain_pair = pair(cell, default_r_cut=1.25)
+    cold_pair = pair(cell, default_r_cut=1.25, kT=1.0)
+    hot_pair = pair(cell, default_r_cut=1.25, kT=1.0)
+    plain_pair.params[("A", "A")] = pair_params
+    cold_pair.params[("A", "A")] = dict(gamma=0.0, **pair_params)
+    hot_pair.params[("A", "A")] = dict(gamma=4.5, **pair_params)
+    integrator.forces = [plain_pair, cold_pair, hot_pair]
+    sim.operations.integrator = integrator
+
+    sim.run(0)
+
+    forces = plain_pair.forces
+    cold_forces = cold_pair.forces
+    hot_forces = hot_pair.forces
+    if sim.device.communicator.rank == 0:
+        np.testing.assert_allclose(cold_forces, forces, atol=1e-12)
+        np.testing.assert_allclose(hot_forces[0], -hot_forces[1], atol=1e-12)
+        assert not np.allclose(hot_forces, forces)
+
+
+# The lag 0 value of the on the fly correlator is the mean square of the
+# off-diagonal pressure tensor over all samples.
+def test_stress_autocorrelation(simulation_factory,
+                                two_particle_snapshot_factory):
+    snapshot = two_particle_snapshot_factory(d=1.0)
+    if snapshot.communicator.rank == 0:
+        snapshot.particles.velocity[:] = [[0.5, 0.2, 0.1], [-0.5, -0.2, -0.1]]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    mlj = MLJ(cell, default_r_cut=1.25)
+    mlj.params[("A", "A")] = {"epsilon": 1.0, "sigma": 0.5, "delta": 0.4}
+    integrator.forces = [mlj]
+    integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+    sim.operations.integrator = integrator
+    thermo = hoomd.md.compute.ThermodynamicQuantities(hoomd.filter.All())
+    sim.operations.computes.append(thermo)
+    acf = hoomd.pair_plugin.analyze.StressAutocorrelation(
+        hoomd.trigger.Periodic(1), [mlj], p=4, m=2)
+    sim.operations.writers.append(acf)
+
+    squares = []
+    for _ in range(20):
+        sim.run(1)
+        p = thermo.pressure_tensor
+        squares.append((p[1]**2 + p[2]**2 + p[4]**2) / 3)
+
+    assert acf.num_samples == 20
+    lag_times = acf.lag_times
+    np.testing.assert_allclose(lag_times[:4], [0.0, 0.001, 0.002, 0.003])
+    assert np.all(np.diff(lag_times) > 0)
+    np.testing.assert_allclose(acf.autocorrelation[0], np.mean(squares),
+                               rtol=1e-10)
+
+
+# Summed over the slabs, the Irving-Kirkwood profile is the pair virial of
+# the whole box. The pair line is centered on the boundary of two slabs.
+@pytest.mark.parametrize("pair, pair_params", [
+    (MLJ, {"epsilon": 1.0, "sigma": 0.5, "delta": 0.4}),
+    (Granular, {"k": 10.0, "rcut": 1.0}),
+])
+def test_stress_profile(simulation_factory, two_particle_snapshot_factory,
+                        pair, pair_params):
+    snapshot = two_particle_snapshot_factory(d=0.9)
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    profile_pair = pair(cell,
+                        default_r_cut=1.25,
+                        profile_bins=10,
+                        profile_axis='x')
+    profile_pair.params[("A", "A")] = pair_params
+    integrator.forces = [profile_pair]
+    sim.operations.integrator = integrator
+    thermo = hoomd.md.compute.ThermodynamicQuantities(hoomd.filter.All())
+    sim.operations.computes.append(thermo)
+
+    sim.run(0)
+
+    profile = profile_pair.stress_profile
+    pressure_tensor = thermo.pressure_tensor
+    assert profile_pair.stress_profile_samples == 1
+    assert profile.shape == (10, 6)
+    assert pressure_tensor[0] != 0.0
+    np.testing.assert_allclose(profile.sum(axis=0) / 10,
+                               pressure_tensor,
+                               rtol=1e-10,
+                               atol=1e-12)
+    np.testing.assert_allclose(profile[4], profile[5], rtol=1e-10)
+    np.testing.assert_allclose(profile_pair.stress_profile_centers[5], 1.0)
+
+
+# The type pair matrix is symmetric and sums to the total pair energy; an
+# A-B pair contributes nothing to the diagonal.
+def test_type_pair_energies(simulation_factory, two_particle_snapshot_factory):
+    snapshot = two_particle_snapshot_factory(particle_types=["A", "B"], d=0.9)
+    if snapshot.communicator.rank == 0:
+        snapshot.particles.typeid[:] = [0, 1]
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    mlj = MLJ(cell, default_r_cut=1.25, type_pair_period=1)
+    mlj.params[("A", "A")] = {"epsilon": 1.0, "sigma": 0.5, "delta": 0.4}
+    mlj.params[("A", "B")] = {"epsilon": 2.0, "sigma": 0.5, "delta": 0.4}
+    mlj.params[("B", "B")] = {"epsilon": 1.0, "sigma": 0.5, "delta": 0.4}
+    integrator.forces = [mlj]
+    sim.operations.integrator = integrator
+
+    sim.run(0)
+
+    energy = mlj.energy
+    energies = mlj.type_pair_energies
+    virials = mlj.type_pair_virials
+    assert energies.shape == (2, 2)
+    assert energy != 0.0
+    np.testing.assert_allclose(energies, energies.T)
+    np.testing.assert_allclose(np.diag(energies), [0.0, 0.0], atol=1e-14)
+    np.testing.assert_allclose(energies.sum(), energy, rtol=1e-12)
+    np.testing.assert_allclose(np.diag(virials), [0.0, 0.0], atol=1e-14)
+    assert virials[0, 1] != 0.0
+
+
+# Hertzian forces and energies are linear in epsilon, so against zero
+# reference forces dL/d(epsilon) = 2 L / epsilon and dU/d(epsilon) = U /
+# epsilon.
+def test_parameter_gradients(simulation_factory, two_particle_snapshot_factory):
+    snapshot = two_particle_snapshot_factory(d=0.9)
+    sim = simulation_factory(snapshot)
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    hertz = Hertzian(cell, default_r_cut=1.0)
+    hertz.params[("A", "A")] = {"epsilon": 2.0, "sigma": 1.0}
+    integrator.forces = [hertz]
+    sim.operations.integrator = integrator
+    sim.run(0)
+
+    frames = [(snapshot, np.zeros((2, 3)))] * 2
+    gradients = hertz.parameter_gradients(frames)
+    energy = hertz.energy
+
+    assert gradients["names"] == ("epsilon", "sigma")
+    assert gradients["loss"] > 0.0
+    np.testing.assert_allclose(gradients["force_gradient"][0, 0, 0],
+                               2 * gradients["loss"] / 2.0,
+                               rtol=1e-10)
+    np.testing.assert_allclose(gradients["energy_gradient"][0, 0, 0],
+                               2 * energy / 2.0,
+                               rtol=1e-10)
+
+
+# The analytic delta derivatives match central differences of the loss and
+# the energy of one pair, taken from the reference potentials above. The
+# frame differs from the state of the simulation, which must come back.
+gradient_params = dict(epsilon=1.0,
+                       sigma=1.0,
+                       delta=0.2,
+                       epsilon_a=0.5,
+                       delta_a=0.1)
+gradient_data = [
+    (MLJ, mlj, dict(epsilon=1.0, sigma=1.0, delta=0.2), 1.1, "delta"),
+    (WLJ, wlj, gradient_params, 1.0, "delta"),
+    (WLJ, wlj, gradient_params, 1.5, "delta_a"),
+]
+
+
+@pytest.mark.parametrize("pair, reference, params, distance, name",
+                         gradient_data)
+def test_parameter_gradients_delta(simulation_factory,
+                                   two_particle_snapshot_factory, pair,
+                                   reference, params, distance, name):
+    r_cut = 2.5
+    sim = simulation_factory(two_particle_snapshot_factory(d=2.0))
+
+    integrator = hoomd.md.Integrator(dt=0.001)
+    cell = hoomd.md.nlist.Cell(buffer=0.4)
+    lj = pair(cell, default_r_cut=r_cut)
+    lj.params[("A", "A")] = params
+    integrator.forces = [lj]
+    sim.operations.integrator = integrator
+    sim.run(0)
+    forces = lj.forces
+    snapshot = sim.state.get_snapshot()
+
+    reference_forces = np.array([[0.3, 0.1, 0.0], [-0.3, -0.1, 0.0]])
+    frame = two_particle_snapshot_factory(d=distance)
+    gradients = lj.parameter_gradients([(frame, reference_forces)])
+
+    def loss_and_energy(value):
+        f, e = reference(np.array([-distance, 0.0, 0.0]), {
+            **params, name: value
+        }, r_cut)
+        return np.sum((np.array([f, -f]) - reference_forces)**2), e
+
+    h = 1e-6
+    loss_plus, energy_plus = loss_and_energy(params[name] + h)
+    loss_minus, energy_minus = loss_and_energy(params[name] - h)
+    k = gradients["names"].index(name)
+    np.testing.assert_allclose(gradients["force_gradient"][0, 0, k],
+                               (loss_plus - loss_minus) / (2 * h),
+                               rtol=1e-6)
+    np.testing.assert_allclose(gradients["energy_gradient"][0, 0, k],
+                               (energy_plus - energy_minus) / (2 * h),
+                               rtol=1e-6)
+
+    restored = sim.state.get_snapshot()
+    restored_forces = lj.forces
+    if sim.device.communicator.rank == 0:
+        np.testing.assert_allclose(restored.particles.position,
+                                   snapshot.particles.position)
+        np.testing.assert_allclose(restored_forces, forces)
+
+
+def test_batch_quench():
+    gsd_hoomd = pytest.importorskip("gsd.hoomd")
+    from hoomd.pair_plugin.minimize import BatchFIRE
+
+    hertz = Hertzian(hoomd.md.nlist.Cell(buffer=0.4))
+    hertz.params[("A", "A")] = dict(epsilon=1.0, sigma=1.0)
+    hertz.r_cut[("A", "A")] = 1.0
+
+    frames = []
+    for gap in (0.5, 0.8):
+        frame = gsd_hoomd.Frame()
+        frame.configuration.box = [10, 10, 10, 0, 0, 0]
+        frame.particles.N = 2
+        frame.particles.types = ["A"]
+        frame.particles.typeid = [0, 0]
+        frame.particles.position = [[0, 0, 0], [gap, 0, 0]]
+        frames.append(frame)
+
+    result = BatchFIRE(hertz, num_threads=2).quench(frames)
+    assert np.all(result["converged"])
+    np.testing.assert_allclose(result["energy"], 0.0, atol=1e-8)
+    for frame in result["frames"]:
+        dx = np.subtract(*frame.particles.position)
+        assert np.linalg.norm(dx) > 1.0 - 1e-3
+
+
+def test_nudged_elastic_band():
+    gsd_hoomd = pytest.importorskip("gsd.hoomd")
+    from hoomd.pair_plugin.minimize import NudgedElasticBand
+
+    hertz = Hertzian(hoomd.md.nlist.Cell(buffer=0.4))
+    hertz.params[("A", "A")] = dict(epsilon=1.0, sigma=1.0)
+    hertz.r_cut[("A", "A")] = 1.0
+
+    # the third particle squeezes between the first two
+    ends = []
+    for y in (-1.5, 1.5):
+        frame = gsd_hoomd.Frame()
+        frame.configuration.box = [10, 10, 0, 0, 0, 0]
+        frame.configuration.dimensions = 2
+        frame.particles.N = 3
+        frame.particles.types = ["A"]
+        frame.particles.typeid = [0, 0, 0]
+        frame.particles.position = [[-0.8, 0, 0], [0.8, 0, 0], [0, y, 0]]
+        ends.append(frame)
+
+    neb = NudgedElasticBand(hertz, force_tol=1e-5, num_threads=2)
+    images = neb.interpolate(*ends, n_images=9)
+    straight_barrier = 2 * 0.4 * 0.2**2.5
+
+    result = neb.run(images)
+    assert result["converged"]
+    assert len(result["frames"]) == 9
+    assert 1 <= result["climbing_image"] <= 7
+    np.testing.assert_allclose(result["energy"][[0, -1]], 0.0, atol=1e-12)
+    assert result["energy"].max() < straight_barrier
+
+
+def test_trajectory_reevaluate(tmp_path):
+    gsd_hoomd = pytest.importorskip("gsd.hoomd")
+    from hoomd.pair_plugin.trajectory import Reevaluate
+
+    hertz = Hertzian(hoomd.md.nlist.Cell(buffer=0.4))
+    hertz.params[("A", "A")] = dict(epsilon=1.0, sigma=1.0)
+    hertz.r_cut[("A", "A")] = 1.0
+
+    gaps = np.array([0.5, 0.7, 0.9, 1.2, 0.6])
+    filename = str(tmp_path / "traj.gsd")
+    with gsd_hoomd.open(filename, mode="w") as traj:
+        for step, gap in enumerate(gaps):
+            frame = gsd_hoomd.Frame()
+            frame.configuration.step = step
+            frame.configuration.box = [10, 10, 10, 0, 0, 0]
+            frame.particles.N = 2
+            frame.particles.types = ["A"]
+            frame.particles.typeid = [0, 0]
+            frame.particles.position = [[0, 0, 0], [gap, 0, 0]]
+            traj.append(frame)
+
+    overlap = np.maximum(1.0 - gaps, 0.0)
+    energy = 0.4 * overlap**2.5
+    reevaluate = Reevaluate(hertz, per_particle=True, batch_size=2,
+                            num_threads=2)
+    result = reevaluate.run(filename)
+    np.testing.assert_array_equal(result["step"], range(len(gaps)))
+    np.testing.assert_allclose(result["energy"], energy, atol=1e-12)
+    # virial_xx = r * f for a pair along x
+    np.testing.assert_allclose(result["virial"][:, 0],
+                               gaps * overlap**1.5,
+                               atol=1e-12)
+    for k in range(len(gaps)):
+        np.testing.assert_allclose(result["energies"][k], energy[k] / 2)
+        np.testing.assert_allclose(result["forces"][k][0, 0], -overlap[k]**1.5)
+
+    output = str(tmp_path / "energies.gsd")
+    reevaluate.run(filename, output=output)
+    with gsd_hoomd.open(output, mode="r") as traj:
+        logged = [f.log["pair_plugin/Reevaluate/energy"][0] for f in traj]
+    np.testing.assert_allclose(logged, energy, atol=1e-12)
+
+
+# Runs the serial and threaded granular loops and both PotentialPairProfile
+# loops in a fresh interpreter, so that PAIR_PLUGIN_ISA applies at import.
+_ISA_SCRIPT = """
+import json
+import hoomd
+import numpy as np
+from hoomd.pair_plugin import _pair_plugin
+from hoomd.pair_plugin.pair import Granular, MLJ
+
+device = hoomd.device.CPU()
+snapshot = hoomd.Snapshot(device.communicator)
+rng = np.random.default_rng(5)
+grid = np.arange(4) - 1.5
+snapshot.configuration.box = [4, 4, 4, 0, 0, 0]
+snapshot.particles.N = 64
+snapshot.particles.types = ["A"]
+snapshot.particles.position[:] = np.stack(
+    np.meshgrid(grid, grid, grid), axis=-1).reshape(64, 3) + rng.uniform(
+        -0.05, 0.05, size=(64, 3))
+snapshot.particles.velocity[:] = rng.normal(scale=0.1, size=(64, 3))
+snapshot.particles.moment_inertia[:] = [[0.1, 0.1, 0.1]] * 64
+sim = hoomd.Simulation(device)
+sim.create_state_from_snapshot(snapshot)
+
+integrator = hoomd.md.Integrator(dt=0.001, integrate_rotational_dof=True)
+kwargs = dict(default_r_cut=1.05, mus=0.5, mur=0.1, ks=5.0, kr=1.0,
+              gamma_n=0.5)
+serial = Granular(hoomd.md.nlist.Cell(buffer=0.4), **kwargs)
+threaded = Granular(hoomd.md.nlist.Cell(buffer=0.4), num_threads=2, **kwargs)
+profile = MLJ(hoomd.md.nlist.Cell(buffer=0.4), default_r_cut=2.5,
+              profile_bins=4, profile_period=2)
+for pair in (serial, threaded):
+    pair.params[("A", "A")] = dict(k=10.0, rcut=1.05)
+profile.params[("A", "A")] = {"epsilon": 1.0, "sigma": 0.9, "delta": 0.0}
+integrator.forces = [serial, threaded, profile]
+integrator.methods = [hoomd.md.methods.NVE(hoomd.filter.All())]
+sim.operations.integrator = integrator
+sim.run(21)
+
+result = dict(isa=_pair_plugin.cpu_isa())
+for name, pair in dict(serial=serial, threaded=threaded,
+                       profile=profile).items():
+    result[name] = dict(forces=pair.forces.tolist(),
+                        torques=pair.torques.tolist(),
+                        energies=pair.energies.tolist())
+print(json.dumps(result))
+"""
+
+
+def _run_isa_script(isa):
+    import json
+    import os
+    import subprocess
+    import sys
+
+    env = dict(os.environ)
+    env.pop("PAIR_PLUGIN_ISA", None)
+    if isa is not None:
+        env["PAIR_PLUGIN_ISA"] = isa
+    output = subprocess.run([sys.executable, "-c", _ISA_SCRIPT],
+                            env=env,
+                            check=True,
+                            capture_output=True,
+                            text=True).stdout
+    return json.loads(output.splitlines()[-1])
+
+
+# Every dispatched loop agrees with its baseline version to round-off, which
+# differs only through contracted multiply-adds.
+def test_cpu_isa(device):
+    if device.communicator.num_ranks > 1:
+        pytest.skip("Runs single rank simulations in subprocesses")
+
+    baseline = _run_isa_script("baseline")
+    default = _run_isa_script(None)
+    assert baseline["isa"] == "baseline"
+    assert default["isa"] in ("baseline", "avx2", "avx512")
+
+    for name in ("serial", "threaded", "profile"):
+        for key in ("forces", "torques", "energies"):
+            np.testing.assert_allclose(default[name][key],
+                                       baseline[name][key],
+                                       rtol=1e-9,
+                                       atol=1e-12)
@@ -0,0 +1,207 @@
+# Copyright (c) 2009-2022 The Regents of the University of Michigan.
+# Part of HOOMD-blue, released under the BSD 3-Clause License.
+"""Re-evaluation of stored trajectories with the plugin pairs."""
+
+import os
+import queue
+import threading
+
+import numpy
+
+from hoomd.pair_plugin.minimize import _make_replica_force
+
+
+def _read_chunk(file, frame, name, default):
+    """Read a chunk of ``frame``, falling back to frame 0 like GSD does."""
+    for k in (frame, 0):
+        if file.chunk_exists(frame=k, name=name):
+            return file.read_chunk(frame=k, name=name)
+    return default
+
+
+class Reevaluate:
+    r"""Recompute energies, virials and forces of a stored trajectory.
+
+    Args:
+        pair (`hoomd.md.pair.Pair`): Plugin pair potential to evaluate, one
+            of `ModLJ <hoomd.pair_plugin.pair.ModLJ>`,
+            `WLJ <hoomd.pair_plugin.pair.WLJ>` or
+            `Hertzian <hoomd.pair_plugin.pair.Hertzian>`.
+        per_particle (bool): Also compute the force and energy of every
+            particle.
+        batch_size (int): Number of frames evaluated at a time.
+        prefetch (int): Number of batches read ahead.
+        num_threads (int): Number of frames evaluated at the same time.
+
+    `Reevaluate` evaluates the frames of a GSD file without a
+    `hoomd.Simulation`. A background thread reads the positions, types and
+    boxes of the next batches straight from the GSD chunks while the current
+    batch is evaluated in C++ with the GIL released, one frame per thread,
+    each with a private cell and Verlet list. Parameters, cutoffs and the
+    energy shift mode (``'none'`` or ``'shift'``) are read from ``pair`` when
+    `run` is called; ``pair`` does not need to be attached.
+
+    The results can be streamed to a GSD file that holds only log chunks,
+    one frame per input frame with the same ``configuration/step``:
+    ``pair_plugin/Reevaluate/energy``, ``pair_plugin/Reevaluate/virial``
+    and, with ``per_particle``, ``pair_plugin/Reevaluate/forces`` and
+    ``pair_plugin/Reevaluate/energies``.
+
+    Example::
+
+        reevaluate = hoomd.pair_plugin.trajectory.Reevaluate(wlj,
+                                                             num_threads=32)
+        result = reevaluate.run('traj.gsd', output='energies.gsd')
+    """
+
+    def __init__(self,
+                 pair,
+                 per_particle=False,
+                 batch_size=64,
+                 prefetch=2,
+                 num_threads=1):
+        self.pair = pair
+        self.per_particle = per_particle
+        self.batch_size = batch_size
+        self.prefetch = prefetch
+        self.num_threads = num_threads
+
+    def run(self, trajectory, output=None):
+        """Evaluate every frame of a trajectory.
+
+        Args:
+            trajectory: Name of a GSD file, or an open
+                `gsd.hoomd.HOOMDTrajectory`. The particle types of frame 0
+                apply to all frames.
+            output (str): Name of a GSD file to write the results to, `None`
+                to only return them.
+
+        Returns:
+            dict: ``step``, the time step of every frame; ``energy``, the
+            potential energy of every frame; ``virial``, the (*N_frames*, 6)
+            virial of every frame, ordered like
+            `hoomd.md.force.Force.virials`; and, with ``per_particle`` when
+            ``output`` is `None`, ``forces`` and ``energies``, lists with the
+            per-particle arrays of every frame.
+        """
+        import gsd.hoomd
+
+        traj = trajectory
+        if isinstance(trajectory, (str, os.PathLike)):
+            traj = gsd.hoomd.open(trajectory, mode='r')
+
+        writer = None
+        if output is not None:
+            writer = gsd.hoomd.open(output, mode='w')
+
+        steps, energy, virial = [], [], []
+        forces, energies = [], []
+        try:
+            evaluator = _make_replica_force(self.pair,
+                                            "_trajectory_cpp_class_name",
+                                            traj[0].particles.types, 0.0,
+                                            self.num_threads)
+            evaluator.per_particle = self.per_particle
+
+            for batch in self._prefetch(traj.file, len(traj)):
+                evaluator.clear()
+                for frame in batch:
+                    evaluator.addFrame(*frame[1:])
+                evaluator.run()
+
+                batch_energy = evaluator.energies
+                batch_virial = evaluator.virials
+                for k, frame in enumerate(batch):
+                    log = {
+                        "pair_plugin/Reevaluate/energy": [batch_energy[k]],
+                        "pair_plugin/Reevaluate/virial": batch_virial[k]
+                    }
+                    if self.per_particle:
+                        log["pair_plugin/Reevaluate/forces"] = \
+                            evaluator.getForces(k)
+                        log["pair_plugin/Reevaluate/energies"] = \
+                            evaluator.getParticleEnergies(k)
+                    if writer is not None:
+                        out = gsd.hoomd.Frame()
+                        out.configuration.step = frame[0]
+                        out.log.update(log)
+                        writer.append(out)
+                    elif self.per_particle:
+                        forces.append(log["pair_plugin/Reevaluate/forces"])
+                        energies.append(
+                            log["pair_plugin/Reevaluate/energies"])
+                steps.extend(frame[0] for frame in batch)
+                energy.append(batch_energy)
+                virial.append(batch_virial)
+        finally:
+            if writer is not None:
+                writer.close()
+            if traj is not trajectory:
+                traj.close()
+
+        result = dict(step=numpy.array(steps, dtype=numpy.uint64),
+                      energy=numpy.concatenate(energy)
+                      if energy else numpy.zeros(0),
+                      virial=numpy.concatenate(virial)
+                      if virial else numpy.zeros((0, 6)))
+        if self.per_particle and output is None:
+            result["forces"] = forces
+            result["energies"] = energies
+        return result
+
+    def _prefetch(self, file, n_frames):
+        """Yield batches of frames read by a background thread."""
+        batches = queue.Queue(maxsize=max(self.prefetch, 1))
+        done = threading.Event()
+
+        def put(item):
+            while not done.is_set():
+                try:
+                    batches.put(item, timeout=0.1)
+                    return
+                except queue.Full:
+                    pass
+
+        def read():
+            try:
+                for start in range(0, n_frames, self.batch_size):
+                    stop = min(start + self.batch_size, n_frames)
+                    put([
+                        self._read_frame(file, k) for k in range(start, stop)
+                    ])
+                put(None)
+            except BaseException as error:
+                put(error)
+
+        reader = threading.Thread(target=read, daemon=True)
+        reader.start()
+        try:
+            while True:
+                batch = batches.get()
+                if batch is None:
+                    return
+                if isinstance(batch, BaseException):
+                    raise batch
+                yield batch
+        finally:
+            done.set()
+            reader.join()
+
+    @staticmethod
+    def _read_frame(file, frame):
+        """Read the step and the arguments of ``addFrame`` of one frame."""
+        N = int(_read_chunk(file, frame, "particles/N", [0])[0])
+        step = int(_read_chunk(file, frame, "configuration/step", [0])[0])
+        dimensions = int(
+            _read_chunk(file, frame, "configuration/dimensions", [3])[0])
+        box = numpy.asarray(_read_chunk(file, frame, "configuration/box",
+                                        [1, 1, 1, 0, 0, 0]),
+                            dtype=numpy.float64)
+        position = numpy.asarray(_read_chunk(file, frame,
+                                             "particles/position",
+                                             numpy.zeros((N, 3))),
+                                 dtype=numpy.float64).reshape(N, 3)
+        typeid = numpy.asarray(_read_chunk(file, frame, "particles/typeid",
+                                           numpy.zeros(N)),
+                               dtype=numpy.uint32)
+        return step, position, typeid, box, dimensions